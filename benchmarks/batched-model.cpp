@@ -0,0 +1,202 @@
+/*
+ * AIDA-X batched model benchmark
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Runs K streams through a model, once as K separate RTNeural models as the plugin does and once through
+// BatchedModel, for K from 1 to 16. Checks that the batched outputs match the separate models and reports CPU time
+// per sample and stream for both.
+
+#include "BatchedModel.hpp"
+#include "model_variant.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static constexpr const uint32_t kBlockSize = 128;
+static constexpr const uint32_t kNumBlocks = 100;
+
+// conditioned models get their parameter inputs as constants, interleaved after the audio
+struct Streams {
+    std::vector<std::vector<float>> inputs;
+    std::vector<std::vector<float>> outputs;
+    std::vector<const float*> inputPtrs;
+    std::vector<float*> outputPtrs;
+
+    Streams(const uint numStreams, const int inputSize)
+        : inputs(numStreams),
+          outputs(numStreams),
+          inputPtrs(numStreams),
+          outputPtrs(numStreams)
+    {
+        std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+
+        for (uint k = 0; k < numStreams; ++k)
+        {
+            std::mt19937 rng(k + 1);
+
+            inputs[k].resize(kBlockSize * kNumBlocks * inputSize);
+            outputs[k].resize(kBlockSize * kNumBlocks);
+
+            for (size_t i = 0; i < inputs[k].size(); ++i)
+                inputs[k][i] = i % inputSize == 0 ? dist(rng) : 0.5f;
+        }
+    }
+
+    // pointers to the given block
+    void setBlock(const uint32_t block, const int inputSize)
+    {
+        for (size_t k = 0; k < inputs.size(); ++k)
+        {
+            inputPtrs[k] = inputs[k].data() + block * kBlockSize * inputSize;
+            outputPtrs[k] = outputs[k].data() + block * kBlockSize;
+        }
+    }
+};
+
+struct Separate {
+    std::vector<ModelVariantType> models;
+
+    Separate(const nlohmann::json& modelJson, const uint numStreams)
+        : models(numStreams)
+    {
+        for (ModelVariantType& variant : models)
+        {
+            if (! custom_model_creator(modelJson, variant))
+                throw std::runtime_error("Unable to identify a known model architecture!");
+
+            std::visit([&modelJson] (auto&& model)
+            {
+                using ModelType = std::decay_t<decltype (model)>;
+                if constexpr (! std::is_same_v<ModelType, NullModel>)
+                {
+                    model.parseJson(modelJson, false);
+                    model.reset();
+                }
+            }, variant);
+        }
+    }
+
+    void process(const float* const* const in, float* const* const out, const int inputSize)
+    {
+        for (size_t k = 0; k < models.size(); ++k)
+        {
+            std::visit([&] (auto&& model)
+            {
+                using ModelType = std::decay_t<decltype (model)>;
+                if constexpr (! std::is_same_v<ModelType, NullModel>)
+                {
+                    for (uint32_t i = 0; i < kBlockSize; ++i)
+                        out[k][i] = model.forward(in[k] + i * inputSize);
+                }
+            }, models[k]);
+        }
+    }
+};
+
+struct Batched {
+    BatchedModel model;
+
+    Batched(const nlohmann::json& modelJson, const uint numStreams)
+    {
+        if (! model.load(modelJson, numStreams))
+            throw std::runtime_error("Unsupported model architecture!");
+    }
+
+    void process(const float* const* const in, float* const* const out, int)
+    {
+        model.process(in, out, kBlockSize);
+    }
+};
+
+// one pass over all blocks
+template <class Processor>
+static void processAll(Processor& processor, Streams& streams, const int inputSize)
+{
+    for (uint32_t b = 0; b < kNumBlocks; ++b)
+    {
+        streams.setBlock(b, inputSize);
+        processor.process(streams.inputPtrs.data(), streams.outputPtrs.data(), inputSize);
+    }
+}
+
+// returns ns per sample and stream
+template <class Processor>
+static double run(Processor& processor, Streams& streams, const int inputSize, const double minSeconds)
+{
+    uint64_t numSamples = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed;
+
+    do {
+        processAll(processor, streams, inputSize);
+        numSamples += kBlockSize * kNumBlocks * streams.inputs.size();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+
+    return elapsed * 1e9 / static_cast<double>(numSamples);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* const modelFile = argc > 1 ? argv[1] : "files/tw40_california_clean_deerinkstudios.json";
+    const double minSeconds = argc > 2 ? std::atof(argv[2]) : 0.5;
+
+    nlohmann::json modelJson;
+
+    try {
+        std::ifstream stream(modelFile, std::ifstream::binary);
+        stream >> modelJson;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "Unable to load %s: %s\n", modelFile, e.what());
+        return 1;
+    }
+
+    const nlohmann::json& rnn(modelJson["layers"][0]);
+    const int inputSize = modelJson["in_shape"].back().get<int>();
+
+    std::printf("%s: %s, %d hidden, %d inputs\n", modelFile,
+                rnn["type"].get<std::string>().c_str(), rnn["shape"].back().get<int>(), inputSize);
+    std::printf("%8s %16s %16s %8s %12s\n", "streams", "separate ns/smp", "batched ns/smp", "speedup", "max error");
+
+    for (uint numStreams = 1; numStreams <= BatchedModel::kMaxStreams; ++numStreams)
+    {
+        Streams reference(numStreams, inputSize);
+        Streams streams(numStreams, inputSize);
+
+        try {
+            Separate separate(modelJson, numStreams);
+            Batched batched(modelJson, numStreams);
+
+            // both start from a zero state, so the first pass must match
+            processAll(separate, reference, inputSize);
+            processAll(batched, streams, inputSize);
+
+            float maxError = 0.f;
+            for (uint k = 0; k < numStreams; ++k)
+                for (size_t i = 0; i < streams.outputs[k].size(); ++i)
+                    maxError = std::max(maxError, std::abs(streams.outputs[k][i] - reference.outputs[k][i]));
+
+            const double separateTime = run(separate, reference, inputSize, minSeconds);
+            const double batchedTime = run(batched, streams, inputSize, minSeconds);
+
+            std::printf("%8u %16.2f %16.2f %7.2fx %12g\n",
+                        numStreams, separateTime, batchedTime, separateTime / batchedTime, maxError);
+        }
+        catch (const std::exception& e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+    }
+
+    return 0;
+}
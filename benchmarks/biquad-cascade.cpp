@@ -0,0 +1,135 @@
+/*
+ * AIDA-X biquad cascade benchmark
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Runs the tone control filters as separate Biquad passes and as fused cascades, checking each cascade against the
+// separate passes and measuring CPU time per processed sample.
+// The double precision cascade must match exactly, the float ones within kFloatTolerance. Exits with a failure if
+// any of them does not, so it also runs as a test, see CMakeLists.txt. The first argument is the minimum time
+// spent measuring each variant, in seconds, 0 runs each only once.
+
+#include "BiquadCascade.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static constexpr const double kSampleRate = 48000.0;
+static constexpr const uint32_t kBlockSize = 128;
+// maximum error of the float cascades, about -66 dB of full scale. the filter states round to float on every sample,
+// which stays well below this, while wrong coefficients or a broken state hand-over are far above it
+static constexpr const double kFloatTolerance = 5e-4;
+
+// same types and ranges as the tone controls, with non-zero gains
+static void initFilters(Biquad filters[5])
+{
+    filters[0].setBiquad(bq_type_peak, 75.0 / kSampleRate, 0.707, 4.0);
+    filters[1].setBiquad(bq_type_lowshelf, 305.0 / kSampleRate, 0.707, -3.0);
+    filters[2].setBiquad(bq_type_peak, 750.0 / kSampleRate, 0.707, 6.0);
+    filters[3].setBiquad(bq_type_highshelf, 2000.0 / kSampleRate, 0.707, -5.0);
+    filters[4].setBiquad(bq_type_highshelf, 900.0 / kSampleRate, 0.707, 2.0);
+}
+
+struct SeparatePasses {
+    Biquad filters[5];
+
+    SeparatePasses() { initFilters(filters); }
+
+    void process(float* const out, const float* const in, const uint32_t numSamples)
+    {
+        std::memcpy(out, in, sizeof(float) * numSamples);
+
+        for (Biquad& filter : filters)
+            for (uint32_t i = 0; i < numSamples; ++i)
+                out[i] = filter.process(out[i]);
+    }
+};
+
+template <class Cascade>
+struct Fused {
+    Biquad filters[5];
+    Cascade cascade;
+
+    Fused() { initFilters(filters); }
+
+    // rebuilt every block, as done in the plugin
+    void process(float* const out, const float* const in, const uint32_t numSamples)
+    {
+        cascade.clear();
+        for (Biquad& filter : filters)
+            cascade.add(filter);
+        cascade.process(out, in, numSamples);
+        cascade.storeStates();
+    }
+};
+
+// returns false if the output differs from the reference by more than the tolerance
+template <class Processor>
+static bool run(const char* const name, const std::vector<float>& input, const std::vector<float>& reference,
+                const double tolerance, const double minSeconds)
+{
+    std::vector<float> output(input.size());
+    Processor processor;
+
+    for (size_t i = 0; i < input.size(); i += kBlockSize)
+        processor.process(output.data() + i, input.data() + i, kBlockSize);
+
+    double maxError = 0.0;
+    for (size_t i = 0; i < input.size(); ++i)
+        maxError = std::max(maxError, static_cast<double>(std::abs(output[i] - reference[i])));
+
+    uint64_t numSamples = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed;
+
+    do {
+        for (size_t i = 0; i < input.size(); i += kBlockSize)
+            processor.process(output.data() + i, input.data() + i, kBlockSize);
+        numSamples += input.size();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+
+    const bool passed = maxError <= tolerance;
+
+    std::printf("%-24s %10.3f ns/sample   max error %g%s%s\n",
+                name, elapsed * 1e9 / static_cast<double>(numSamples), maxError,
+                maxError == 0.0 ? " (exact)" : "",
+                passed ? "" : "   FAIL");
+    return passed;
+}
+
+int main(int argc, char* argv[])
+{
+    const double minSeconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    std::vector<float> input(kBlockSize * 375);
+    for (float& sample : input)
+        sample = dist(rng);
+
+    std::vector<float> reference(input.size());
+    {
+        SeparatePasses processor;
+        for (size_t i = 0; i < input.size(); i += kBlockSize)
+            processor.process(reference.data() + i, input.data() + i, kBlockSize);
+    }
+
+    bool passed = true;
+    passed &= run<SeparatePasses>("separate passes", input, reference, 0.0, minSeconds);
+    passed &= run<Fused<BiquadCascade<double>>>("fused, double", input, reference, 0.0, minSeconds);
+    passed &= run<Fused<BiquadCascade<float>>>("fused, float", input, reference, kFloatTolerance, minSeconds);
+   #if AIDAX_BIQUAD_SIMD
+    passed &= run<Fused<BiquadCascadeSIMD>>("fused, float SIMD", input, reference, kFloatTolerance, minSeconds);
+   #endif
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,70 @@
+/*
+ * AIDA-X convolver FFT backend benchmark
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Measures the uniformly partitioned convolver with the FFT backend selected at build time (AIDAX_WITH_PFFFT),
+// across impulse response lengths and partition block sizes.
+// Build it once per backend and compare the output, numbers are CPU time per processed sample.
+
+#include "DistrhoUtils.hpp"
+#include "PartitionedConvolver.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+USE_NAMESPACE_DISTRHO
+
+int main(int argc, char* argv[])
+{
+    const double minSeconds = argc > 1 ? std::atof(argv[1]) : 0.25;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    std::printf("backend %s (id 0x%x)\n", AIDAX_WITH_PFFFT ? "pffft" : "AudioFFT", ConvolverFFT::getBackendId());
+    std::printf("%8s %8s %12s\n", "IR", "block", "ns/sample");
+
+    for (const uint32_t irLen : { 2048u, 8192u, 24000u, 48000u, 96000u })
+    {
+        ConvolverBuffer ir(irLen);
+        for (uint32_t i = 0; i < irLen; ++i)
+            ir[i] = dist(rng) * 0.1f;
+
+        for (const uint32_t blockSize : { 64u, 128u, 256u, 512u, 1024u })
+        {
+            ConvolverBuffer payload(ConvolverSpectrum::getNumFloats(blockSize, irLen));
+            ConvolverSpectrum spectrum;
+            spectrum.compute(payload.data(), blockSize, ir.data(), irLen);
+
+            PartitionedConvolver convolver;
+            convolver.init(spectrum);
+
+            ConvolverBuffer input(blockSize);
+            ConvolverBuffer output(blockSize);
+            for (uint32_t i = 0; i < blockSize; ++i)
+                input[i] = dist(rng);
+
+            // warm-up, fills the input spectra
+            for (uint32_t i = 0; i < spectrum.numPartitions; ++i)
+                convolver.process(input.data(), output.data(), blockSize);
+
+            uint64_t numSamples = 0;
+            const auto start = std::chrono::steady_clock::now();
+            double elapsed;
+
+            do {
+                for (int i = 0; i < 16; ++i)
+                    convolver.process(input.data(), output.data(), blockSize);
+                numSamples += blockSize * 16;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (elapsed < minSeconds);
+
+            std::printf("%8u %8u %12.2f\n", irLen, blockSize, elapsed * 1e9 / static_cast<double>(numSamples));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,612 @@
+/*
+ * AIDA-X performance regression check
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Renders a fixed test signal through the whole plugin chain for a few representative setups, and compares
+// output and throughput against references recorded earlier with --update-output and --update-throughput.
+// Setups: a small GRU without cabinet, an LSTM 80 with two conditioning inputs and a long impulse response, the
+// default model and cabinet with the EQ before and after the model, and bypass switches toggling while rendering.
+// Models and impulses are generated with fixed seeds, so nothing beyond the plugin itself is needed.
+//
+// The output is compared sample by sample against a reference render of each setup, a float wav file named after
+// it in --reference-dir. The error to signal ratio over the whole render must stay within --tolerance and no
+// sample may be further than --max-error from the reference, so that rounding differences between compilers and
+// CPUs pass. --strict fails on any change of the exact output too. The references are the same on every machine,
+// setups without one fail.
+// Throughput is the best of --runs renders, in multiples of realtime, and fails when more than --threshold percent
+// below the baseline. It is only meaningful on the machine it was recorded on, so it is kept in a separate file
+// given with --throughput-baseline, and only checked then.
+
+#include "host/PluginHost.hpp"
+
+#include "dr_wav.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static constexpr const double kSampleRate = 48000.0;
+static constexpr const uint32_t kBlockSize = 256;
+static constexpr const double kSignalTime = 10.0;
+static constexpr const double kLongImpulseTime = 2.5;
+
+enum GeneratedModel {
+    kModelDefault,
+    kModelGRU8,
+    kModelLSTM80x3
+};
+
+// bypass switches toggled every so many seconds while rendering
+struct Toggle {
+    Parameters parameter;
+    double period;
+};
+
+struct Setup {
+    const char* name;
+    GeneratedModel model;
+    bool longImpulse;
+    std::vector<std::pair<uint32_t, float>> parameters;
+    std::vector<Toggle> toggles;
+};
+
+static const Setup kSetups[] = {
+    { "gru8-nocab", kModelGRU8, false, { { kParameterCABSIMBYPASS, 1.f } }, {} },
+    { "lstm80x3-longir", kModelLSTM80x3, true, { { kParameterPARAM1, 0.3f }, { kParameterPARAM2, 0.7f } }, {} },
+    { "eq-pre", kModelDefault, false,
+      { { kParameterEQPOS, kEqPre }, { kParameterBASSGAIN, 4.f }, { kParameterMIDGAIN, -3.f },
+        { kParameterTREBLEGAIN, 5.f }, { kParameterDEPTH, 2.f }, { kParameterPRESENCE, -2.f } }, {} },
+    { "eq-post", kModelDefault, false,
+      { { kParameterEQPOS, kEqPost }, { kParameterBASSGAIN, 4.f }, { kParameterMIDGAIN, -3.f },
+        { kParameterTREBLEGAIN, 5.f }, { kParameterDEPTH, 2.f }, { kParameterPRESENCE, -2.f } }, {} },
+    { "bypass-transitions", kModelDefault, false, {},
+      { { kParameterGLOBALBYPASS, 0.5 }, { kParameterCABSIMBYPASS, 0.7 },
+        { kParameterEQBYPASS, 0.9 }, { kParameterNETBYPASS, 1.1 } } },
+};
+
+struct Options {
+    std::string referenceDir = "benchmarks/reference";
+    std::string throughputBaseline;
+    std::string workDir;
+    uint runs = 3;
+    double threshold = 15.0;
+    double tolerance = 1e-6;
+    double maxError = 1e-4;
+    bool updateOutput = false;
+    bool updateThroughput = false;
+    bool strict = false;
+    const char* only = nullptr;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// test data, from a generator that gives the same numbers everywhere
+
+struct Random {
+    uint64_t state;
+
+    explicit Random(const uint64_t seed) : state(seed) {}
+
+    // uniform in [-1, 1)
+    float next() noexcept
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<float>(static_cast<int32_t>(state >> 32)) / 2147483648.f;
+    }
+};
+
+// a sine sweep, decaying plucked notes at increasing levels, silence for the sleep path, then noise bursts
+static std::vector<float> generateSignal()
+{
+    const uint32_t numFrames = static_cast<uint32_t>(kSampleRate * kSignalTime);
+    std::vector<float> signal(numFrames);
+    Random random(1);
+
+    const uint32_t sweepEnd = static_cast<uint32_t>(kSampleRate * 2);
+    const uint32_t notesEnd = static_cast<uint32_t>(kSampleRate * 7);
+    const uint32_t silenceEnd = static_cast<uint32_t>(kSampleRate * 8);
+
+    // exponential sweep from 20 Hz to 20 kHz
+    const double k = std::log(1000.0);
+
+    for (uint32_t i = 0; i < sweepEnd; ++i)
+    {
+        const double t = i / kSampleRate;
+        const double phase = 2.0 * M_PI * 20.0 * 2.0 / k * (std::exp(t / 2.0 * k) - 1.0);
+        signal[i] = 0.25f * static_cast<float>(std::sin(phase));
+    }
+
+    const double notes[] = { 82.41, 110.0, 146.83, 196.0, 246.94, 329.63, 220.0, 164.81, 123.47, 98.0 };
+    const uint32_t noteFrames = (notesEnd - sweepEnd) / ARRAY_SIZE(notes);
+
+    for (uint n = 0; n < ARRAY_SIZE(notes); ++n)
+    {
+        const float level = std::pow(10.f, (-30.f + 24.f * n / (ARRAY_SIZE(notes) - 1)) / 20.f);
+
+        for (uint32_t i = 0; i < noteFrames; ++i)
+        {
+            const double t = i / kSampleRate;
+            double value = 0.0;
+
+            for (int h = 1; h <= 6; ++h)
+                value += std::sin(2.0 * M_PI * notes[n] * h * t) * std::exp(-t * (2.0 + h)) / h;
+
+            // pick attack
+            if (i < 64)
+                value += random.next() * (64 - i) / 64.0;
+
+            signal[sweepEnd + n * noteFrames + i] = level * static_cast<float>(value);
+        }
+    }
+
+    for (uint32_t i = silenceEnd; i < numFrames; ++i)
+    {
+        const uint32_t burst = (i - silenceEnd) / 4800;
+        signal[i] = (burst & 1) ? 0.f : 0.3f * random.next();
+    }
+
+    return signal;
+}
+
+// keras layout json of a single recurrent layer and a dense output, as loaded by the plugin
+static bool writeModel(const std::string& filename, const GeneratedModel type)
+{
+    const bool lstm = type == kModelLSTM80x3;
+    const int hiddenSize = lstm ? 80 : 8;
+    const int inputSize = lstm ? 3 : 1;
+    const int numGates = lstm ? 4 : 3;
+    const float scale = 1.f / std::sqrt(static_cast<float>(hiddenSize));
+
+    FILE* const fd = std::fopen(filename.c_str(), "w");
+    DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr, false);
+
+    Random random(lstm ? 80 : 8);
+
+    const auto writeMatrix = [fd, &random](const int rows, const int cols, const float s)
+    {
+        std::fputc('[', fd);
+        for (int r = 0; r < rows; ++r)
+        {
+            std::fputs(r == 0 ? "[" : ",[", fd);
+            for (int c = 0; c < cols; ++c)
+                std::fprintf(fd, c == 0 ? "%.8g" : ",%.8g", random.next() * s);
+            std::fputc(']', fd);
+        }
+        std::fputc(']', fd);
+    };
+
+    std::fprintf(fd, "{\"in_shape\":[null,null,%d],\"layers\":[{\"type\":\"%s\",\"activation\":\"\","
+                     "\"shape\":[null,null,%d],\"weights\":[",
+                 inputSize, lstm ? "lstm" : "gru", hiddenSize);
+    writeMatrix(inputSize, numGates * hiddenSize, scale);
+    std::fputc(',', fd);
+    writeMatrix(hiddenSize, numGates * hiddenSize, scale);
+    std::fputc(',', fd);
+
+    // gru has separate input and recurrent biases
+    if (lstm)
+    {
+        std::fputc('[', fd);
+        for (int i = 0; i < numGates * hiddenSize; ++i)
+            std::fprintf(fd, i == 0 ? "%.8g" : ",%.8g", random.next() * 0.1f);
+        std::fputc(']', fd);
+    }
+    else
+    {
+        writeMatrix(2, numGates * hiddenSize, 0.1f);
+    }
+
+    std::fprintf(fd, "]},{\"type\":\"dense\",\"activation\":\"\",\"shape\":[null,null,1],\"weights\":[");
+    writeMatrix(hiddenSize, 1, scale);
+    std::fprintf(fd, ",[0]]}]}\n");
+
+    return std::fclose(fd) == 0;
+}
+
+// mono float wav, for impulses and reference renders
+static bool writeWav(const std::string& filename, const std::vector<float>& data)
+{
+    const drwav_uint64 numFrames = data.size();
+
+    drwav_data_format format = {};
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = 1;
+    format.sampleRate = static_cast<drwav_uint32>(kSampleRate);
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    DISTRHO_SAFE_ASSERT_RETURN(drwav_init_file_write(&wav, filename.c_str(), &format, nullptr), false);
+
+    const drwav_uint64 numWritten = drwav_write_pcm_frames(&wav, numFrames, data.data());
+    drwav_uninit(&wav);
+
+    return numWritten == numFrames;
+}
+
+static bool readWav(const std::string& filename, std::vector<float>& data)
+{
+    drwav wav;
+    if (! drwav_init_file(&wav, filename.c_str(), nullptr))
+        return false;
+
+    const bool valid = wav.channels == 1 && wav.sampleRate == static_cast<drwav_uint32>(kSampleRate);
+
+    if (valid)
+    {
+        data.resize(static_cast<size_t>(wav.totalPCMFrameCount));
+        data.resize(static_cast<size_t>(drwav_read_pcm_frames_f32(&wav, wav.totalPCMFrameCount, data.data())));
+    }
+
+    drwav_uninit(&wav);
+    return valid;
+}
+
+// decaying noise, a large room rather than a cabinet, to load the tail stage
+static bool writeLongImpulse(const std::string& filename)
+{
+    const uint32_t numFrames = static_cast<uint32_t>(kSampleRate * kLongImpulseTime);
+    std::vector<float> ir(numFrames);
+    Random random(2);
+
+    for (uint32_t i = 0; i < numFrames; ++i)
+        ir[i] = random.next() * std::exp(-6.f * i / numFrames) * 0.1f;
+    ir[0] = 1.f;
+
+    return writeWav(filename, ir);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static double render(const Setup& setup, const PluginSetup& pluginSetup,
+                     const std::vector<float>& input, std::vector<float>& output)
+{
+    PluginExporter* const plugin = createPluginInstance(pluginSetup, kBlockSize, kSampleRate, true);
+
+    const uint32_t numFrames = static_cast<uint32_t>(input.size());
+    std::vector<int> toggleStates(setup.toggles.size(), 0);
+
+    output.resize(numFrames);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t pos = 0; pos < numFrames; pos += kBlockSize)
+    {
+        for (size_t i = 0; i < setup.toggles.size(); ++i)
+        {
+            const int state = static_cast<int>(pos / kSampleRate / setup.toggles[i].period) & 1;
+
+            if (state != toggleStates[i])
+            {
+                plugin->setParameterValue(setup.toggles[i].parameter, state);
+                toggleStates[i] = state;
+            }
+        }
+
+        const uint32_t numSamples = std::min(kBlockSize, numFrames - pos);
+        const float* inputs[1] = { input.data() + pos };
+        float* outputs[1] = { output.data() + pos };
+
+        plugin->run(inputs, outputs, numSamples);
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    plugin->deactivate();
+    delete plugin;
+
+    return elapsed;
+}
+
+struct OutputError {
+    double esr = 0.0;
+    double maxError = 0.0;
+    bool exact = true;
+};
+
+// error to signal ratio over the whole render and largest error of a single sample
+static OutputError getOutputError(const std::vector<float>& output, const std::vector<float>& reference)
+{
+    OutputError result;
+    double error = 0.0;
+    double energy = 0.0;
+
+    for (size_t i = 0; i < output.size(); ++i)
+    {
+        const double diff = static_cast<double>(output[i]) - reference[i];
+        error += diff * diff;
+        energy += static_cast<double>(reference[i]) * reference[i];
+        result.maxError = std::max(result.maxError, std::abs(diff));
+    }
+
+    result.esr = energy > 0.0 ? error / energy : error;
+    result.exact = std::memcmp(output.data(), reference.data(), sizeof(float) * output.size()) == 0;
+    return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// throughput baseline, one line per setup with its name and realtime factor
+
+// entries are merged into @a baseline, returns false if the file can't be read
+static bool readThroughputBaseline(const std::string& filename, std::map<std::string, double>& baseline)
+{
+    FILE* const fd = std::fopen(filename.c_str(), "r");
+    if (fd == nullptr)
+        return false;
+
+    char line[256];
+
+    while (std::fgets(line, sizeof(line), fd) != nullptr)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        char name[128];
+        double realtime;
+
+        if (std::sscanf(line, "%127s %lf", name, &realtime) == 2)
+            baseline[name] = realtime;
+    }
+
+    std::fclose(fd);
+    return true;
+}
+
+static bool writeThroughputBaseline(const std::string& filename, const std::map<std::string, double>& baseline)
+{
+    FILE* const fd = std::fopen(filename.c_str(), "w");
+    DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr, false);
+
+    std::fprintf(fd, "# AIDA-X throughput baseline of a single machine, written by --update-throughput\n");
+    std::fprintf(fd, "# setup, realtime factor\n");
+
+    for (const auto& entry : baseline)
+        std::fprintf(fd, "%s %.2f\n", entry.first.c_str(), entry.second);
+
+    return std::fclose(fd) == 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static void printUsage(const char* const name)
+{
+    std::fprintf(stderr,
+                 "usage: %s [options]\n"
+                 "  --reference-dir DIR\n"
+                 "                     reference renders, SETUP.wav each, default benchmarks/reference\n"
+                 "  --throughput-baseline FILE\n"
+                 "                     throughput baseline of this machine, throughput is only checked if given\n"
+                 "  --update-output    record the output as the new reference renders instead of comparing\n"
+                 "  --update-throughput\n"
+                 "                     record the throughput as the new throughput baseline instead of comparing\n"
+                 "  --runs N           renders per setup, the fastest counts, default 3\n"
+                 "  --threshold PCT    allowed slowdown in percent, default 15\n"
+                 "  --tolerance ESR    allowed output error to signal ratio, default 1e-6\n"
+                 "  --max-error VALUE  allowed error of any output sample, default 1e-4\n"
+                 "  --strict           fail on any change of the exact output as well\n"
+                 "  --only NAME        run a single setup\n"
+                 "  --work-dir DIR     where to write the generated models and impulses, default the temp dir\n",
+                 name);
+}
+
+static bool parseOptions(const int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+
+        if (std::strcmp(arg, "--update-output") == 0)
+        {
+            options.updateOutput = true;
+            continue;
+        }
+        if (std::strcmp(arg, "--update-throughput") == 0)
+        {
+            options.updateThroughput = true;
+            continue;
+        }
+        if (std::strcmp(arg, "--strict") == 0)
+        {
+            options.strict = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char* const next = argv[++i];
+
+        if (std::strcmp(arg, "--reference-dir") == 0)
+            options.referenceDir = next;
+        else if (std::strcmp(arg, "--throughput-baseline") == 0)
+            options.throughputBaseline = next;
+        else if (std::strcmp(arg, "--runs") == 0)
+            options.runs = std::max(1, std::atoi(next));
+        else if (std::strcmp(arg, "--threshold") == 0)
+            options.threshold = std::atof(next);
+        else if (std::strcmp(arg, "--tolerance") == 0)
+            options.tolerance = std::atof(next);
+        else if (std::strcmp(arg, "--max-error") == 0)
+            options.maxError = std::atof(next);
+        else if (std::strcmp(arg, "--only") == 0)
+            options.only = next;
+        else if (std::strcmp(arg, "--work-dir") == 0)
+            options.workDir = next;
+        else
+            return false;
+    }
+
+    // throughput has nowhere to be recorded to otherwise
+    if (options.updateThroughput && options.throughputBaseline.empty())
+        return false;
+
+    if (options.workDir.empty())
+    {
+        const char* const tmp = std::getenv("TMPDIR") != nullptr ? std::getenv("TMPDIR")
+                              : std::getenv("TEMP") != nullptr ? std::getenv("TEMP")
+                              : "/tmp";
+        options.workDir = tmp;
+    }
+
+    for (std::string* const dir : { &options.workDir, &options.referenceDir })
+    {
+        if (! dir->empty() && dir->back() != '/' && dir->back() != '\\')
+            *dir += '/';
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (! parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string gruFile = options.workDir + "aidax-regression-gru8.json";
+    const std::string lstmFile = options.workDir + "aidax-regression-lstm80x3.json";
+    const std::string impulseFile = options.workDir + "aidax-regression-long-ir.wav";
+
+    if (! writeModel(gruFile, kModelGRU8) || ! writeModel(lstmFile, kModelLSTM80x3) || ! writeLongImpulse(impulseFile))
+    {
+        std::fprintf(stderr, "cannot write test files to %s\n", options.workDir.c_str());
+        return 1;
+    }
+
+    const std::vector<float> input = generateSignal();
+    const bool checkThroughput = ! options.throughputBaseline.empty();
+    std::map<std::string, double> throughputBaseline;
+    std::vector<float> output, reference;
+    bool ok = true;
+
+    // setups missing from the baseline fail below, unless it is being recorded
+    if (checkThroughput && ! readThroughputBaseline(options.throughputBaseline, throughputBaseline)
+        && ! options.updateThroughput)
+        std::fprintf(stderr, "cannot read throughput baseline %s, record one with --update-throughput\n",
+                     options.throughputBaseline.c_str());
+
+    std::printf("%-20s %10s %10s %8s %10s %10s  %s\n",
+                "setup", "realtime", "baseline", "change", "ESR", "max error", "status");
+
+    for (const Setup& setup : kSetups)
+    {
+        if (options.only != nullptr && std::strcmp(options.only, setup.name) != 0)
+            continue;
+
+        PluginSetup pluginSetup;
+        pluginSetup.model = setup.model == kModelGRU8 ? gruFile.c_str()
+                          : setup.model == kModelLSTM80x3 ? lstmFile.c_str()
+                          : nullptr;
+        pluginSetup.cabinets[0] = setup.longImpulse ? impulseFile.c_str() : nullptr;
+        pluginSetup.parameters = setup.parameters;
+
+        std::vector<float> firstOutput;
+        double bestTime = 0.0;
+
+        // offline rendering makes the output the same on every run
+        for (uint run = 0; run < options.runs; ++run)
+        {
+            const double elapsed = render(setup, pluginSetup, input, output);
+
+            if (run == 0 || elapsed < bestTime)
+                bestTime = elapsed;
+            if (run == 0)
+                firstOutput.swap(output);
+        }
+
+        const double realtime = kSignalTime / bestTime;
+        const std::string referenceFile = options.referenceDir + setup.name + ".wav";
+
+        const char* status = "ok";
+        char esrText[16] = "";
+        char maxErrorText[16] = "";
+        char expectedText[16] = "";
+        char changeText[16] = "";
+
+        // output first, a throughput of wrong output means nothing
+        if (options.updateOutput)
+        {
+            status = writeWav(referenceFile, firstOutput) ? "output recorded" : "FAIL cannot write reference";
+        }
+        else if (! readWav(referenceFile, reference))
+        {
+            status = "FAIL no reference";
+        }
+        else if (reference.size() != firstOutput.size())
+        {
+            status = "FAIL reference length";
+        }
+        else
+        {
+            const OutputError error = getOutputError(firstOutput, reference);
+            std::snprintf(esrText, sizeof(esrText), "%.3g", error.esr);
+            std::snprintf(maxErrorText, sizeof(maxErrorText), "%.3g", error.maxError);
+
+            if (error.esr > options.tolerance || error.maxError > options.maxError)
+                status = "FAIL output";
+            else if (! error.exact)
+                status = options.strict ? "FAIL output changed" : "ok, output changed within tolerance";
+        }
+
+        if (std::strncmp(status, "FAIL", 4) != 0 && checkThroughput)
+        {
+            if (options.updateThroughput)
+            {
+                throughputBaseline[setup.name] = realtime;
+                status = options.updateOutput ? "output and throughput recorded" : "throughput recorded";
+            }
+            else if (throughputBaseline.find(setup.name) == throughputBaseline.end())
+            {
+                status = "FAIL no throughput baseline";
+            }
+            else
+            {
+                const double expected = throughputBaseline.find(setup.name)->second;
+                const double change = 100.0 * (realtime / expected - 1.0);
+                std::snprintf(expectedText, sizeof(expectedText), "%.1fx", expected);
+                std::snprintf(changeText, sizeof(changeText), "%+.1f%%", change);
+
+                if (change < -options.threshold)
+                    status = "FAIL slower";
+            }
+        }
+
+        if (std::strncmp(status, "FAIL", 4) == 0)
+            ok = false;
+
+        std::printf("%-20s %9.1fx %10s %8s %10s %10s  %s\n",
+                    setup.name, realtime, expectedText, changeText, esrText, maxErrorText, status);
+    }
+
+    std::remove(gruFile.c_str());
+    std::remove(lstmFile.c_str());
+    std::remove(impulseFile.c_str());
+
+    if (options.updateOutput && ok)
+        std::printf("reference renders written to %s\n", options.referenceDir.c_str());
+
+    // not over a good baseline while the output is wrong
+    if (options.updateThroughput && ok)
+    {
+        if (! writeThroughputBaseline(options.throughputBaseline, throughputBaseline))
+        {
+            std::fprintf(stderr, "cannot write %s\n", options.throughputBaseline.c_str());
+            return 1;
+        }
+
+        std::printf("throughput baseline written to %s\n", options.throughputBaseline.c_str());
+    }
+
+    return ok ? 0 : 1;
+}
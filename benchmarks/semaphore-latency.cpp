@@ -0,0 +1,88 @@
+/*
+ * AIDA-X semaphore wake-up latency benchmark
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Measures the time from post() to the waiting thread running again, for the DPF Semaphore and HybridSemaphore.
+// Posts are spaced by a fixed interval, short intervals mimic back-to-back tail jobs and long intervals mimic
+// a worker waking up once per audio period.
+
+#include "HybridSemaphore.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static uint64_t now() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// as used by idle workers, sleeping right away
+struct SleepingHybridSemaphore : HybridSemaphore
+{
+    bool wait() noexcept
+    {
+        return HybridSemaphore::wait(false);
+    }
+};
+
+template <class SemaphoreType>
+static std::vector<uint64_t> measure(const uint numIterations, const uint intervalMicros)
+{
+    SemaphoreType sem;
+    std::atomic<uint64_t> postTime { 0 };
+    std::vector<uint64_t> latencies;
+    latencies.reserve(numIterations);
+
+    std::thread waiter([&] {
+        for (uint i = 0; i < numIterations; ++i)
+        {
+            sem.wait();
+            latencies.push_back(now() - postTime.load(std::memory_order_acquire));
+        }
+    });
+
+    for (uint i = 0; i < numIterations; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(intervalMicros));
+        postTime.store(now(), std::memory_order_release);
+        sem.post();
+    }
+
+    waiter.join();
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+static void report(const char* const name, const std::vector<uint64_t>& latencies)
+{
+    const auto percentile = [&latencies](const double p) -> double {
+        return static_cast<double>(latencies[static_cast<size_t>(p * (latencies.size() - 1))]) / 1000.0;
+    };
+
+    std::printf("%-16s p50 %8.2f us  p90 %8.2f us  p99 %8.2f us  p99.9 %8.2f us  max %8.2f us\n",
+                name, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+}
+
+int main(int argc, char* argv[])
+{
+    const uint numIterations = argc > 1 ? static_cast<uint>(std::atoi(argv[1])) : 20000;
+
+    for (const uint intervalMicros : { 0u, 20u, 100u, 1000u })
+    {
+        std::printf("post interval %u us, %u iterations\n", intervalMicros, numIterations);
+        report("Semaphore", measure<Semaphore>(numIterations, intervalMicros));
+        report("HybridSemaphore", measure<HybridSemaphore>(numIterations, intervalMicros));
+        report("Hybrid, no spin", measure<SleepingHybridSemaphore>(numIterations, intervalMicros));
+    }
+
+    return 0;
+}
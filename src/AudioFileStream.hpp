@@ -0,0 +1,335 @@
+/*
+ * AIDA-X streaming audio file reader
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+#include "extra/Mutex.hpp"
+#include "extra/Sleep.hpp"
+#include "extra/Thread.hpp"
+
+#include "dr_flac.h"
+#include "dr_wav.h"
+#include "CDSPResampler.h"
+
+#include <atomic>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Audio file played in a loop, decoded a chunk at a time instead of being loaded whole.
+// fill() decodes the left channel through dr_wav or dr_flac, resamples it to the host rate with a streaming r8brain
+// resampler and pushes it into a lock-free ring buffer, read() takes it out on the audio thread.
+// At the end of the file decoding continues from its start within the same chunk, so the resampler sees one
+// continuous signal and the loop point is seamless.
+
+class AudioFileStream
+{
+public:
+    // frames decoded at a time
+    static constexpr const uint32_t kDecodeFrames = 1024;
+    // audio kept ahead of playback, in seconds
+    static constexpr const double kBufferTime = 2.0;
+
+   /**
+      Open @a filename for playback at @a hostSampleRate, returns null if the file cannot be decoded.
+      The ring buffer is filled before returning, so playback can start right away.
+    */
+    static AudioFileStream* open(const char* const filename, const double hostSampleRate)
+    {
+        AudioFileStream* const stream = new AudioFileStream();
+
+        if (! stream->openDecoder(filename) || ! stream->init(hostSampleRate))
+        {
+            delete stream;
+            return nullptr;
+        }
+
+        stream->fill();
+        return stream;
+    }
+
+    ~AudioFileStream()
+    {
+        delete resampler;
+
+        if (flac != nullptr)
+            drflac_close(flac);
+        if (wavOpen)
+            drwav_uninit(&wav);
+    }
+
+   /**
+      Copy the next @a numFrames frames into @a out, with silence for any frames not decoded in time.
+      Realtime safe, must only be called from a single thread.
+    */
+    void read(float* const out, const uint32_t numFrames) noexcept
+    {
+        const uint32_t readPos = ringRead.load(std::memory_order_relaxed);
+        const uint32_t available = ringWrite.load(std::memory_order_acquire) - readPos;
+        const uint32_t numRead = std::min(available, numFrames);
+
+        const uint32_t start = readPos & ringMask;
+        const uint32_t numFirst = std::min(numRead, ringMask + 1 - start);
+        std::memcpy(out, ring.data() + start, sizeof(float) * numFirst);
+        std::memcpy(out + numFirst, ring.data(), sizeof(float) * (numRead - numFirst));
+
+        if (numRead != numFrames)
+        {
+            std::memset(out + numRead, 0, sizeof(float) * (numFrames - numRead));
+            numUnderruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ringRead.store(readPos + numRead, std::memory_order_release);
+    }
+
+   /**
+      Decode ahead until the ring buffer is full, or at most @a maxFrames were added.
+      Not realtime safe, must only be called from a single thread. Returns the number of frames added.
+    */
+    uint32_t fill(const uint32_t maxFrames = UINT32_MAX)
+    {
+        uint32_t numFilled = 0;
+
+        while (numFilled < maxFrames && ! failed)
+        {
+            const uint32_t writePos = ringWrite.load(std::memory_order_relaxed);
+            const uint32_t space = ringMask + 1 - (writePos - ringRead.load(std::memory_order_acquire));
+
+            if (space < maxChunkOutput)
+                break;
+
+            uint32_t numDecoded;
+            if (! decodeChunk(writePos, numDecoded))
+            {
+                d_stderr("Failed to decode audio file, playback stops");
+                failed = true;
+                break;
+            }
+
+            ringWrite.store(writePos + numDecoded, std::memory_order_release);
+            numFilled += numDecoded;
+        }
+
+        return numFilled;
+    }
+
+   /**
+      Check if the ring buffer is below half full, for readers that want to decode in larger batches.
+    */
+    bool needsFill() const noexcept
+    {
+        return ringWrite.load(std::memory_order_relaxed) - ringRead.load(std::memory_order_relaxed) < (ringMask + 1) / 2;
+    }
+
+    uint32_t getNumUnderruns() const noexcept
+    {
+        return numUnderruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    drwav wav;
+    bool wavOpen = false;
+    drflac* flac = nullptr;
+    uint channels = 0;
+    uint sampleRate = 0;
+    r8b::CDSPResampler24* resampler = nullptr;
+    uint32_t maxChunkOutput = 0;
+    bool failed = false;
+
+    std::vector<float> decodeBuffer;
+    std::vector<double> resampleBuffer;
+
+    std::vector<float> ring;
+    uint32_t ringMask = 0;
+    std::atomic<uint32_t> ringRead { 0 };
+    std::atomic<uint32_t> ringWrite { 0 };
+    std::atomic<uint32_t> numUnderruns { 0 };
+
+    AudioFileStream() {}
+
+    bool openDecoder(const char* const filename)
+    {
+        if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
+        {
+            flac = drflac_open_file(filename, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(flac != nullptr, false);
+
+            channels = flac->channels;
+            sampleRate = flac->sampleRate;
+        }
+        else
+        {
+            wavOpen = drwav_init_file(&wav, filename, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(wavOpen, false);
+
+            channels = wav.channels;
+            sampleRate = wav.sampleRate;
+        }
+
+        DISTRHO_SAFE_ASSERT_RETURN(channels != 0 && sampleRate != 0, false);
+        return true;
+    }
+
+    bool init(const double hostSampleRate)
+    {
+        decodeBuffer.resize(kDecodeFrames * channels);
+        maxChunkOutput = kDecodeFrames;
+
+        if (sampleRate != hostSampleRate)
+        {
+            resampler = new r8b::CDSPResampler24(sampleRate, hostSampleRate, kDecodeFrames);
+            resampleBuffer.resize(kDecodeFrames);
+
+            const int maxOutput = resampler->getMaxOutLen(kDecodeFrames);
+            DISTRHO_SAFE_ASSERT_RETURN(maxOutput > 0, false);
+
+            maxChunkOutput = static_cast<uint32_t>(maxOutput);
+        }
+
+        // power of 2 capacity, so positions can wrap around freely
+        uint32_t capacity = 1;
+        while (capacity < hostSampleRate * kBufferTime || capacity < maxChunkOutput * 2)
+            capacity *= 2;
+
+        ring.resize(capacity);
+        ringMask = capacity - 1;
+        return true;
+    }
+
+    uint32_t readFrames(const uint32_t offset, const uint32_t numFrames)
+    {
+        float* const buffer = decodeBuffer.data() + offset * channels;
+
+        if (flac != nullptr)
+            return static_cast<uint32_t>(drflac_read_pcm_frames_f32(flac, numFrames, buffer));
+
+        return static_cast<uint32_t>(drwav_read_pcm_frames_f32(&wav, numFrames, buffer));
+    }
+
+    bool rewind()
+    {
+        if (flac != nullptr)
+            return drflac_seek_to_pcm_frame(flac, 0);
+
+        return drwav_seek_to_pcm_frame(&wav, 0);
+    }
+
+    // decodes, resamples and writes one chunk at ring position writePos
+    bool decodeChunk(const uint32_t writePos, uint32_t& numWritten)
+    {
+        uint32_t numFrames = 0;
+        bool rewound = false;
+
+        while (numFrames < kDecodeFrames)
+        {
+            const uint32_t numRead = readFrames(numFrames, kDecodeFrames - numFrames);
+
+            if (numRead != 0)
+            {
+                numFrames += numRead;
+                rewound = false;
+                continue;
+            }
+
+            // end of file, loop back to its start. nothing read right after that means nothing can be decoded
+            if (rewound || ! rewind())
+                return false;
+
+            rewound = true;
+        }
+
+        // use left channel if not mono
+        const float* input = decodeBuffer.data();
+
+        if (channels > 1)
+        {
+            for (uint32_t i = 0; i < kDecodeFrames; ++i)
+                decodeBuffer[i] = decodeBuffer[i * channels];
+        }
+
+        if (resampler == nullptr)
+        {
+            const uint32_t start = writePos & ringMask;
+            const uint32_t numFirst = std::min(kDecodeFrames, ringMask + 1 - start);
+            std::memcpy(ring.data() + start, input, sizeof(float) * numFirst);
+            std::memcpy(ring.data(), input + numFirst, sizeof(float) * (kDecodeFrames - numFirst));
+            numWritten = kDecodeFrames;
+            return true;
+        }
+
+        for (uint32_t i = 0; i < kDecodeFrames; ++i)
+            resampleBuffer[i] = input[i];
+
+        // the resampler keeps its state across chunks and loop points, output starts once its latency is filled
+        double* output;
+        const int numOutput = resampler->process(resampleBuffer.data(), kDecodeFrames, output);
+
+        for (int i = 0; i < numOutput; ++i)
+            ring[(writePos + i) & ringMask] = static_cast<float>(output[i]);
+
+        numWritten = static_cast<uint32_t>(std::max(0, numOutput));
+        return true;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(AudioFileStream)
+};
+
+#ifndef DISTRHO_OS_WASM
+// --------------------------------------------------------------------------------------------------------------------
+// Disk thread keeping an AudioFileStream ahead of playback.
+
+class AudioFileStreamReader : public Thread
+{
+public:
+    AudioFileStreamReader()
+        : Thread("AudioFileStreamReader")
+    {
+        startThread();
+    }
+
+    ~AudioFileStreamReader()
+    {
+        stopThread(-1);
+    }
+
+   /**
+      Set the stream to keep filled, the previous one is no longer used once this returns.
+    */
+    void setStream(AudioFileStream* const newStream)
+    {
+        const MutexLocker cml(mutex);
+        stream = newStream;
+    }
+
+protected:
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            {
+                const MutexLocker cml(mutex);
+
+                // decode in batches of half the buffer, fewer and longer wakeups
+                if (stream != nullptr && stream->needsFill())
+                    stream->fill();
+            }
+
+            d_msleep(10);
+        }
+    }
+
+private:
+    Mutex mutex;
+    AudioFileStream* stream = nullptr;
+
+    DISTRHO_DECLARE_NON_COPYABLE(AudioFileStreamReader)
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,338 @@
+/*
+ * AIDA-X batched model inference
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+
+#include <RTNeural/RTNeural.h>
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs several streams through one model in lockstep, each stream with its own state. Each RTNeural model does its
+// own matrix-vector products per sample, so with K streams every weight is loaded K times per time step. Here each block of weights is loaded once per time step and multiplied
+// against the inputs and hidden states of all streams, accumulating in registers for a few streams at a time.
+// Gates and states are laid out so that each of them spans all streams contiguously, and the hidden size is padded
+// to whole row blocks with zero weights, so that all elementwise stages run over long vectorized ranges.
+// Supports the architectures of model_variant.hpp, a single GRU or LSTM layer followed by a dense output, loaded
+// from the same json files. Outputs match separate RTNeural models up to float rounding.
+// The plugin uses it for linked stereo, where both channels of an instance share its model, and for instances of
+// the same model running in one process, such as chains of the rack, see ModelBatchGroup.
+
+class BatchedModel
+{
+public:
+    static constexpr const uint kMaxStreams = 16;
+
+    // same as MAX_INPUT_SIZE in model_variant.hpp
+    static constexpr const int kMaxInputSize = 3;
+
+    BatchedModel() = default;
+
+   /**
+      Load the weights of @a modelJson for @a streams streams, all starting from a zero state.
+      Returns false if the architecture is not supported, throws on malformed json like the RTNeural loader does.
+      Either way the model is left unloaded, with no streams, until a load succeeds.
+    */
+    bool load(const nlohmann::json& modelJson, const uint streams)
+    {
+        numStreams = 0;
+
+        DISTRHO_SAFE_ASSERT_RETURN(streams != 0 && streams <= kMaxStreams, false);
+
+        const nlohmann::json& layers(modelJson.at("layers"));
+        DISTRHO_SAFE_ASSERT_RETURN(layers.size() == 2, false);
+
+        const nlohmann::json& rnn(layers.at(0));
+        const nlohmann::json& dense(layers.at(1));
+        const std::string type = rnn.at("type").get<std::string>();
+
+        DISTRHO_SAFE_ASSERT_RETURN(type == "gru" || type == "lstm", false);
+        DISTRHO_SAFE_ASSERT_RETURN(dense.at("type").get<std::string>() == "dense", false);
+        DISTRHO_SAFE_ASSERT_RETURN(dense.at("shape").back().get<int>() == 1, false);
+
+        lstm = type == "lstm";
+        inputSize = modelJson.at("in_shape").back().get<int>();
+        hiddenSize = rnn.at("shape").back().get<int>();
+        numGates = lstm ? 4 : 3;
+
+        DISTRHO_SAFE_ASSERT_RETURN(inputSize >= 1 && inputSize <= kMaxInputSize, false);
+        DISTRHO_SAFE_ASSERT_RETURN(hiddenSize >= 1, false);
+
+        // padded units have zero weights and biases, their state stays at zero
+        paddedSize = (hiddenSize + kRowBlockSize - 1) / kRowBlockSize * kRowBlockSize;
+        batchSize = static_cast<int>(streams);
+
+        // keras layout, kernels are (inputs, gates * hidden) and gates come in z, r, h (gru) or i, f, c, o (lstm)
+        const nlohmann::json& weights(rnn.at("weights"));
+        const nlohmann::json& kernel(weights.at(0));
+        const nlohmann::json& recurrentKernel(weights.at(1));
+        const nlohmann::json& bias(weights.at(2));
+        const int numValues = batchSize * paddedSize;
+
+        inputWeights.setZero(numGates * paddedSize, inputSize);
+        recurrentWeights.setZero(numGates * paddedSize, paddedSize);
+        inputBias.setZero(numGates * numValues);
+        recurrentBias.setZero(numGates * numValues);
+
+        for (int g = 0; g < numGates; ++g)
+        {
+            for (int u = 0; u < hiddenSize; ++u)
+            {
+                const int src = g * hiddenSize + u;
+                const int row = g * paddedSize + u;
+
+                for (int i = 0; i < inputSize; ++i)
+                    inputWeights(row, i) = kernel.at(i).at(src).get<float>();
+
+                for (int h = 0; h < hiddenSize; ++h)
+                    recurrentWeights(row, h) = recurrentKernel.at(h).at(src).get<float>();
+
+                // gru keeps separate input and recurrent biases, the recurrent one goes inside the reset gate
+                const float ibias = (lstm ? bias.at(src) : bias.at(0).at(src)).get<float>();
+                const float rbias = lstm ? 0.f : bias.at(1).at(src).get<float>();
+
+                // biases are stored in the same layout as the gates, one copy per stream
+                for (int k = 0; k < batchSize; ++k)
+                {
+                    inputBias(g * numValues + k * paddedSize + u) = ibias;
+                    recurrentBias(g * numValues + k * paddedSize + u) = rbias;
+                }
+            }
+        }
+
+        const nlohmann::json& denseWeights(dense.at("weights"));
+
+        outputWeights.setZero(paddedSize);
+        for (int h = 0; h < hiddenSize; ++h)
+            outputWeights(h) = denseWeights.at(0).at(h).at(0).get<float>();
+        outputBias = denseWeights.at(1).at(0).get<float>();
+
+        inputs.setZero(batchSize * inputSize);
+        gates.resize(numGates * numValues);
+        recurrentGates.resize(numGates * numValues);
+        state.resize(numValues);
+        cell.resize(numValues);
+        candidate.resize(numValues);
+
+        reset();
+        numStreams = streams;
+        return true;
+    }
+
+    void reset() noexcept
+    {
+        state.setZero();
+        cell.setZero();
+    }
+
+    uint getNumStreams() const noexcept
+    {
+        return numStreams;
+    }
+
+    int getInputSize() const noexcept
+    {
+        return inputSize;
+    }
+
+   /**
+      Number of values saveStream() and restoreStream() copy per stream.
+    */
+    uint getStreamStateSize() const noexcept
+    {
+        return static_cast<uint>(2 * paddedSize);
+    }
+
+   /**
+      Copy the state of stream @a k to @a buffer, so that it can sit out a step and have it restored afterwards.
+    */
+    void saveStream(const uint k, float* const buffer) const noexcept
+    {
+        std::memcpy(buffer, state.data() + k * paddedSize, sizeof(float) * paddedSize);
+        std::memcpy(buffer + paddedSize, cell.data() + k * paddedSize, sizeof(float) * paddedSize);
+    }
+
+    void restoreStream(const uint k, const float* const buffer) noexcept
+    {
+        std::memcpy(state.data() + k * paddedSize, buffer, sizeof(float) * paddedSize);
+        std::memcpy(cell.data() + k * paddedSize, buffer + paddedSize, sizeof(float) * paddedSize);
+    }
+
+   /**
+      Clear the state of stream @a k only, the others keep theirs.
+    */
+    void resetStream(const uint k) noexcept
+    {
+        std::memset(state.data() + k * paddedSize, 0, sizeof(float) * paddedSize);
+        std::memset(cell.data() + k * paddedSize, 0, sizeof(float) * paddedSize);
+    }
+
+   /**
+      Advance all streams by @a numSamples. Stream k reads @a numSamples frames of getInputSize() interleaved values
+      from @a in[k] and writes @a numSamples values to @a out[k], which can be the same buffer. Realtime safe.
+    */
+    void process(const float* const* const in, float* const* const out, const uint32_t numSamples) noexcept
+    {
+        for (uint32_t t = 0; t < numSamples; ++t)
+        {
+            for (int k = 0; k < batchSize; ++k)
+                for (int i = 0; i < inputSize; ++i)
+                    inputs(k * inputSize + i) = in[k][t * inputSize + i];
+
+            if (lstm)
+                stepLSTM();
+            else
+                stepGRU();
+
+            for (int k = 0; k < batchSize; ++k)
+                out[k][t] = state.matrix().segment(k * paddedSize, paddedSize).dot(outputWeights) + outputBias;
+        }
+    }
+
+private:
+    // products run over blocks of this many gate rows, accumulating in registers for a few streams at a time
+    static constexpr const int kRowBlockSize = 8;
+
+    typedef Eigen::Matrix<float, kRowBlockSize, 1> RowBlock;
+
+    bool lstm = false;
+    int inputSize = 0;
+    int hiddenSize = 0;
+    int paddedSize = 0;
+    int numGates = 0;
+    int batchSize = 0;
+    uint numStreams = 0;
+
+    // weights, column-major with one block of paddedSize rows per gate
+    Eigen::MatrixXf inputWeights;
+    Eigen::MatrixXf recurrentWeights;
+    Eigen::VectorXf outputWeights;
+    float outputBias = 0.f;
+
+    // per stream values are paddedSize apart, per gate values (and biases) paddedSize * streams apart
+    Eigen::ArrayXf inputBias;
+    Eigen::ArrayXf recurrentBias;
+    Eigen::ArrayXf inputs;
+    Eigen::ArrayXf gates;
+    Eigen::ArrayXf recurrentGates;
+    Eigen::ArrayXf state;
+    Eigen::ArrayXf cell;
+    Eigen::ArrayXf candidate;
+
+    template <int kNumStreams>
+    static void accumulateRowBlock(float* const out, const int outStride,
+                                   const float* const weights, const int weightsStride,
+                                   const float* const in, const int numInputs) noexcept
+    {
+        RowBlock acc[kNumStreams];
+
+        for (int k = 0; k < kNumStreams; ++k)
+            acc[k] = Eigen::Map<const RowBlock>(out + k * outStride);
+
+        // each block of weights is loaded once for all streams
+        for (int j = 0; j < numInputs; ++j)
+        {
+            const Eigen::Map<const RowBlock> w(weights + j * weightsStride);
+
+            for (int k = 0; k < kNumStreams; ++k)
+                acc[k].noalias() += w * in[k * numInputs + j];
+        }
+
+        for (int k = 0; k < kNumStreams; ++k)
+            Eigen::Map<RowBlock>(out + k * outStride) = acc[k];
+    }
+
+    // out += weights * in for all streams, in holding weights.cols() values per stream
+    void accumulateProduct(Eigen::ArrayXf& out, const Eigen::MatrixXf& weights, const Eigen::ArrayXf& in) noexcept
+    {
+        const int numRows = static_cast<int>(weights.rows());
+        const int numInputs = static_cast<int>(weights.cols());
+
+        for (int g = 0; g < numGates; ++g)
+        {
+            for (int u = 0; u < paddedSize; u += kRowBlockSize)
+            {
+                const float* const w = weights.data() + g * paddedSize + u;
+                float* const o = out.data() + g * batchSize * paddedSize + u;
+
+                for (int k = 0; k < batchSize;)
+                {
+                    float* const ok = o + k * paddedSize;
+                    const float* const x = in.data() + k * numInputs;
+
+                    switch (std::min(batchSize - k, 4))
+                    {
+                    case 4:
+                        accumulateRowBlock<4>(ok, paddedSize, w, numRows, x, numInputs);
+                        k += 4;
+                        break;
+                    case 3:
+                        accumulateRowBlock<3>(ok, paddedSize, w, numRows, x, numInputs);
+                        k += 3;
+                        break;
+                    case 2:
+                        accumulateRowBlock<2>(ok, paddedSize, w, numRows, x, numInputs);
+                        k += 2;
+                        break;
+                    default:
+                        accumulateRowBlock<1>(ok, paddedSize, w, numRows, x, numInputs);
+                        k += 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Expr>
+    static auto sigmoid(const Expr& x) noexcept
+    {
+        return 1.f / (1.f + (-x).exp());
+    }
+
+    void stepGRU() noexcept
+    {
+        const int n = batchSize * paddedSize;
+
+        gates = inputBias;
+        accumulateProduct(gates, inputWeights, inputs);
+        recurrentGates = recurrentBias;
+        accumulateProduct(recurrentGates, recurrentWeights, state);
+
+        // update and reset gates, in a single range
+        gates.head(2 * n) = sigmoid(gates.head(2 * n) + recurrentGates.head(2 * n));
+
+        // candidate, then blend with the previous state
+        candidate = (gates.segment(2 * n, n) + gates.segment(n, n) * recurrentGates.segment(2 * n, n)).tanh();
+        state = candidate + gates.head(n) * (state - candidate);
+    }
+
+    void stepLSTM() noexcept
+    {
+        const int n = batchSize * paddedSize;
+
+        gates = inputBias;
+        accumulateProduct(gates, inputWeights, inputs);
+        accumulateProduct(gates, recurrentWeights, state);
+
+        // input and forget gates in a single range, then the cell and output gate
+        gates.head(2 * n) = sigmoid(gates.head(2 * n));
+        cell = gates.segment(n, n) * cell + gates.head(n) * gates.segment(2 * n, n).tanh();
+        state = sigmoid(gates.segment(3 * n, n)) * cell.tanh();
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(BatchedModel)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
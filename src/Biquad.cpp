@@ -27,9 +27,13 @@ Biquad::Biquad() {
     Q = 0.707;
     peakGain = 0.0;
     z1 = z2 = 0.0;
+    cachedFc = cachedGain = -1.0;
+    cachedK = cachedV = 0.0;
 }
 
 Biquad::Biquad(int type, double Fc, double Q, double peakGainDB) {
+    cachedFc = cachedGain = -1.0;
+    cachedK = cachedV = 0.0;
     setBiquad(type, Fc, Q, peakGainDB);
     z1 = z2 = 0.0;
 }
@@ -66,8 +70,16 @@ void Biquad::setBiquad(int type, double Fc, double Q, double peakGainDB) {
 
 void Biquad::calcBiquad(void) {
     double norm;
-    double V = pow(10, fabs(peakGain) / 20.0);
-    double K = tan(M_PI * Fc);
+    if (fabs(peakGain) != cachedGain) {
+        cachedGain = fabs(peakGain);
+        cachedV = pow(10, cachedGain / 20.0);
+    }
+    if (Fc != cachedFc) {
+        cachedFc = Fc;
+        cachedK = tan(M_PI * Fc);
+    }
+    double V = cachedV;
+    double K = cachedK;
     switch (this->type) {
         case bq_type_lowpass:
             norm = 1 / (1 + K / Q + K * K);
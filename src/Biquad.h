@@ -40,6 +40,12 @@ public:
     void setPeakGain(double peakGainDB);
     void setBiquad(int type, double Fc, double Q, double peakGainDB);
     float process(float in);
+    bool isIdentity() const;
+    bool hasDecayed() const;
+    void reset();
+    void getCoefficients(double coefficients[5]) const;
+    void getState(double& z1, double& z2) const;
+    void setState(double z1, double z2);
 
 protected:
     void calcBiquad(void);
@@ -48,6 +54,10 @@ protected:
     double a0, a1, a2, b1, b2;
     double Fc, Q, peakGain;
     double z1, z2;
+
+    // tan() and pow() results for the last Fc and gain, reused when only other parameters change
+    double cachedFc, cachedK;
+    double cachedGain, cachedV;
 };
 
 inline float Biquad::process(float in) {
@@ -57,4 +67,37 @@ inline float Biquad::process(float in) {
     return out;
 }
 
+// peaking and shelving filters at 0 dB gain pass audio unchanged
+inline bool Biquad::isIdentity() const {
+    return peakGain == 0.0 && (type == bq_type_peak || type == bq_type_lowshelf || type == bq_type_highshelf);
+}
+
+// state left over from previous input or coefficients is below audibility
+inline bool Biquad::hasDecayed() const {
+    return z1 < 1e-9 && z1 > -1e-9 && z2 < 1e-9 && z2 > -1e-9;
+}
+
+inline void Biquad::reset() {
+    z1 = z2 = 0.0;
+}
+
+// a0, a1, a2, b1, b2, for running the same filter elsewhere (see BiquadCascade)
+inline void Biquad::getCoefficients(double coefficients[5]) const {
+    coefficients[0] = a0;
+    coefficients[1] = a1;
+    coefficients[2] = a2;
+    coefficients[3] = b1;
+    coefficients[4] = b2;
+}
+
+inline void Biquad::getState(double& z1, double& z2) const {
+    z1 = this->z1;
+    z2 = this->z2;
+}
+
+inline void Biquad::setState(double z1, double z2) {
+    this->z1 = z1;
+    this->z2 = z2;
+}
+
 #endif // Biquad_h
@@ -0,0 +1,781 @@
+/*
+ * AIDA-X biquad cascade
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "Biquad.h"
+#include "DistrhoUtils.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+// vectorized cascade, can be turned off at build time
+#ifndef AIDAX_BIQUAD_SIMD
+# if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define AIDAX_BIQUAD_SIMD 1
+# elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define AIDAX_BIQUAD_SIMD 1
+# else
+#  define AIDAX_BIQUAD_SIMD 0
+# endif
+#endif
+
+#if AIDAX_BIQUAD_SIMD
+# if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+# else
+#  include <emmintrin.h>
+# endif
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs several Biquad filters in series within a single pass over the audio, all sections per sample in registers.
+// Filters are loaded with add() and their state is written back with storeStates(), so the Biquad objects stay the
+// reference for coefficients and state, and a cascade can be rebuilt every block at no real cost.
+// Sections use the same direct form II transposed as Biquad::process(), rounding to float in between, so that a
+// double precision cascade gives bit-exact results against calling each Biquad in turn.
+// Sections can also ramp their coefficients linearly over one process() call, for parameter changes without zipper
+// noise. Each intermediate set lies between two stable filters and so is stable as well.
+
+template <typename T>
+class BiquadCascade
+{
+public:
+    static constexpr const uint32_t kMaxSections = 8;
+
+private:
+    struct Section {
+        T a0, a1, a2, b1, b2;
+        T z1, z2;
+        // coefficients reached at the end of a ramp
+        T ta0, ta1, ta2, tb1, tb2;
+    };
+
+    Section sections[kMaxSections];
+    Biquad* sources[kMaxSections];
+    uint32_t numSections = 0;
+    bool ramping = false;
+
+public:
+    BiquadCascade() noexcept {}
+
+    void clear() noexcept
+    {
+        numSections = 0;
+        ramping = false;
+    }
+
+    uint32_t getNumSections() const noexcept
+    {
+        return numSections;
+    }
+
+    // with rampFrom set (a0, a1, a2, b1, b2) coefficients move from those to the filter ones over the next process()
+    bool add(Biquad& biquad, const double* const rampFrom = nullptr) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSections < kMaxSections, false);
+
+        double coefficients[5], z1, z2;
+        biquad.getCoefficients(coefficients);
+        biquad.getState(z1, z2);
+
+        const double* const start = rampFrom != nullptr ? rampFrom : coefficients;
+
+        Section& section(sections[numSections]);
+        section.a0 = static_cast<T>(start[0]);
+        section.a1 = static_cast<T>(start[1]);
+        section.a2 = static_cast<T>(start[2]);
+        section.b1 = static_cast<T>(start[3]);
+        section.b2 = static_cast<T>(start[4]);
+        section.z1 = static_cast<T>(z1);
+        section.z2 = static_cast<T>(z2);
+        section.ta0 = static_cast<T>(coefficients[0]);
+        section.ta1 = static_cast<T>(coefficients[1]);
+        section.ta2 = static_cast<T>(coefficients[2]);
+        section.tb1 = static_cast<T>(coefficients[3]);
+        section.tb2 = static_cast<T>(coefficients[4]);
+
+        ramping |= rampFrom != nullptr;
+        sources[numSections++] = &biquad;
+        return true;
+    }
+
+    void storeStates() const noexcept
+    {
+        for (uint32_t i = 0; i < numSections; ++i)
+            sources[i]->setState(sections[i].z1, sections[i].z2);
+    }
+
+    // in-place processing is allowed
+    void process(float* const out, const float* const in, const uint32_t numSamples) noexcept
+    {
+        if (ramping && numSamples != 0)
+        {
+            processSamples<true>(out, in, numSamples);
+
+            // land exactly on the target, rounding adds up along the ramp
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                Section& section(sections[s]);
+                section.a0 = section.ta0;
+                section.a1 = section.ta1;
+                section.a2 = section.ta2;
+                section.b1 = section.tb1;
+                section.b2 = section.tb2;
+            }
+
+            ramping = false;
+            return;
+        }
+
+        processSamples<false>(out, in, numSamples);
+    }
+
+private:
+    template <bool kRamp>
+    void processSamples(float* const out, const float* const in, const uint32_t numSamples) noexcept
+    {
+        // per sample coefficient steps, reaching the target coefficients (give or take rounding) on the last sample
+        T da0[kMaxSections], da1[kMaxSections], da2[kMaxSections], db1[kMaxSections], db2[kMaxSections];
+
+        if (kRamp)
+        {
+            const T length = static_cast<T>(numSamples);
+
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                const Section& section(sections[s]);
+                da0[s] = (section.ta0 - section.a0) / length;
+                da1[s] = (section.ta1 - section.a1) / length;
+                da2[s] = (section.ta2 - section.a2) / length;
+                db1[s] = (section.tb1 - section.b1) / length;
+                db2[s] = (section.tb2 - section.b2) / length;
+            }
+        }
+
+        for (uint32_t i = 0; i < numSamples; ++i)
+        {
+            float x = in[i];
+
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                Section& section(sections[s]);
+
+                if (kRamp)
+                {
+                    section.a0 += da0[s];
+                    section.a1 += da1[s];
+                    section.a2 += da2[s];
+                    section.b1 += db1[s];
+                    section.b2 += db2[s];
+                }
+
+                const T y = x * section.a0 + section.z1;
+                section.z1 = x * section.a1 + section.z2 - section.b1 * y;
+                section.z2 = x * section.a2 - section.b2 * y;
+                x = static_cast<float>(y);
+            }
+
+            out[i] = x;
+        }
+    }
+};
+
+#if AIDAX_BIQUAD_SIMD
+// --------------------------------------------------------------------------------------------------------------------
+// Single precision cascade with the sections spread over SIMD lanes, same API as BiquadCascade.
+// Lanes form a pipeline: during each step lane k runs section k on the sample lane k-1 produced during the previous
+// step, so 4 sections (or 8, over 2 vectors) run at once. The pipeline is filled and drained within each call,
+// lanes without a sample to work on keep their state, so there is no added latency and the results match a scalar
+// float cascade. Unused lanes run pass-through sections.
+
+class BiquadCascadeSIMD
+{
+public:
+    static constexpr const uint32_t kMaxSections = 8;
+
+private:
+    static constexpr const uint32_t kNumLanes = 4;
+    static constexpr const uint32_t kMaxVectors = kMaxSections / kNumLanes;
+
+   #if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    typedef float32x4_t Vector;
+
+    static inline Vector vset(const float v) noexcept { return vdupq_n_f32(v); }
+    static inline Vector vload(const float* const v) noexcept { return vld1q_f32(v); }
+    static inline void vstore(float* const dest, const Vector v) noexcept { vst1q_f32(dest, v); }
+    static inline Vector vadd(const Vector a, const Vector b) noexcept { return vaddq_f32(a, b); }
+    static inline Vector vsub(const Vector a, const Vector b) noexcept { return vsubq_f32(a, b); }
+    static inline Vector vmul(const Vector a, const Vector b) noexcept { return vmulq_f32(a, b); }
+    static inline float vlast(const Vector v) noexcept { return vgetq_lane_f32(v, 3); }
+
+    // [prev[3], next[0], next[1], next[2]]
+    static inline Vector vshift(const Vector prev, const Vector next) noexcept { return vextq_f32(prev, next, 3); }
+
+    // a where 0 <= pos < end, b elsewhere
+    static inline Vector vselect(const Vector pos, const Vector end, const Vector a, const Vector b) noexcept
+    {
+        const uint32x4_t mask = vandq_u32(vcgeq_f32(pos, vdupq_n_f32(0.f)), vcltq_f32(pos, end));
+        return vbslq_f32(mask, a, b);
+    }
+   #else
+    typedef __m128 Vector;
+
+    static inline Vector vset(const float v) noexcept { return _mm_set1_ps(v); }
+    static inline Vector vload(const float* const v) noexcept { return _mm_load_ps(v); }
+    static inline void vstore(float* const dest, const Vector v) noexcept { _mm_store_ps(dest, v); }
+    static inline Vector vadd(const Vector a, const Vector b) noexcept { return _mm_add_ps(a, b); }
+    static inline Vector vsub(const Vector a, const Vector b) noexcept { return _mm_sub_ps(a, b); }
+    static inline Vector vmul(const Vector a, const Vector b) noexcept { return _mm_mul_ps(a, b); }
+    static inline float vlast(const Vector v) noexcept { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+
+    // [prev[3], next[0], next[1], next[2]]
+    static inline Vector vshift(const Vector prev, const Vector next) noexcept
+    {
+        const Vector t = _mm_shuffle_ps(prev, next, _MM_SHUFFLE(0, 0, 3, 3));
+        return _mm_shuffle_ps(t, next, _MM_SHUFFLE(2, 1, 2, 0));
+    }
+
+    // a where 0 <= pos < end, b elsewhere
+    static inline Vector vselect(const Vector pos, const Vector end, const Vector a, const Vector b) noexcept
+    {
+        const Vector mask = _mm_and_ps(_mm_cmpge_ps(pos, _mm_setzero_ps()), _mm_cmplt_ps(pos, end));
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+   #endif
+
+    // coefficients and state, one lane per section
+    alignas(16) float a0[kMaxSections];
+    alignas(16) float a1[kMaxSections];
+    alignas(16) float a2[kMaxSections];
+    alignas(16) float b1[kMaxSections];
+    alignas(16) float b2[kMaxSections];
+    alignas(16) float z1[kMaxSections];
+    alignas(16) float z2[kMaxSections];
+    // coefficients reached at the end of a ramp
+    alignas(16) float ta0[kMaxSections];
+    alignas(16) float ta1[kMaxSections];
+    alignas(16) float ta2[kMaxSections];
+    alignas(16) float tb1[kMaxSections];
+    alignas(16) float tb2[kMaxSections];
+    Biquad* sources[kMaxSections];
+    uint32_t numSections = 0;
+    bool ramping = false;
+
+public:
+    BiquadCascadeSIMD() noexcept
+    {
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        for (uint32_t i = 0; i < kMaxSections; ++i)
+        {
+            a0[i] = ta0[i] = 1.f;
+            a1[i] = a2[i] = b1[i] = b2[i] = z1[i] = z2[i] = 0.f;
+            ta1[i] = ta2[i] = tb1[i] = tb2[i] = 0.f;
+        }
+
+        numSections = 0;
+        ramping = false;
+    }
+
+    uint32_t getNumSections() const noexcept
+    {
+        return numSections;
+    }
+
+    bool add(Biquad& biquad, const double* const rampFrom = nullptr) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSections < kMaxSections, false);
+
+        double coefficients[5], state1, state2;
+        biquad.getCoefficients(coefficients);
+        biquad.getState(state1, state2);
+
+        const double* const start = rampFrom != nullptr ? rampFrom : coefficients;
+
+        a0[numSections] = static_cast<float>(start[0]);
+        a1[numSections] = static_cast<float>(start[1]);
+        a2[numSections] = static_cast<float>(start[2]);
+        b1[numSections] = static_cast<float>(start[3]);
+        b2[numSections] = static_cast<float>(start[4]);
+        z1[numSections] = static_cast<float>(state1);
+        z2[numSections] = static_cast<float>(state2);
+        ta0[numSections] = static_cast<float>(coefficients[0]);
+        ta1[numSections] = static_cast<float>(coefficients[1]);
+        ta2[numSections] = static_cast<float>(coefficients[2]);
+        tb1[numSections] = static_cast<float>(coefficients[3]);
+        tb2[numSections] = static_cast<float>(coefficients[4]);
+
+        ramping |= rampFrom != nullptr;
+        sources[numSections++] = &biquad;
+        return true;
+    }
+
+    void storeStates() const noexcept
+    {
+        for (uint32_t i = 0; i < numSections; ++i)
+            sources[i]->setState(z1[i], z2[i]);
+    }
+
+    // in-place processing is allowed
+    void process(float* const out, const float* const in, const uint32_t numSamples) noexcept
+    {
+        if (numSections == 0)
+        {
+            if (out != in)
+                std::memcpy(out, in, sizeof(float) * numSamples);
+            return;
+        }
+
+        if (ramping && numSamples != 0)
+        {
+            if (numSections <= kNumLanes)
+                processVectors<1, true>(out, in, numSamples);
+            else
+                processVectors<2, true>(out, in, numSamples);
+
+            std::memcpy(a0, ta0, sizeof(a0));
+            std::memcpy(a1, ta1, sizeof(a1));
+            std::memcpy(a2, ta2, sizeof(a2));
+            std::memcpy(b1, tb1, sizeof(b1));
+            std::memcpy(b2, tb2, sizeof(b2));
+            ramping = false;
+            return;
+        }
+
+        if (numSections <= kNumLanes)
+            processVectors<1, false>(out, in, numSamples);
+        else
+            processVectors<2, false>(out, in, numSamples);
+    }
+
+private:
+    template <uint32_t kNumVectors, bool kRamp>
+    void processVectors(float* const out, const float* const in, const uint32_t numSamples) noexcept
+    {
+        static constexpr const uint32_t kNumStages = kNumVectors * kNumLanes;
+
+        Vector va0[kNumVectors], va1[kNumVectors], va2[kNumVectors], vb1[kNumVectors], vb2[kNumVectors];
+        Vector vz1[kNumVectors], vz2[kNumVectors], vy[kNumVectors], vpos[kNumVectors];
+        Vector vda0[kNumVectors], vda1[kNumVectors], vda2[kNumVectors], vdb1[kNumVectors], vdb2[kNumVectors];
+
+        // per sample coefficient steps, computed the same way as the scalar cascade
+        if (kRamp)
+        {
+            const float length = static_cast<float>(numSamples);
+            alignas(16) float deltas[5][kMaxSections];
+
+            for (uint32_t i = 0; i < kNumStages; ++i)
+            {
+                deltas[0][i] = (ta0[i] - a0[i]) / length;
+                deltas[1][i] = (ta1[i] - a1[i]) / length;
+                deltas[2][i] = (ta2[i] - a2[i]) / length;
+                deltas[3][i] = (tb1[i] - b1[i]) / length;
+                deltas[4][i] = (tb2[i] - b2[i]) / length;
+            }
+
+            for (uint32_t v = 0; v < kNumVectors; ++v)
+            {
+                vda0[v] = vload(deltas[0] + v * kNumLanes);
+                vda1[v] = vload(deltas[1] + v * kNumLanes);
+                vda2[v] = vload(deltas[2] + v * kNumLanes);
+                vdb1[v] = vload(deltas[3] + v * kNumLanes);
+                vdb2[v] = vload(deltas[4] + v * kNumLanes);
+            }
+        }
+
+        for (uint32_t v = 0; v < kNumVectors; ++v)
+        {
+            va0[v] = vload(a0 + v * kNumLanes);
+            va1[v] = vload(a1 + v * kNumLanes);
+            va2[v] = vload(a2 + v * kNumLanes);
+            vb1[v] = vload(b1 + v * kNumLanes);
+            vb2[v] = vload(b2 + v * kNumLanes);
+            vz1[v] = vload(z1 + v * kNumLanes);
+            vz2[v] = vload(z2 + v * kNumLanes);
+            vy[v] = vset(0.f);
+        }
+
+        // sample index each lane works on, relative to the current step
+        for (uint32_t v = 0; v < kNumVectors; ++v)
+        {
+            alignas(16) const float lanes[kNumLanes] = {
+                -static_cast<float>(v * kNumLanes),
+                -static_cast<float>(v * kNumLanes + 1),
+                -static_cast<float>(v * kNumLanes + 2),
+                -static_cast<float>(v * kNumLanes + 3),
+            };
+            vpos[v] = vload(lanes);
+        }
+
+        const uint32_t numSteps = numSamples + kNumStages - 1;
+        const Vector vend = vset(static_cast<float>(numSamples));
+        const Vector vone = vset(1.f);
+
+        for (uint32_t step = 0; step < numSteps; ++step)
+        {
+            // every lane takes the output of the lane before it, the first one takes the next input sample
+            Vector vx[kNumVectors];
+            vx[0] = vshift(vset(step < numSamples ? in[step] : 0.f), vy[0]);
+            for (uint32_t v = 1; v < kNumVectors; ++v)
+                vx[v] = vshift(vy[v - 1], vy[v]);
+
+            // some lanes have nothing to work on while the pipeline fills and drains
+            const bool partial = step < kNumStages - 1 || step >= numSamples;
+
+            for (uint32_t v = 0; v < kNumVectors; ++v)
+            {
+                if (kRamp)
+                {
+                    if (partial)
+                    {
+                        va0[v] = vselect(vpos[v], vend, vadd(va0[v], vda0[v]), va0[v]);
+                        va1[v] = vselect(vpos[v], vend, vadd(va1[v], vda1[v]), va1[v]);
+                        va2[v] = vselect(vpos[v], vend, vadd(va2[v], vda2[v]), va2[v]);
+                        vb1[v] = vselect(vpos[v], vend, vadd(vb1[v], vdb1[v]), vb1[v]);
+                        vb2[v] = vselect(vpos[v], vend, vadd(vb2[v], vdb2[v]), vb2[v]);
+                    }
+                    else
+                    {
+                        va0[v] = vadd(va0[v], vda0[v]);
+                        va1[v] = vadd(va1[v], vda1[v]);
+                        va2[v] = vadd(va2[v], vda2[v]);
+                        vb1[v] = vadd(vb1[v], vdb1[v]);
+                        vb2[v] = vadd(vb2[v], vdb2[v]);
+                    }
+                }
+
+                vy[v] = vadd(vmul(vx[v], va0[v]), vz1[v]);
+                const Vector nz1 = vsub(vadd(vmul(vx[v], va1[v]), vz2[v]), vmul(vb1[v], vy[v]));
+                const Vector nz2 = vsub(vmul(vx[v], va2[v]), vmul(vb2[v], vy[v]));
+
+                if (partial)
+                {
+                    vz1[v] = vselect(vpos[v], vend, nz1, vz1[v]);
+                    vz2[v] = vselect(vpos[v], vend, nz2, vz2[v]);
+                }
+                else
+                {
+                    vz1[v] = nz1;
+                    vz2[v] = nz2;
+                }
+
+                vpos[v] = vadd(vpos[v], vone);
+            }
+
+            if (step >= kNumStages - 1)
+                out[step - (kNumStages - 1)] = vlast(vy[kNumVectors - 1]);
+        }
+
+        for (uint32_t v = 0; v < kNumVectors; ++v)
+        {
+            vstore(z1 + v * kNumLanes, vz1[v]);
+            vstore(z2 + v * kNumLanes, vz2[v]);
+        }
+    }
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// Filter state of a Biquad running on a second channel, see StereoBiquadCascade.
+
+struct BiquadState {
+    double z1 = 0.0;
+    double z2 = 0.0;
+
+    void reset() noexcept
+    {
+        z1 = z2 = 0.0;
+    }
+
+    // same as Biquad::hasDecayed()
+    bool hasDecayed() const noexcept
+    {
+        return z1 < 1e-9 && z1 > -1e-9 && z2 < 1e-9 && z2 > -1e-9;
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Double precision cascade running both channels of linked stereo through the same filters in a single pass.
+// Coefficients are shared and taken from the Biquad objects, which also keep the left channel state as with
+// BiquadCascade, while the right channel state is kept in a BiquadState next to each of them.
+// Left and right run side by side in one SIMD register where available, so each coefficient serves both channels,
+// otherwise (e.g. 32-bit ARM, which has no double precision vectors) one channel after the other.
+// Each channel gives the same results as BiquadCascade<double>, ramps included.
+
+#if AIDAX_BIQUAD_SIMD && (defined(__aarch64__) || defined(_M_ARM64) || !(defined(__ARM_NEON) || defined(__ARM_NEON__)))
+# define AIDAX_BIQUAD_SIMD_PAIRS 1
+#else
+# define AIDAX_BIQUAD_SIMD_PAIRS 0
+#endif
+
+class StereoBiquadCascade
+{
+public:
+    static constexpr const uint32_t kMaxSections = 8;
+
+private:
+   #if AIDAX_BIQUAD_SIMD_PAIRS && (defined(__aarch64__) || defined(_M_ARM64))
+    typedef float64x2_t Pair;
+
+    static inline Pair pset(const double v) noexcept { return vdupq_n_f64(v); }
+    static inline Pair pset(const double l, const double r) noexcept { return vcombine_f64(vdup_n_f64(l), vdup_n_f64(r)); }
+    static inline Pair padd(const Pair a, const Pair b) noexcept { return vaddq_f64(a, b); }
+    static inline Pair psub(const Pair a, const Pair b) noexcept { return vsubq_f64(a, b); }
+    static inline Pair pmul(const Pair a, const Pair b) noexcept { return vmulq_f64(a, b); }
+    static inline Pair pround(const Pair v) noexcept { return vcvt_f64_f32(vcvt_f32_f64(v)); }
+    static inline double pleft(const Pair v) noexcept { return vgetq_lane_f64(v, 0); }
+    static inline double pright(const Pair v) noexcept { return vgetq_lane_f64(v, 1); }
+   #elif AIDAX_BIQUAD_SIMD_PAIRS
+    typedef __m128d Pair;
+
+    static inline Pair pset(const double v) noexcept { return _mm_set1_pd(v); }
+    static inline Pair pset(const double l, const double r) noexcept { return _mm_set_pd(r, l); }
+    static inline Pair padd(const Pair a, const Pair b) noexcept { return _mm_add_pd(a, b); }
+    static inline Pair psub(const Pair a, const Pair b) noexcept { return _mm_sub_pd(a, b); }
+    static inline Pair pmul(const Pair a, const Pair b) noexcept { return _mm_mul_pd(a, b); }
+    static inline Pair pround(const Pair v) noexcept { return _mm_cvtps_pd(_mm_cvtpd_ps(v)); }
+    static inline double pleft(const Pair v) noexcept { return _mm_cvtsd_f64(v); }
+    static inline double pright(const Pair v) noexcept { return _mm_cvtsd_f64(_mm_unpackhi_pd(v, v)); }
+   #endif
+
+    struct Section {
+        double a0, a1, a2, b1, b2;
+        // coefficients reached at the end of a ramp
+        double ta0, ta1, ta2, tb1, tb2;
+        // left and right
+        double z1[2], z2[2];
+    };
+
+    Section sections[kMaxSections];
+    Biquad* sources[kMaxSections];
+    BiquadState* rightStates[kMaxSections];
+    uint32_t numSections = 0;
+    bool ramping = false;
+
+public:
+    StereoBiquadCascade() noexcept {}
+
+    void clear() noexcept
+    {
+        numSections = 0;
+        ramping = false;
+    }
+
+    uint32_t getNumSections() const noexcept
+    {
+        return numSections;
+    }
+
+    // with rampFrom set (a0, a1, a2, b1, b2) coefficients move from those to the filter ones over the next process()
+    bool add(Biquad& biquad, BiquadState& right, const double* const rampFrom = nullptr) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSections < kMaxSections, false);
+
+        double coefficients[5];
+        biquad.getCoefficients(coefficients);
+
+        const double* const start = rampFrom != nullptr ? rampFrom : coefficients;
+
+        Section& section(sections[numSections]);
+        section.a0 = start[0];
+        section.a1 = start[1];
+        section.a2 = start[2];
+        section.b1 = start[3];
+        section.b2 = start[4];
+        section.ta0 = coefficients[0];
+        section.ta1 = coefficients[1];
+        section.ta2 = coefficients[2];
+        section.tb1 = coefficients[3];
+        section.tb2 = coefficients[4];
+        biquad.getState(section.z1[0], section.z2[0]);
+        section.z1[1] = right.z1;
+        section.z2[1] = right.z2;
+
+        ramping |= rampFrom != nullptr;
+        sources[numSections] = &biquad;
+        rightStates[numSections++] = &right;
+        return true;
+    }
+
+    void storeStates() const noexcept
+    {
+        for (uint32_t i = 0; i < numSections; ++i)
+        {
+            sources[i]->setState(sections[i].z1[0], sections[i].z2[0]);
+            rightStates[i]->z1 = sections[i].z1[1];
+            rightStates[i]->z2 = sections[i].z2[1];
+        }
+    }
+
+    // in-place processing is allowed
+    void process(float* const outL, float* const outR, const float* const inL, const float* const inR,
+                 const uint32_t numSamples) noexcept
+    {
+        if (ramping && numSamples != 0)
+        {
+           #if AIDAX_BIQUAD_SIMD_PAIRS
+            processSamples<true>(outL, outR, inL, inR, numSamples);
+           #else
+            processChannel<true>(outL, inL, 0, numSamples);
+            processChannel<true>(outR, inR, 1, numSamples);
+           #endif
+
+            // land exactly on the target, rounding adds up along the ramp
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                Section& section(sections[s]);
+                section.a0 = section.ta0;
+                section.a1 = section.ta1;
+                section.a2 = section.ta2;
+                section.b1 = section.tb1;
+                section.b2 = section.tb2;
+            }
+
+            ramping = false;
+            return;
+        }
+
+       #if AIDAX_BIQUAD_SIMD_PAIRS
+        processSamples<false>(outL, outR, inL, inR, numSamples);
+       #else
+        processChannel<false>(outL, inL, 0, numSamples);
+        processChannel<false>(outR, inR, 1, numSamples);
+       #endif
+    }
+
+private:
+   #if AIDAX_BIQUAD_SIMD_PAIRS
+    template <bool kRamp>
+    void processSamples(float* const outL, float* const outR, const float* const inL, const float* const inR,
+                        const uint32_t numSamples) noexcept
+    {
+        Pair a0[kMaxSections], a1[kMaxSections], a2[kMaxSections], b1[kMaxSections], b2[kMaxSections];
+        Pair da0[kMaxSections], da1[kMaxSections], da2[kMaxSections], db1[kMaxSections], db2[kMaxSections];
+        Pair z1[kMaxSections], z2[kMaxSections];
+
+        for (uint32_t s = 0; s < numSections; ++s)
+        {
+            const Section& section(sections[s]);
+            a0[s] = pset(section.a0);
+            a1[s] = pset(section.a1);
+            a2[s] = pset(section.a2);
+            b1[s] = pset(section.b1);
+            b2[s] = pset(section.b2);
+            z1[s] = pset(section.z1[0], section.z1[1]);
+            z2[s] = pset(section.z2[0], section.z2[1]);
+
+            // per sample coefficient steps, computed the same way as the scalar cascade
+            if (kRamp)
+            {
+                const double length = static_cast<double>(numSamples);
+                da0[s] = pset((section.ta0 - section.a0) / length);
+                da1[s] = pset((section.ta1 - section.a1) / length);
+                da2[s] = pset((section.ta2 - section.a2) / length);
+                db1[s] = pset((section.tb1 - section.b1) / length);
+                db2[s] = pset((section.tb2 - section.b2) / length);
+            }
+        }
+
+        for (uint32_t i = 0; i < numSamples; ++i)
+        {
+            Pair x = pset(inL[i], inR[i]);
+
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                if (kRamp)
+                {
+                    a0[s] = padd(a0[s], da0[s]);
+                    a1[s] = padd(a1[s], da1[s]);
+                    a2[s] = padd(a2[s], da2[s]);
+                    b1[s] = padd(b1[s], db1[s]);
+                    b2[s] = padd(b2[s], db2[s]);
+                }
+
+                const Pair y = padd(pmul(x, a0[s]), z1[s]);
+                z1[s] = psub(padd(pmul(x, a1[s]), z2[s]), pmul(b1[s], y));
+                z2[s] = psub(pmul(x, a2[s]), pmul(b2[s], y));
+                x = pround(y);
+            }
+
+            outL[i] = static_cast<float>(pleft(x));
+            outR[i] = static_cast<float>(pright(x));
+        }
+
+        for (uint32_t s = 0; s < numSections; ++s)
+        {
+            Section& section(sections[s]);
+            section.z1[0] = pleft(z1[s]);
+            section.z1[1] = pright(z1[s]);
+            section.z2[0] = pleft(z2[s]);
+            section.z2[1] = pright(z2[s]);
+        }
+    }
+   #else
+    // same as BiquadCascade<double>::processSamples(), coefficients only change once both channels are done
+    template <bool kRamp>
+    void processChannel(float* const out, const float* const in, const uint32_t channel,
+                        const uint32_t numSamples) noexcept
+    {
+        double a0[kMaxSections], a1[kMaxSections], a2[kMaxSections], b1[kMaxSections], b2[kMaxSections];
+        double da0[kMaxSections], da1[kMaxSections], da2[kMaxSections], db1[kMaxSections], db2[kMaxSections];
+
+        for (uint32_t s = 0; s < numSections; ++s)
+        {
+            const Section& section(sections[s]);
+            a0[s] = section.a0;
+            a1[s] = section.a1;
+            a2[s] = section.a2;
+            b1[s] = section.b1;
+            b2[s] = section.b2;
+
+            if (kRamp)
+            {
+                const double length = static_cast<double>(numSamples);
+                da0[s] = (section.ta0 - section.a0) / length;
+                da1[s] = (section.ta1 - section.a1) / length;
+                da2[s] = (section.ta2 - section.a2) / length;
+                db1[s] = (section.tb1 - section.b1) / length;
+                db2[s] = (section.tb2 - section.b2) / length;
+            }
+        }
+
+        for (uint32_t i = 0; i < numSamples; ++i)
+        {
+            float x = in[i];
+
+            for (uint32_t s = 0; s < numSections; ++s)
+            {
+                Section& section(sections[s]);
+
+                if (kRamp)
+                {
+                    a0[s] += da0[s];
+                    a1[s] += da1[s];
+                    a2[s] += da2[s];
+                    b1[s] += db1[s];
+                    b2[s] += db2[s];
+                }
+
+                const double y = x * a0[s] + section.z1[channel];
+                section.z1[channel] = x * a1[s] + section.z2[channel] - b1[s] * y;
+                section.z2[channel] = x * a2[s] - b2[s] * y;
+                x = static_cast<float>(y);
+            }
+
+            out[i] = x;
+        }
+    }
+   #endif
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,321 @@
+/*
+ * AIDA-X block value smoother
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// vectorized ramp filling, can be turned off at build time
+#ifndef AIDAX_SMOOTHER_SIMD
+# if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define AIDAX_SMOOTHER_SIMD 1
+# elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define AIDAX_SMOOTHER_SIMD 1
+# else
+#  define AIDAX_SMOOTHER_SIMD 0
+# endif
+#endif
+
+#if AIDAX_SMOOTHER_SIMD
+# if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+# else
+#  include <emmintrin.h>
+# endif
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Exponential smoother with the same behaviour and API as ExponentialValueSmoother, that can also move a whole block
+// at once. nextBlock() computes where the value ends up after the block in closed form and returns a linear ramp
+// towards it, so stages can apply the gain without a serial dependency between samples.
+// The value at every block boundary matches the per-sample smoother, only the shape within a block is linear.
+// Once the value is within float resolution of the target it snaps there and blocks come out as constant ramps,
+// which stages can check with Ramp::isConstant() to skip their work.
+
+class BlockValueSmoother
+{
+public:
+    struct Ramp {
+        float start;
+        float step;
+
+        inline float at(const uint32_t i) const noexcept
+        {
+            return start + step * static_cast<float>(i);
+        }
+
+        inline bool isConstant() const noexcept
+        {
+            return step == 0.f;
+        }
+
+        inline bool isConstantAt(const float value) const noexcept
+        {
+            return step == 0.f && start == value;
+        }
+    };
+
+    void setSampleRate(const float newSampleRate) noexcept
+    {
+        if (d_isNotEqual(sampleRate, newSampleRate))
+        {
+            sampleRate = newSampleRate;
+            updateCoef();
+        }
+    }
+
+    void setTimeConstant(const float newTau) noexcept
+    {
+        if (d_isNotEqual(tau, newTau))
+        {
+            tau = newTau;
+            updateCoef();
+        }
+    }
+
+    float getCurrentValue() const noexcept
+    {
+        return mem;
+    }
+
+    float getTargetValue() const noexcept
+    {
+        return target;
+    }
+
+    void setTargetValue(const float newTarget) noexcept
+    {
+        target = newTarget;
+    }
+
+    void clearToTargetValue() noexcept
+    {
+        mem = target;
+    }
+
+    inline float peek() const noexcept
+    {
+        return mem * coef + target * (1.f - coef);
+    }
+
+   /**
+      Check if the value is within float resolution of the target (-120dB of full scale), nextBlock() snaps it there.
+    */
+    bool isSettled() const noexcept
+    {
+        return std::abs(mem - target) <= kSettledDelta * std::max(1.f, std::abs(target));
+    }
+
+    inline float next() noexcept
+    {
+        return (mem = mem * coef + target * (1.f - coef));
+    }
+
+   /**
+      Advance by @a numSamples, returning the values for each of them as a linear ramp.
+    */
+    Ramp nextBlock(const uint32_t numSamples) noexcept
+    {
+        if (numSamples == 0)
+            return { mem, 0.f };
+
+        if (isSettled())
+        {
+            mem = target;
+            return { mem, 0.f };
+        }
+
+        // hosts mostly use the same block size, so the decay over a block is only computed when that changes
+        if (numSamples != blockCoefFrames)
+        {
+            blockCoefFrames = numSamples;
+            blockCoef = std::pow(coef, static_cast<float>(numSamples));
+        }
+
+        const float end = target + (mem - target) * blockCoef;
+
+        // rounding stalls the value a few float steps away from targets other than 0, that is as close as it gets
+        if (end == mem)
+        {
+            mem = target;
+            return { mem, 0.f };
+        }
+
+        const float step = (end - mem) / static_cast<float>(numSamples);
+        const Ramp ramp = { mem + step, step };
+
+        mem = end;
+        return ramp;
+    }
+
+private:
+    // distance to the target under which the value is considered settled, relative to full scale
+    static constexpr const float kSettledDelta = 1e-6f;
+
+    float coef = 0.f;
+    float target = 0.f;
+    float mem = 0.f;
+    float tau = 1.f;
+    float sampleRate = 0.f;
+    float blockCoef = 0.f;
+    uint32_t blockCoefFrames = 0;
+
+    void updateCoef() noexcept
+    {
+        coef = std::exp(-1.f / (tau * sampleRate));
+        blockCoefFrames = 0;
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Linear smoother with the same behaviour and API as LinearValueSmoother, that can also fill a whole block at once.
+// For values used one sample at a time, such as model parameters, fillBlock() writes the per-sample values in
+// closed form with SIMD, or reports the value as settled so that callers can use a constant instead.
+
+class LinearBlockValueSmoother
+{
+public:
+    void setSampleRate(const float newSampleRate) noexcept
+    {
+        if (d_isNotEqual(sampleRate, newSampleRate))
+        {
+            sampleRate = newSampleRate;
+            updateStep();
+        }
+    }
+
+    void setTimeConstant(const float newTau) noexcept
+    {
+        if (d_isNotEqual(tau, newTau))
+        {
+            tau = newTau;
+            updateStep();
+        }
+    }
+
+    float getCurrentValue() const noexcept
+    {
+        return mem;
+    }
+
+    float getTargetValue() const noexcept
+    {
+        return target;
+    }
+
+    void setTargetValue(const float newTarget) noexcept
+    {
+        if (d_isNotEqual(target, newTarget))
+        {
+            target = newTarget;
+            updateStep();
+        }
+    }
+
+    void clearToTargetValue() noexcept
+    {
+        mem = target;
+    }
+
+    inline float peek() const noexcept
+    {
+        const float dy = target - mem;
+        return mem + std::copysign(std::fmin(std::abs(dy), std::abs(step)), dy);
+    }
+
+    inline float next() noexcept
+    {
+        const float y0 = mem;
+        const float dy = target - y0;
+        return (mem = y0 + std::copysign(std::fmin(std::abs(dy), std::abs(step)), dy));
+    }
+
+   /**
+      Advance by @a numSamples, writing the value for each of them into @a out.
+      Returns true without writing anything if the value is settled at the target during the whole block.
+    */
+    bool fillBlock(float* const out, const uint32_t numSamples) noexcept
+    {
+        const float dy = target - mem;
+
+        if (d_isZero(dy))
+        {
+            mem = target;
+            return true;
+        }
+
+        // sample i moves by (i + 1) steps, up to the target
+        const float distance = std::abs(dy);
+        const float stepSize = std::abs(step);
+        const float sign = std::copysign(1.f, dy);
+        uint32_t i = 0;
+
+       #if AIDAX_SMOOTHER_SIMD
+       # if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        static constexpr const float kLaneSteps[4] = { 1.f, 2.f, 3.f, 4.f };
+        float32x4_t steps = vld1q_f32(kLaneSteps);
+        const float32x4_t four = vdupq_n_f32(4.f);
+        const float32x4_t vstepSize = vdupq_n_f32(stepSize);
+        const float32x4_t vdistance = vdupq_n_f32(distance);
+        const float32x4_t vsign = vdupq_n_f32(sign);
+        const float32x4_t vmem = vdupq_n_f32(mem);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const float32x4_t moved = vminq_f32(vmulq_f32(steps, vstepSize), vdistance);
+            vst1q_f32(out + i, vaddq_f32(vmem, vmulq_f32(moved, vsign)));
+            steps = vaddq_f32(steps, four);
+        }
+       # else
+        __m128 steps = _mm_setr_ps(1.f, 2.f, 3.f, 4.f);
+        const __m128 four = _mm_set1_ps(4.f);
+        const __m128 vstepSize = _mm_set1_ps(stepSize);
+        const __m128 vdistance = _mm_set1_ps(distance);
+        const __m128 vsign = _mm_set1_ps(sign);
+        const __m128 vmem = _mm_set1_ps(mem);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 moved = _mm_min_ps(_mm_mul_ps(steps, vstepSize), vdistance);
+            _mm_storeu_ps(out + i, _mm_add_ps(vmem, _mm_mul_ps(moved, vsign)));
+            steps = _mm_add_ps(steps, four);
+        }
+       # endif
+       #endif
+
+        for (; i < numSamples; ++i)
+            out[i] = mem + std::fmin(static_cast<float>(i + 1) * stepSize, distance) * sign;
+
+        // snap exactly onto the target once reached, as next() does
+        if (static_cast<float>(numSamples) * stepSize >= distance)
+            mem = target;
+        else if (numSamples != 0)
+            mem = out[numSamples - 1];
+
+        return false;
+    }
+
+private:
+    float step = 0.f;
+    float target = 0.f;
+    float mem = 0.f;
+    float tau = 1.f;
+    float sampleRate = 0.f;
+
+    void updateStep() noexcept
+    {
+        step = (target - mem) / (tau * sampleRate);
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,271 @@
+/*
+ * AIDA-X cabinet EQ baker
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "BiquadCascade.hpp"
+#include "Semaphore.hpp"
+#include "TwoStageThreadedConvolver.hpp"
+#include "extra/Mutex.hpp"
+#include "extra/Sleep.hpp"
+#include "extra/Thread.hpp"
+
+#include <atomic>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Background thread that folds a static EQ into the cabinet impulses.
+// An EQ placed right after the convolver is linear and time-invariant just like it, so filtering each impulse
+// through the EQ gives the same result as running the EQ on the convolver output, for no extra cost per sample.
+// The audio thread fills a request with its EQ filters and submits it, the baker then computes the filtered
+// impulses and hands them to the convolver through setImpulses(), tagged so the audio thread knows when they
+// take over. Requests with tag 0 restore the plain impulses.
+// Impulses going from plain to baked switch at once, as both sound the same with the EQ stage stopping at the
+// switch. All other changes are crossfaded.
+
+class CabinetEqBaker : public Thread
+{
+public:
+    static constexpr const uint32_t kMaxFilters = BiquadCascade<double>::kMaxSections;
+    // EQ ringing kept after the end of each impulse, at most, cut once below -120dB
+    static constexpr const uint32_t kMaxEqTail = 16384;
+
+    struct Request {
+        Biquad filters[kMaxFilters];
+        uint32_t numFilters = 0;
+        uint32_t tag = 0;
+    };
+
+    CabinetEqBaker()
+        : Thread("CabinetEqBaker")
+    {
+        startThread();
+    }
+
+    ~CabinetEqBaker()
+    {
+        signalThreadShouldExit();
+        semRequest.post();
+        stopThread(-1);
+    }
+
+   /**
+      Lock to hold while changing the convolver or its impulses, the baker uses them while locked too.
+    */
+    Mutex& getMutex() noexcept
+    {
+        return mutex;
+    }
+
+   /**
+      Set the convolver and the plain impulses it was just given, must be called with getMutex() locked.
+    */
+    void setCabinet(TwoStageThreadedConvolver* const newConvolver,
+                    const std::shared_ptr<const ConvolverImpulse>* const newImpulses, const uint32_t newNumImpulses)
+    {
+        convolver = newConvolver;
+        numImpulses = std::min(newNumImpulses, TwoStageThreadedConvolver::kMaxImpulses);
+
+        for (uint32_t i = 0; i < TwoStageThreadedConvolver::kMaxImpulses; ++i)
+            impulses[i] = i < numImpulses ? newImpulses[i] : nullptr;
+
+        appliedTag = 0;
+        failedTag.store(0, std::memory_order_relaxed);
+    }
+
+   /**
+      Check if a new request can be submitted. Realtime safe.
+    */
+    bool isIdle() const noexcept
+    {
+        return ! busy.load(std::memory_order_acquire);
+    }
+
+   /**
+      Request to fill before submit(), only while idle. Realtime safe.
+    */
+    Request& getRequest() noexcept
+    {
+        return request;
+    }
+
+    void submit() noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(isIdle(),);
+
+        busy.store(true, std::memory_order_release);
+        semRequest.post();
+    }
+
+   /**
+      Tag of the last request that could not be applied, because the baked impulses do not fit the convolver.
+      Realtime safe.
+    */
+    uint32_t getFailedTag() const noexcept
+    {
+        return failedTag.load(std::memory_order_relaxed);
+    }
+
+protected:
+    void run() override
+    {
+        TraceRecorder::setThreadName("eq baker");
+
+        while (! shouldThreadExit())
+        {
+            semRequest.wait();
+
+            if (shouldThreadExit())
+                break;
+
+            if (busy.load(std::memory_order_acquire))
+            {
+                const TraceScope ts("eq bake");
+                processRequest();
+                busy.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+private:
+    Mutex mutex;
+    Semaphore semRequest;
+    std::atomic<bool> busy { false };
+    std::atomic<uint32_t> failedTag { 0 };
+    Request request;
+
+    // protected by mutex
+    TwoStageThreadedConvolver* convolver = nullptr;
+    std::shared_ptr<const ConvolverImpulse> impulses[TwoStageThreadedConvolver::kMaxImpulses];
+    uint32_t numImpulses = 0;
+    uint32_t appliedTag = 0;
+
+    void processRequest()
+    {
+        std::shared_ptr<const ConvolverImpulse> sources[TwoStageThreadedConvolver::kMaxImpulses];
+        uint32_t numSources;
+
+        {
+            const MutexLocker cml(mutex);
+
+            if (convolver == nullptr || request.tag == appliedTag)
+                return;
+
+            numSources = numImpulses;
+            for (uint32_t i = 0; i < numSources; ++i)
+                sources[i] = impulses[i];
+        }
+
+        // filtering is done unlocked, the impulses are checked again before applying the result
+        std::shared_ptr<const ConvolverImpulse> baked[TwoStageThreadedConvolver::kMaxImpulses];
+
+        for (uint32_t i = 0; i < numSources; ++i)
+        {
+            if (sources[i] == nullptr)
+                continue;
+
+            baked[i] = request.tag != 0 ? bake(*sources[i], request) : sources[i];
+
+            if (baked[i] == nullptr)
+            {
+                failedTag.store(request.tag, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        // a previous change may still be fading, retry until it is done
+        while (! shouldThreadExit())
+        {
+            {
+                const MutexLocker cml(mutex);
+
+                if (convolver == nullptr || numImpulses != numSources)
+                    return;
+
+                for (uint32_t i = 0; i < numSources; ++i)
+                {
+                    if (impulses[i] != sources[i])
+                        return;
+                }
+
+                const bool crossfade = appliedTag != 0 || request.tag == 0;
+
+                if (convolver->setImpulses(baked, numSources, request.tag, crossfade))
+                {
+                    appliedTag = request.tag;
+                    return;
+                }
+
+                if (! convolver->isChangingImpulses())
+                {
+                    failedTag.store(request.tag, std::memory_order_relaxed);
+                    return;
+                }
+            }
+
+            d_msleep(5);
+        }
+    }
+
+    // returns null if the EQ ringing does not fit, impulses without a tail stage must not grow one
+    static std::shared_ptr<const ConvolverImpulse> bake(const ConvolverImpulse& source, const Request& eq)
+    {
+        Biquad filters[kMaxFilters];
+        BiquadCascade<double> cascade;
+
+        for (uint32_t i = 0; i < eq.numFilters; ++i)
+        {
+            filters[i] = eq.filters[i];
+            filters[i].reset();
+            cascade.add(filters[i]);
+        }
+
+        // impulse followed by the EQ ringing, which is cut once a whole block of it stays below -120dB
+        std::vector<float> ir(source.irLength + kMaxEqTail);
+        std::memcpy(ir.data(), source.ir, sizeof(float) * source.irLength);
+
+        cascade.process(ir.data(), ir.data(), source.irLength);
+
+        static constexpr const uint32_t kTailCheckSize = 1024;
+        uint32_t irLength = source.irLength;
+
+        while (irLength < ir.size())
+        {
+            float* const block = ir.data() + irLength;
+            cascade.process(block, block, kTailCheckSize);
+            irLength += kTailCheckSize;
+
+            float peak = 0.f;
+            for (uint32_t i = 0; i < kTailCheckSize; ++i)
+                peak = std::max(peak, std::abs(block[i]));
+
+            if (peak < 1e-6f)
+                break;
+        }
+
+        if (source.irLength <= source.headLength && irLength > source.headLength)
+        {
+            // ringing past the head is dropped if inaudible (below -80dB)
+            float peak = 0.f;
+            for (uint32_t i = source.headLength; i < irLength; ++i)
+                peak = std::max(peak, std::abs(ir[i]));
+
+            if (peak >= 1e-4f)
+                return nullptr;
+
+            irLength = source.headLength;
+        }
+
+        return TwoStageThreadedConvolver::createImpulse(ir.data(), irLength, source.headLength);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(CabinetEqBaker)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
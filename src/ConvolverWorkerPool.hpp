@@ -0,0 +1,506 @@
+/*
+ * AIDA-X convolver worker pool
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "HybridSemaphore.hpp"
+#include "TraceRecorder.hpp"
+#include "extra/Mutex.hpp"
+#include "extra/Sleep.hpp"
+#include "extra/String.hpp"
+#include "extra/Thread.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#if defined(DISTRHO_OS_LINUX)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// A background job owned by a client, submitted to the pool once per period.
+// The owner must wait() for a submitted job before submitting it again or destroying it.
+
+struct ConvolverWorkerJob {
+    enum State : uint32_t {
+        kStateIdle,
+        kStateQueued,
+        kStateRunning,
+        kStateFinished
+    };
+
+    void (*function)(void*) = nullptr;
+    void* arg = nullptr;
+
+    std::atomic<uint32_t> state { kStateIdle };
+    std::atomic<uint64_t> deadline { 0 };
+    uint64_t submitTime = 0;
+    HybridSemaphore semFinished { 0 };
+
+    // diagnostics, -1 means the job was run by the waiting thread
+    std::atomic<int32_t> lastWorker { -1 };
+    std::atomic<uint64_t> lastLatency { 0 };
+    std::atomic<uint64_t> maxLatency { 0 };
+    std::atomic<uint64_t> numRuns { 0 };
+    std::atomic<uint64_t> numHelped { 0 };
+
+    ConvolverWorkerJob(void (*const f)(void*), void* const a) noexcept
+        : function(f),
+          arg(a) {}
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolverWorkerJob)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Process-wide pool of realtime worker threads shared by all convolver instances.
+// Queued jobs are picked in earliest-deadline-first order.
+// Starts with kMinWorkers and grows to one worker per registered job, up to all but one core, so that a single cabinet
+// does not wake a thread per core while hosts with many jobs, such as the rack, still get all cores.
+// AIDAX_WORKER_THREADS sets a fixed count instead, AIDAX_WORKER_CPUS takes a comma separated list of CPU indexes to
+// pin the workers to (in order, wrapping around).
+
+class ConvolverWorkerPool
+{
+public:
+    static constexpr const uint kMinWorkers = 2;
+
+    static uint64_t getCurrentTime() noexcept
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+   /**
+      Get the shared pool, creating it if needed. Must be balanced with release().
+    */
+    static ConvolverWorkerPool* acquire()
+    {
+        Global& global(getGlobal());
+        const MutexLocker cml(global.mutex);
+
+        if (global.refCount++ == 0)
+            global.pool = new ConvolverWorkerPool();
+
+        return global.pool;
+    }
+
+    static void release()
+    {
+        Global& global(getGlobal());
+        const MutexLocker cml(global.mutex);
+
+        DISTRHO_SAFE_ASSERT_RETURN(global.refCount != 0,);
+
+        if (--global.refCount == 0)
+        {
+            delete global.pool;
+            global.pool = nullptr;
+        }
+    }
+
+   /**
+      Describe the current pool state, for diagnostics.
+    */
+    static String getDiagnostics()
+    {
+        Global& global(getGlobal());
+        const MutexLocker cml(global.mutex);
+
+        if (global.pool == nullptr)
+            return String("worker pool not running");
+
+        return global.pool->getPoolDiagnostics();
+    }
+
+    void registerJob(ConvolverWorkerJob* const job)
+    {
+        size_t numJobs;
+
+        {
+            const MutexLocker cml(jobsMutex);
+            jobs.push_back(job);
+            numJobs = jobs.size();
+        }
+
+        startWorkers(static_cast<uint>(std::min<size_t>(numJobs, maxWorkers)));
+    }
+
+    void unregisterJob(ConvolverWorkerJob* const job)
+    {
+        wait(*job);
+
+        const MutexLocker cml(jobsMutex);
+
+        for (auto it = jobs.begin(); it != jobs.end(); ++it)
+        {
+            if (*it == job)
+            {
+                jobs.erase(it);
+                break;
+            }
+        }
+    }
+
+   /**
+      Queue a job to be finished before @a deadline (as given by getCurrentTime()). Realtime safe.
+    */
+    void submit(ConvolverWorkerJob& job, const uint64_t deadline) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(job.state.load(std::memory_order_relaxed) == ConvolverWorkerJob::kStateIdle,);
+
+        job.submitTime = getCurrentTime();
+        job.deadline.store(deadline, std::memory_order_relaxed);
+        job.state.store(ConvolverWorkerJob::kStateQueued, std::memory_order_release);
+
+        queueDepth.fetch_add(1, std::memory_order_relaxed);
+        semJobs.post();
+    }
+
+   /**
+      Wait for a submitted job to complete.
+      If no worker has started it yet, the job runs in the calling thread instead.
+    */
+    void wait(ConvolverWorkerJob& job) noexcept
+    {
+        if (tryRunQueued(job))
+            return;
+
+        // claimed by a worker, the semaphore is only a wake-up hint as tryWait() does not consume it
+        for (;;)
+        {
+            uint32_t expected = ConvolverWorkerJob::kStateFinished;
+
+            if (job.state.compare_exchange_strong(expected, ConvolverWorkerJob::kStateIdle, std::memory_order_acquire))
+                return;
+            if (expected == ConvolverWorkerJob::kStateIdle)
+                return;
+
+            job.semFinished.wait();
+        }
+    }
+
+   /**
+      Check if a job can be submitted again, without waiting. Realtime safe.
+    */
+    bool tryWait(ConvolverWorkerJob& job) noexcept
+    {
+        uint32_t expected = ConvolverWorkerJob::kStateFinished;
+
+        if (job.state.compare_exchange_strong(expected, ConvolverWorkerJob::kStateIdle, std::memory_order_acquire))
+            return true;
+
+        return expected == ConvolverWorkerJob::kStateIdle;
+    }
+
+   /**
+      Same as tryWait(), but if no worker has started the job yet it runs in the calling thread instead.
+      Only returns false while a worker is running the job. Realtime safe, as long as the job itself is.
+    */
+    bool tryHelp(ConvolverWorkerJob& job) noexcept
+    {
+        return tryRunQueued(job) || tryWait(job);
+    }
+
+   /**
+      Run the earliest queued job of any owner in the calling thread, the same as a worker would.
+      For threads that have to wait for other work anyway, returns false if nothing was queued.
+    */
+    bool runQueuedJob() noexcept
+    {
+        ConvolverWorkerJob* const job = claimEarliestJob();
+
+        if (job == nullptr)
+            return false;
+
+        runJob(*job, -1);
+        job->numHelped.fetch_add(1, std::memory_order_relaxed);
+
+        // locked so that unregisterJob() cannot return while the job is still being touched
+        const MutexLocker cml(jobsMutex);
+        job->state.store(ConvolverWorkerJob::kStateFinished, std::memory_order_release);
+        job->semFinished.post();
+        return true;
+    }
+
+private:
+    bool tryRunQueued(ConvolverWorkerJob& job) noexcept
+    {
+        uint32_t expected = ConvolverWorkerJob::kStateQueued;
+
+        if (! job.state.compare_exchange_strong(expected, ConvolverWorkerJob::kStateRunning, std::memory_order_acquire))
+            return false;
+
+        queueDepth.fetch_sub(1, std::memory_order_relaxed);
+        runJob(job, -1);
+        job.numHelped.fetch_add(1, std::memory_order_relaxed);
+        job.state.store(ConvolverWorkerJob::kStateIdle, std::memory_order_release);
+        return true;
+    }
+
+    struct Global {
+        Mutex mutex;
+        ConvolverWorkerPool* pool = nullptr;
+        uint refCount = 0;
+    };
+
+    static Global& getGlobal()
+    {
+        static Global global;
+        return global;
+    }
+
+    class Worker : public Thread
+    {
+        ConvolverWorkerPool& pool;
+        const int32_t index;
+        const int cpu;
+
+    public:
+        std::atomic<uint64_t> numRuns { 0 };
+
+        Worker(ConvolverWorkerPool& p, const int32_t i, const int c)
+            : Thread("ConvolverWorker"),
+              pool(p),
+              index(i),
+              cpu(c) {}
+
+        int getCpu() const noexcept
+        {
+            return cpu;
+        }
+
+    protected:
+        void run() override
+        {
+            if (cpu >= 0)
+                setCurrentThreadAffinity(cpu);
+
+            TraceRecorder::setThreadName("convolver worker");
+
+            while (!shouldThreadExit())
+            {
+                // idle workers are not on the critical path, the audio thread has latency slack for their wake-up
+                pool.semJobs.wait(false);
+
+                while (!shouldThreadExit())
+                {
+                    ConvolverWorkerJob* const job = pool.claimEarliestJob();
+
+                    if (job == nullptr)
+                        break;
+
+                    runJob(*job, index);
+                    numRuns.fetch_add(1, std::memory_order_relaxed);
+
+                    // locked so that unregisterJob() cannot return while the job is still being touched
+                    const MutexLocker cml(pool.jobsMutex);
+                    job->state.store(ConvolverWorkerJob::kStateFinished, std::memory_order_release);
+                    job->semFinished.post();
+                }
+            }
+        }
+    };
+
+    Mutex jobsMutex;
+    std::vector<ConvolverWorkerJob*> jobs;
+    // only grows while the pool exists
+    Mutex workersMutex;
+    std::vector<Worker*> workers;
+    std::vector<int> cpus;
+    uint maxWorkers;
+    std::atomic<int32_t> queueDepth { 0 };
+    std::atomic<int32_t> maxQueueDepth { 0 };
+    HybridSemaphore semJobs;
+
+    ConvolverWorkerPool()
+    {
+        // leave a core for the audio thread
+        const uint numCores = std::max(2u, std::thread::hardware_concurrency());
+        uint minWorkers = std::min(numCores - 1, kMinWorkers);
+        maxWorkers = numCores - 1;
+
+        if (const char* const envThreads = std::getenv("AIDAX_WORKER_THREADS"))
+            if (const int value = std::atoi(envThreads))
+                minWorkers = maxWorkers = static_cast<uint>(std::max(1, value));
+
+        if (const char* const envCpus = std::getenv("AIDAX_WORKER_CPUS"))
+        {
+            for (const char* s = envCpus; *s != '\0';)
+            {
+                char* end;
+                const long cpu = std::strtol(s, &end, 10);
+
+                if (end == s)
+                    break;
+
+                cpus.push_back(static_cast<int>(cpu));
+                s = *end == ',' ? end + 1 : end;
+            }
+        }
+
+        workers.reserve(maxWorkers);
+        startWorkers(minWorkers);
+    }
+
+    ~ConvolverWorkerPool()
+    {
+        for (Worker* worker : workers)
+            worker->signalThreadShouldExit();
+
+        for (size_t i = 0; i < workers.size(); ++i)
+            semJobs.post();
+
+        for (Worker* worker : workers)
+        {
+            // a saturated semaphore may not wake every worker, keep posting until all are gone
+            while (worker->isThreadRunning())
+            {
+                semJobs.post();
+                d_msleep(1);
+            }
+
+            delete worker;
+        }
+    }
+
+    void startWorkers(const uint numWorkers)
+    {
+        const MutexLocker cml(workersMutex);
+
+        for (uint i = static_cast<uint>(workers.size()); i < numWorkers; ++i)
+        {
+            Worker* const worker = new Worker(*this, static_cast<int32_t>(i), cpus.empty() ? -1 : cpus[i % cpus.size()]);
+            worker->startThread(true);
+            workers.push_back(worker);
+        }
+    }
+
+    ConvolverWorkerJob* claimEarliestJob() noexcept
+    {
+        const MutexLocker cml(jobsMutex);
+
+        const int32_t depth = queueDepth.load(std::memory_order_relaxed);
+        if (depth > maxQueueDepth.load(std::memory_order_relaxed))
+            maxQueueDepth.store(depth, std::memory_order_relaxed);
+
+        for (;;)
+        {
+            ConvolverWorkerJob* earliest = nullptr;
+            uint64_t earliestDeadline = UINT64_MAX;
+
+            for (ConvolverWorkerJob* job : jobs)
+            {
+                if (job->state.load(std::memory_order_acquire) != ConvolverWorkerJob::kStateQueued)
+                    continue;
+
+                const uint64_t deadline = job->deadline.load(std::memory_order_relaxed);
+
+                if (deadline < earliestDeadline)
+                {
+                    earliest = job;
+                    earliestDeadline = deadline;
+                }
+            }
+
+            if (earliest == nullptr)
+                return nullptr;
+
+            // the owner might have taken it meanwhile, in that case look again
+            uint32_t expected = ConvolverWorkerJob::kStateQueued;
+            if (earliest->state.compare_exchange_strong(expected,
+                                                        ConvolverWorkerJob::kStateRunning,
+                                                        std::memory_order_acquire))
+            {
+                queueDepth.fetch_sub(1, std::memory_order_relaxed);
+                return earliest;
+            }
+        }
+    }
+
+    static void runJob(ConvolverWorkerJob& job, const int32_t workerIndex) noexcept
+    {
+        job.function(job.arg);
+
+        const uint64_t latency = getCurrentTime() - job.submitTime;
+        job.lastWorker.store(workerIndex, std::memory_order_relaxed);
+        job.lastLatency.store(latency, std::memory_order_relaxed);
+        if (latency > job.maxLatency.load(std::memory_order_relaxed))
+            job.maxLatency.store(latency, std::memory_order_relaxed);
+        job.numRuns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void setCurrentThreadAffinity(const int cpu)
+    {
+       #if defined(DISTRHO_OS_LINUX)
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+            d_stderr("Failed to pin convolver worker to CPU %d", cpu);
+       #elif defined(DISTRHO_OS_WINDOWS)
+        if (::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) == 0)
+            d_stderr("Failed to pin convolver worker to CPU %d", cpu);
+       #else
+        // no hard affinity on this platform
+        (void)cpu;
+       #endif
+    }
+
+    String getPoolDiagnostics()
+    {
+        String ret;
+        char line[256];
+
+        const MutexLocker cwml(workersMutex);
+
+        std::snprintf(line, sizeof(line), "workers: %u of at most %u, queue depth: %d (max %d)\n",
+                      static_cast<uint>(workers.size()),
+                      maxWorkers,
+                      queueDepth.load(),
+                      maxQueueDepth.load());
+        ret += line;
+
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            std::snprintf(line, sizeof(line), "worker %u: cpu %d, %llu jobs\n",
+                          static_cast<uint>(i),
+                          workers[i]->getCpu(),
+                          static_cast<unsigned long long>(workers[i]->numRuns.load()));
+            ret += line;
+        }
+
+        const MutexLocker cml(jobsMutex);
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            const ConvolverWorkerJob* const job = jobs[i];
+
+            std::snprintf(line, sizeof(line),
+                          "job %u (%p): last worker %d, %llu runs (%llu by owner), latency %.3f ms (max %.3f ms)\n",
+                          static_cast<uint>(i),
+                          job->arg,
+                          job->lastWorker.load(),
+                          static_cast<unsigned long long>(job->numRuns.load()),
+                          static_cast<unsigned long long>(job->numHelped.load()),
+                          static_cast<double>(job->lastLatency.load()) / 1e6,
+                          static_cast<double>(job->maxLatency.load()) / 1e6);
+            ret += line;
+        }
+
+        return ret;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolverWorkerPool)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,347 @@
+/*
+ * AIDA-X deadline monitor
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "extra/Mutex.hpp"
+#include "extra/String.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Measures every audio block against its deadline, the time the host gives for processing numSamples frames, for
+// tracking down crackles reported by players.
+// Always on, costing two clock reads per block. Keeps a histogram of the block load on a half octave scale, and the
+// worst block of each second with its time, processing stages and the model and cabinet loaded at the time, in a ring
+// of recent blocks. The audio thread never locks, other threads read the ring through a sequence number per entry.
+
+class DeadlineMonitor
+{
+public:
+    // half octave buckets of the block duration over its deadline, from 1/256 to 4 times the deadline
+    static constexpr const uint kNumBuckets = 21;
+    static constexpr const uint kDeadlineBucket = 16;
+    static constexpr const uint kNumRecentBlocks = 32;
+    static constexpr const uint kNumConfigurations = 8;
+
+    struct Block {
+        uint64_t time;       // steady clock at block start, in ns
+        uint64_t duration;   // in ns
+        uint64_t deadline;   // in ns
+        uint32_t numSamples;
+        uint32_t stages;      // caller defined, kParameterActiveStages bits for the plugin
+        uint32_t slowestStage;
+        uint32_t configuration;
+        uint32_t numOverruns; // within the second the block is the worst of
+    };
+
+    DeadlineMonitor() noexcept
+        : instanceId(getNextInstanceId()) {}
+
+    uint32_t getInstanceId() const noexcept
+    {
+        return instanceId;
+    }
+
+    void setSampleRate(const double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        windowMaxFrames = static_cast<uint32_t>(newSampleRate);
+        windowFrames = 0;
+        windowWorst = {};
+        windowOverruns = 0;
+    }
+
+   /**
+      Describe the processing configuration, such as the loaded files, for blocks processed from now on.
+      Not realtime safe, called from loader threads.
+    */
+    void setConfiguration(const char* const description)
+    {
+        const MutexLocker cml(configurationMutex);
+
+        const uint32_t serial = configurationSerial.load(std::memory_order_relaxed) + 1;
+        configurations[serial % kNumConfigurations] = description;
+        configurationSerial.store(serial, std::memory_order_release);
+    }
+
+    void begin() noexcept
+    {
+        blockStart = getCurrentTime();
+    }
+
+   /**
+      Account the block started by begin(), @a stages and @a slowestStage are stored as given. Realtime safe.
+    */
+    void end(const uint32_t numSamples, const uint32_t stages, const uint32_t slowestStage) noexcept
+    {
+        if (numSamples == 0)
+            return;
+
+        const uint64_t duration = getCurrentTime() - blockStart;
+        const uint64_t deadline = static_cast<uint64_t>(numSamples * 1e9 / sampleRate);
+        const double ratio = static_cast<double>(duration) / static_cast<double>(deadline);
+
+        // floor(2 * log2(ratio)), relative to the lowest bucket
+        const int bucket = ratio > 0.0 ? std::ilogb(ratio * ratio) + static_cast<int>(kDeadlineBucket) : 0;
+        std::atomic<uint32_t>& count(histogram[std::max(0, std::min(bucket, static_cast<int>(kNumBuckets) - 1))]);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        numBlocks.store(numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (duration > deadline)
+        {
+            ++windowOverruns;
+            numOverruns.store(numOverruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        if (windowWorst.deadline == 0 || duration * windowWorst.deadline > windowWorst.duration * deadline)
+        {
+            windowWorst.time = blockStart;
+            windowWorst.duration = duration;
+            windowWorst.deadline = deadline;
+            windowWorst.numSamples = numSamples;
+            windowWorst.stages = stages;
+            windowWorst.slowestStage = slowestStage;
+            windowWorst.configuration = configurationSerial.load(std::memory_order_acquire);
+        }
+
+        if ((windowFrames += numSamples) < windowMaxFrames)
+            return;
+
+        windowWorst.numOverruns = windowOverruns;
+        pushRecentBlock(windowWorst);
+
+        worstLoad.store(static_cast<float>(100.0 * windowWorst.duration / windowWorst.deadline),
+                        std::memory_order_relaxed);
+
+        windowFrames = 0;
+        windowWorst = {};
+        windowOverruns = 0;
+    }
+
+    uint32_t getNumOverruns() const noexcept
+    {
+        return numOverruns.load(std::memory_order_relaxed);
+    }
+
+    // load of the worst block during the last full second, in percent of its deadline
+    float getWorstLoad() const noexcept
+    {
+        return worstLoad.load(std::memory_order_relaxed);
+    }
+
+   /**
+      Get a text report of the histogram, recent worst blocks and the configurations they ran with.
+      @a stageNames names the values given as slowestStage, @a numStageNames of them, others are reported as unknown.
+      Not realtime safe.
+    */
+    String getReport(const char* const* const stageNames, const uint32_t numStageNames) const
+    {
+        String ret;
+        char line[512];
+
+        const uint64_t blocks = numBlocks.load(std::memory_order_relaxed);
+
+        std::snprintf(line, sizeof(line), "instance %u, %.0f Hz, %llu blocks, %u over deadline\n",
+                      instanceId,
+                      sampleRate,
+                      static_cast<unsigned long long>(blocks),
+                      numOverruns.load(std::memory_order_relaxed));
+        ret += line;
+
+        ret += "load histogram, block duration in % of its deadline:\n";
+
+        for (uint i = 0; i < kNumBuckets; ++i)
+        {
+            const uint32_t count = histogram[i].load(std::memory_order_relaxed);
+
+            if (count == 0)
+                continue;
+
+            const double low = i == 0 ? 0.0 : 100.0 * std::exp2((static_cast<int>(i) - static_cast<int>(kDeadlineBucket)) * 0.5);
+
+            if (i == kNumBuckets - 1)
+                std::snprintf(line, sizeof(line), "  %8.1f%% and up  %10u\n", low, count);
+            else
+                std::snprintf(line, sizeof(line), "  %8.1f%% - %5.1f%%  %10u\n",
+                              low,
+                              100.0 * std::exp2((static_cast<int>(i) + 1 - static_cast<int>(kDeadlineBucket)) * 0.5),
+                              count);
+            ret += line;
+        }
+
+        // steady clock times are converted to wall clock times with the current offset between both
+        const int64_t wallOffset =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()
+            - static_cast<int64_t>(getCurrentTime());
+
+        ret += "worst block of each recent second:\n";
+
+        Block blocksCopy[kNumRecentBlocks];
+        const uint numRecent = getRecentBlocks(blocksCopy);
+
+        uint32_t minConfiguration = UINT32_MAX;
+        uint32_t maxConfiguration = 0;
+
+        for (uint i = 0; i < numRecent; ++i)
+        {
+            const Block& block(blocksCopy[i]);
+            const int64_t wallTime = static_cast<int64_t>(block.time) + wallOffset;
+            const std::time_t seconds = static_cast<std::time_t>(wallTime / 1000000000);
+            char timestr[32];
+
+            std::tm tm = {};
+           #ifdef DISTRHO_OS_WINDOWS
+            localtime_s(&tm, &seconds);
+           #else
+            localtime_r(&seconds, &tm);
+           #endif
+            std::strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &tm);
+
+            std::snprintf(line, sizeof(line),
+                          "  %s.%03d  %5u frames  %8.3f ms of %8.3f ms (%6.1f%%)  %u over deadline  "
+                          "stages 0x%03x, slowest %s, configuration %u\n",
+                          timestr,
+                          static_cast<int>(wallTime / 1000000 % 1000),
+                          block.numSamples,
+                          static_cast<double>(block.duration) / 1e6,
+                          static_cast<double>(block.deadline) / 1e6,
+                          100.0 * block.duration / block.deadline,
+                          block.numOverruns,
+                          block.stages,
+                          block.slowestStage < numStageNames ? stageNames[block.slowestStage] : "unknown",
+                          block.configuration);
+            ret += line;
+
+            minConfiguration = std::min(minConfiguration, block.configuration);
+            maxConfiguration = std::max(maxConfiguration, block.configuration);
+        }
+
+        ret += "configurations:\n";
+
+        const MutexLocker cml(configurationMutex);
+        const uint32_t serial = configurationSerial.load(std::memory_order_relaxed);
+
+        // the ones used by recent blocks and the current one, as long as they were not overwritten since
+        for (uint32_t c = numRecent != 0 ? minConfiguration : serial; c <= serial; ++c)
+        {
+            if (c != serial && (c > maxConfiguration || serial - c >= kNumConfigurations))
+                continue;
+
+            std::snprintf(line, sizeof(line), "  %u%s: %s\n",
+                          c,
+                          c == serial ? " (current)" : "",
+                          configurations[c % kNumConfigurations].buffer());
+            ret += line;
+        }
+
+        return ret;
+    }
+
+private:
+    const uint32_t instanceId;
+    double sampleRate = 48000.0;
+
+    // audio thread only
+    uint64_t blockStart = 0;
+    uint32_t windowFrames = 0;
+    uint32_t windowMaxFrames = 48000;
+    uint32_t windowOverruns = 0;
+    Block windowWorst = {};
+
+    // written by the audio thread only, read from anywhere
+    std::atomic<uint32_t> histogram[kNumBuckets] = {};
+    std::atomic<uint64_t> numBlocks { 0 };
+    std::atomic<uint32_t> numOverruns { 0 };
+    std::atomic<float> worstLoad { 0.f };
+
+    // the sequence number is odd while the audio thread writes to the entry
+    struct RecentBlock {
+        std::atomic<uint32_t> sequence { 0 };
+        Block block = {};
+    } recentBlocks[kNumRecentBlocks];
+    std::atomic<uint32_t> numRecentBlocks { 0 };
+
+    // written by loader threads, the audio thread only reads the serial
+    mutable Mutex configurationMutex;
+    String configurations[kNumConfigurations];
+    std::atomic<uint32_t> configurationSerial { 0 };
+
+    void pushRecentBlock(const Block& block) noexcept
+    {
+        const uint32_t index = numRecentBlocks.load(std::memory_order_relaxed);
+        RecentBlock& entry(recentBlocks[index % kNumRecentBlocks]);
+
+        const uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+        entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.block = block;
+        entry.sequence.store(sequence + 2, std::memory_order_release);
+
+        numRecentBlocks.store(index + 1, std::memory_order_release);
+    }
+
+    // copies recent blocks oldest first, skipping entries that are being overwritten, returns how many
+    uint getRecentBlocks(Block* const out) const noexcept
+    {
+        const uint32_t total = numRecentBlocks.load(std::memory_order_acquire);
+        const uint32_t first = total > kNumRecentBlocks ? total - kNumRecentBlocks : 0;
+        uint count = 0;
+
+        for (uint32_t i = first; i < total; ++i)
+        {
+            const RecentBlock& entry(recentBlocks[i % kNumRecentBlocks]);
+
+            for (int retries = 0; retries < 4; ++retries)
+            {
+                const uint32_t sequence = entry.sequence.load(std::memory_order_acquire);
+
+                if (sequence & 1)
+                    continue;
+
+                const Block block = entry.block;
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (entry.sequence.load(std::memory_order_relaxed) != sequence)
+                    continue;
+
+                // overwritten by a newer block since reading the total, which is reported anyway
+                if (block.time != 0 && (count == 0 || block.time > out[count - 1].time))
+                    out[count++] = block;
+                break;
+            }
+        }
+
+        return count;
+    }
+
+    static uint32_t getNextInstanceId() noexcept
+    {
+        static std::atomic<uint32_t> lastInstanceId { 0 };
+        return ++lastInstanceId;
+    }
+
+    static uint64_t getCurrentTime() noexcept
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(DeadlineMonitor)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -19,6 +19,7 @@ static constexpr const uint32_t kVersionNumber = d_version(1, 1, 0);
 
 #define DISTRHO_PLUGIN_HAS_UI          1
 #define DISTRHO_PLUGIN_IS_RT_SAFE      1
+#define DISTRHO_PLUGIN_WANT_LATENCY    1
 #define DISTRHO_PLUGIN_WANT_PROGRAMS   0
 #define DISTRHO_PLUGIN_WANT_STATE      1
 #define DISTRHO_UI_FILE_BROWSER        1
@@ -48,6 +49,20 @@ static constexpr const uint32_t kVersionNumber = d_version(1, 1, 0);
 # define AIDAX_WITH_STANDALONE_CONTROLS 0
 #endif
 
+// static post EQ folded into the cabinet impulses, needs in-place impulse changes
+#ifndef AIDAX_WITH_BAKED_EQ
+# if defined(DISTRHO_OS_WASM) || defined(__EMSCRIPTEN__)
+#  define AIDAX_WITH_BAKED_EQ 0
+# else
+#  define AIDAX_WITH_BAKED_EQ 1
+# endif
+#endif
+
+// per stage timing of the DSP, reported through output parameters, can be turned off at build time
+#ifndef AIDAX_WITH_PROFILER
+# define AIDAX_WITH_PROFILER 1
+#endif
+
 // known and defined in advance
 static constexpr const uint kPedalWidth = 900;
 static constexpr const uint kPedalHeight = 318;
@@ -65,6 +80,9 @@ static constexpr const uint kPedalMarginTop = 0;
 static constexpr const char* const kDefaultModelName = "tw40_california_clean.json";
 static constexpr const char* const kDefaultCabinetName = "V30-P2-audix-i5.wav";
 
+/* Number of cabinet IRs that can be blended together */
+static constexpr const uint kCabinetSlots = 3;
+
 static constexpr const float kMinimumMeterDb = -60.f;
 
 enum Parameters {
@@ -92,12 +110,97 @@ enum Parameters {
     kParameterModelInputSize,
     kParameterMeterIn,
     kParameterMeterOut,
+    kParameterCABIR1LEVEL,
+    kParameterCABIR2LEVEL,
+    kParameterCABIR3LEVEL,
+    kParameterActiveStages,
+    kParameterLoadInput,
+    kParameterLoadModel,
+    kParameterLoadDCBlocker,
+    kParameterLoadCabinet,
+    kParameterLoadToneControls,
+    kParameterLoadOutput,
+    kParameterLoadTotal,
+    kParameterPeakInput,
+    kParameterPeakModel,
+    kParameterPeakDCBlocker,
+    kParameterPeakCabinet,
+    kParameterPeakToneControls,
+    kParameterPeakOutput,
+    kParameterPeakTotal,
+    kParameterOverruns,
+    kParameterWorstLoad,
+    kParameterModelLoadTime,
+    kParameterModelLoadSlowest,
+    kParameterCabinetLoadTime,
+    kParameterCabinetLoadSlowest,
     kParameterCount
 };
 
+// bits of kParameterActiveStages, processing stages that did run during the last audio cycle
+enum ProcessingStages {
+    kStageInputLPF   = 1 << 0,
+    kStageInputGain  = 1 << 1,
+    kStagePreEq      = 1 << 2,
+    kStageModel      = 1 << 3,
+    kStageDCBlocker  = 1 << 4,
+    kStageCabinet    = 1 << 5,
+    kStagePostEq     = 1 << 6,
+    kStageOutputGain = 1 << 7,
+    kStageBypassMix  = 1 << 8,
+    // reported alone, processing is asleep because of silence
+    kStageSleeping   = 1 << 9,
+};
+
+// stages timed by the profiler, in the order of the kParameterLoad* and kParameterPeak* parameters, which also have
+// the total of all stages as last entry
+enum ProfiledStages {
+    kProfileInput,
+    kProfileModel,
+    kProfileDCBlocker,
+    kProfileCabinet,
+    kProfileToneControls,
+    kProfileOutput,
+    kProfileCount
+};
+
+// phases of loading a model or cabinet, timed by the plugin, the slowest of the last load is reported through
+// kParameterModelLoadSlowest and kParameterCabinetLoadSlowest
+enum ModelLoadPhases {
+    kModelLoadRead,
+    kModelLoadParse,
+    kModelLoadDetect,
+    kModelLoadWeights,
+    kModelLoadWarmUp,
+    kModelLoadSwapWait,
+    kModelLoadPhaseCount
+};
+
+enum CabinetLoadPhases {
+    kCabinetLoadDecode,
+    kCabinetLoadCache,
+    kCabinetLoadFold,
+    kCabinetLoadResample,
+    kCabinetLoadPartition,
+    kCabinetLoadConvolverInit,
+    kCabinetLoadSwapWait,
+    kCabinetLoadPhaseCount
+};
+
+static const char* const kModelLoadPhaseNames[kModelLoadPhaseCount] = {
+    "read", "parse", "detect", "weights", "warm-up", "swap wait"
+};
+
+static const char* const kCabinetLoadPhaseNames[kCabinetLoadPhaseCount] = {
+    "decode", "cache", "fold", "resample", "partition", "convolver init", "swap wait"
+};
+
 enum States {
     kStateModelFile,
     kStateImpulseFile,
+    kStateImpulseFile2,
+    kStateImpulseFile3,
+    kStateCabinetLatency,
    #if AIDAX_WITH_AUDIOFILE
     kStateAudioFile,
    #endif
@@ -161,8 +264,33 @@ static const Parameter kParameters[] = {
     { kParameterIsOutput, "Model Input Size", "ModelInSize", "", 0.f, 0.f, 3.f, ARRAY_SIZE(kModelInSize), kModelInSize },
     { kParameterIsOutput, "Meter In", "MeterIn", "dB", 0.f, 0.f, 2.f, },
     { kParameterIsOutput, "Meter Out", "MeterOut", "dB", 0.f, 0.f, 2.f, },
+    { kParameterIsAutomatable, "CABIR1LEVEL", "CABIR1LEVEL", "", 1.f, 0.f, 1.f, },
+    { kParameterIsAutomatable, "CABIR2LEVEL", "CABIR2LEVEL", "", 1.f, 0.f, 1.f, },
+    { kParameterIsAutomatable, "CABIR3LEVEL", "CABIR3LEVEL", "", 1.f, 0.f, 1.f, },
+    { kParameterIsOutput|kParameterIsInteger, "Active Stages", "ActiveStages", "", 0.f, 0.f, 1023.f, },
+    { kParameterIsOutput, "Load Input", "LoadInput", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load Model", "LoadModel", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load DC Blocker", "LoadDCBlocker", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load Cabinet", "LoadCabinet", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load Tone Controls", "LoadToneControls", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load Output", "LoadOutput", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Load Total", "LoadTotal", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Input", "PeakInput", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Model", "PeakModel", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak DC Blocker", "PeakDCBlocker", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Cabinet", "PeakCabinet", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Tone Controls", "PeakToneControls", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Output", "PeakOutput", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput, "Peak Total", "PeakTotal", "%", 0.f, 0.f, 100.f, },
+    { kParameterIsOutput|kParameterIsInteger, "Overruns", "Overruns", "", 0.f, 0.f, 1000000.f, },
+    { kParameterIsOutput, "Worst Block Load", "WorstLoad", "%", 0.f, 0.f, 400.f, },
+    { kParameterIsOutput, "Model Load Time", "ModelLoadTime", "ms", 0.f, 0.f, 60000.f, },
+    { kParameterIsOutput|kParameterIsInteger, "Model Load Slowest Phase", "ModelLoadSlowest", "", 0.f, 0.f, kModelLoadPhaseCount - 1, },
+    { kParameterIsOutput, "Cabinet Load Time", "CabinetLoadTime", "ms", 0.f, 0.f, 60000.f, },
+    { kParameterIsOutput|kParameterIsInteger, "Cabinet Load Slowest Phase", "CabinetLoadSlowest", "", 0.f, 0.f, kCabinetLoadPhaseCount - 1, },
 };
 
 static constexpr const uint kNumParameters = ARRAY_SIZE(kParameters);
 
 static_assert(kNumParameters == kParameterCount, "Matched num params");
+static_assert(kParameterPeakInput - kParameterLoadInput == kProfileCount + 1, "Matched profiler params");
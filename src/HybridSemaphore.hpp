@@ -0,0 +1,164 @@
+/*
+ * AIDA-X spin-then-sleep semaphore
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "Semaphore.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(DISTRHO_OS_LINUX)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+# include <emmintrin.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Counting semaphore for short handoffs between realtime threads.
+// wait() first spins on the count for a few microseconds, and only sleeps in the kernel if nothing was posted
+// meanwhile. The spin time adapts to how often spinning was enough, and is capped in wall-clock time so that it
+// does not depend on how long a pause instruction takes on the running CPU.
+// Waiters that are not on the critical path skip spinning and sleep right away.
+// Sleeping uses a futex on Linux, other systems use a regular Semaphore for it.
+
+class HybridSemaphore
+{
+    // in nanoseconds, past a few microseconds a futex wake-up costs less than the spinning
+    static constexpr const int32_t kMinSpinTime = 250;
+    static constexpr const int32_t kMaxSpinTime = 4000;
+    // pause instructions between clock reads
+    static constexpr const int32_t kPausesPerCheck = 16;
+
+    std::atomic<int32_t> count;
+    std::atomic<int32_t> numSleepers { 0 };
+    std::atomic<int32_t> spinTime;
+   #if !defined(DISTRHO_OS_LINUX)
+    Semaphore sem;
+   #endif
+
+public:
+    HybridSemaphore(const int initialValue = 0) noexcept
+        : count(initialValue),
+          // spinning only helps if the posting thread can run meanwhile
+          spinTime(std::thread::hardware_concurrency() > 1 ? 1000 : 0) {}
+
+    void post() noexcept
+    {
+        count.fetch_add(1, std::memory_order_seq_cst);
+
+        if (numSleepers.load(std::memory_order_seq_cst) != 0)
+        {
+           #if defined(DISTRHO_OS_LINUX)
+            ::syscall(SYS_futex, &count, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+           #else
+            sem.post();
+           #endif
+        }
+    }
+
+    bool tryWait() noexcept
+    {
+        int32_t value = count.load(std::memory_order_relaxed);
+
+        while (value > 0)
+        {
+            if (count.compare_exchange_weak(value, value - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+
+        return false;
+    }
+
+   /**
+      Wait for a post.
+      Without @a critical the caller does not need to wake up quickly, such as an idle worker waiting for new jobs,
+      it then sleeps right away instead of spinning first.
+    */
+    bool wait(const bool critical = true) noexcept
+    {
+        const int32_t spinNanos = critical ? spinTime.load(std::memory_order_relaxed) : 0;
+
+        if (spinNanos != 0)
+        {
+            if (spin(spinNanos))
+            {
+                // spinning was enough, allow a bit more next time
+                if (spinNanos < kMaxSpinTime)
+                    spinTime.store(std::min(kMaxSpinTime, spinNanos + spinNanos / 4), std::memory_order_relaxed);
+                return true;
+            }
+
+            if (spinNanos > kMinSpinTime)
+                spinTime.store(std::max(kMinSpinTime, spinNanos / 2), std::memory_order_relaxed);
+        }
+
+        numSleepers.fetch_add(1, std::memory_order_seq_cst);
+
+        while (! tryWait())
+        {
+           #if defined(DISTRHO_OS_LINUX)
+            // only sleeps if nothing was posted since the check above
+            ::syscall(SYS_futex, &count, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+           #else
+            // posts may outnumber sleepers, extra wake-ups just check again
+            sem.wait();
+           #endif
+        }
+
+        numSleepers.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // in nanoseconds
+    int32_t getSpinTime() const noexcept
+    {
+        return spinTime.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool spin(const int32_t spinNanos) noexcept
+    {
+        const std::chrono::steady_clock::time_point end =
+            std::chrono::steady_clock::now() + std::chrono::nanoseconds(spinNanos);
+
+        do {
+            for (int32_t i = 0; i < kPausesPerCheck; ++i)
+            {
+                if (tryWait())
+                    return true;
+
+                pause();
+            }
+        } while (std::chrono::steady_clock::now() < end);
+
+        return tryWait();
+    }
+
+    static inline void pause() noexcept
+    {
+       #if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+       #elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+       #endif
+    }
+
+    static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "futex needs a plain 32-bit word");
+
+    DISTRHO_DECLARE_NON_COPYABLE(HybridSemaphore)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,391 @@
+/*
+ * AIDA-X cabinet impulse response cache
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "TwoStageThreadedConvolver.hpp"
+
+#include "extra/Mutex.hpp"
+#include "extra/String.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#ifndef DISTRHO_OS_WASM
+# ifdef DISTRHO_OS_WINDOWS
+#  ifndef NOMINMAX
+#   define NOMINMAX
+#  endif
+#  include <winsock2.h>
+#  include <windows.h>
+# else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+# endif
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Process-wide cache of ready-to-use convolver impulses.
+// Entries are keyed by the hash of the source file contents, host sample rate and convolver layout.
+// Instances loading the same IR share a single copy in memory, and impulses are persisted on disk
+// so that sample rate changes and session restores only need to memory-map them back.
+
+class IRCache
+{
+    static constexpr const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+    static constexpr const uint32_t kVersion = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t fftBackend;
+        uint64_t sourceHash;
+        double sampleRate;
+        uint32_t headBlockSize;
+        uint32_t tailBlockSize;
+        uint32_t headLength;
+        uint32_t irLength;
+        uint64_t payloadFloats;
+        uint32_t reserved[2];
+    };
+    static_assert(sizeof(Header) == 64, "cache header keeps the payload aligned");
+
+    typedef std::tuple<uint64_t, double, uint32_t> Key;
+
+    struct Shared {
+        Mutex mutex;
+        std::map<Key, std::weak_ptr<const ConvolverImpulse>> impulses;
+    };
+
+    static Shared& getShared()
+    {
+        static Shared shared;
+        return shared;
+    }
+
+public:
+   /**
+      FNV-1a hash, can be chained by passing the previous result as @a hash.
+    */
+    static uint64_t hash(const void* const data, const size_t size, uint64_t hash = kHashSeed) noexcept
+    {
+        const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ULL;
+        }
+
+        return hash;
+    }
+
+    static bool hashFile(const char* const filename, uint64_t& fileHash)
+    {
+        FILE* const fd = std::fopen(filename, "rb");
+        DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr, false);
+
+        uint8_t buffer[64 * 1024];
+        uint64_t h = kHashSeed;
+
+        for (size_t r; (r = std::fread(buffer, 1, sizeof(buffer), fd)) != 0;)
+            h = hash(buffer, r, h);
+
+        const bool ok = std::ferror(fd) == 0;
+        std::fclose(fd);
+
+        fileHash = h;
+        return ok;
+    }
+
+   /**
+      Find a ready impulse, either already in use by another instance or stored on disk.
+    */
+    static std::shared_ptr<const ConvolverImpulse> load(const uint64_t sourceHash, const double sampleRate,
+                                                        const uint32_t headLength)
+    {
+        Shared& shared(getShared());
+        const MutexLocker cml(shared.mutex);
+
+        const Key key(sourceHash, sampleRate, headLength);
+        const auto it = shared.impulses.find(key);
+
+        if (it != shared.impulses.end())
+        {
+            if (std::shared_ptr<const ConvolverImpulse> impulse = it->second.lock())
+                return impulse;
+
+            shared.impulses.erase(it);
+        }
+
+       #ifndef DISTRHO_OS_WASM
+        if (std::shared_ptr<const ConvolverImpulse> impulse = loadFromDisk(sourceHash, sampleRate, headLength))
+        {
+            shared.impulses[key] = impulse;
+            return impulse;
+        }
+       #endif
+
+        return nullptr;
+    }
+
+    static void store(const uint64_t sourceHash, const double sampleRate,
+                      const std::shared_ptr<const ConvolverImpulse>& impulse)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(impulse != nullptr,);
+
+        Shared& shared(getShared());
+        const MutexLocker cml(shared.mutex);
+
+        for (auto it = shared.impulses.begin(); it != shared.impulses.end();)
+        {
+            if (it->second.expired())
+                it = shared.impulses.erase(it);
+            else
+                ++it;
+        }
+
+        shared.impulses[Key(sourceHash, sampleRate, impulse->headLength)] = impulse;
+
+       #ifndef DISTRHO_OS_WASM
+        storeToDisk(sourceHash, sampleRate, *impulse);
+       #endif
+    }
+
+#ifndef DISTRHO_OS_WASM
+private:
+    static String getCacheDir()
+    {
+        if (const char* const dir = std::getenv("AIDAX_CACHE_DIR"))
+            return String(dir);
+
+       #if defined(DISTRHO_OS_WINDOWS)
+        if (const char* const localAppData = std::getenv("LOCALAPPDATA"))
+            return String(localAppData) + "\\AIDA-X\\Cache";
+       #elif defined(DISTRHO_OS_MAC)
+        if (const char* const home = std::getenv("HOME"))
+            return String(home) + "/Library/Caches/AIDA-X";
+       #else
+        if (const char* const xdgCache = std::getenv("XDG_CACHE_HOME"))
+            if (xdgCache[0] != '\0')
+                return String(xdgCache) + "/AIDA-X";
+        if (const char* const home = std::getenv("HOME"))
+            return String(home) + "/.cache/AIDA-X";
+       #endif
+
+        return String();
+    }
+
+    static String getCacheFilename(const uint64_t sourceHash, const double sampleRate, const uint32_t headLength)
+    {
+        const String dir(getCacheDir());
+
+        if (dir.isEmpty())
+            return String();
+
+        char name[128] = {};
+        std::snprintf(name, sizeof(name)-1, "%016llx-%u-%u-%u-%u-%u.axir",
+                      static_cast<unsigned long long>(sourceHash),
+                      static_cast<uint>(sampleRate + 0.5),
+                      ConvolverFFT::getBackendId(),
+                      TwoStageThreadedConvolver::kHeadBlockSize,
+                      TwoStageThreadedConvolver::kTailBlockSize,
+                      headLength);
+
+        return dir + DISTRHO_OS_SEP_STR + name;
+    }
+
+    static bool createDirectories(const String& path)
+    {
+        char* const buf = strdup(path.buffer());
+        DISTRHO_SAFE_ASSERT_RETURN(buf != nullptr, false);
+
+        bool ok = true;
+
+        for (char* p = buf + 1;; ++p)
+        {
+            const char c = *p;
+
+            if (c != '\0' && c != '/' && c != '\\')
+                continue;
+
+            *p = '\0';
+           #ifdef DISTRHO_OS_WINDOWS
+            ok = ::CreateDirectoryA(buf, nullptr) || ::GetLastError() == ERROR_ALREADY_EXISTS;
+           #else
+            ok = ::mkdir(buf, 0755) == 0 || errno == EEXIST;
+           #endif
+            *p = c;
+
+            if (c == '\0')
+                break;
+        }
+
+        std::free(buf);
+        return ok;
+    }
+
+    static bool isHeaderValid(const Header& header, const size_t fileSize,
+                              const uint64_t sourceHash, const double sampleRate, const uint32_t headLength)
+    {
+        return std::memcmp(header.magic, "AIDAXIR", 8) == 0
+            && header.version == kVersion
+            && header.fftBackend == ConvolverFFT::getBackendId()
+            && header.sourceHash == sourceHash
+            && d_isEqual(header.sampleRate, sampleRate)
+            && header.headBlockSize == TwoStageThreadedConvolver::kHeadBlockSize
+            && header.tailBlockSize == TwoStageThreadedConvolver::kTailBlockSize
+            && header.headLength == headLength
+            && header.irLength != 0
+            && header.payloadFloats == ConvolverImpulse::getPayloadFloats(header.irLength,
+                                                                          header.headLength,
+                                                                          header.headBlockSize,
+                                                                          header.tailBlockSize)
+            && fileSize == sizeof(Header) + header.payloadFloats * sizeof(float);
+    }
+
+    static std::shared_ptr<const ConvolverImpulse> loadFromDisk(const uint64_t sourceHash, const double sampleRate,
+                                                                const uint32_t headLength)
+    {
+        const String filename(getCacheFilename(sourceHash, sampleRate, headLength));
+
+        if (filename.isEmpty())
+            return nullptr;
+
+       #ifdef DISTRHO_OS_WINDOWS
+        const HANDLE file = ::CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER fileSize;
+        if (! ::GetFileSizeEx(file, &fileSize) || static_cast<size_t>(fileSize.QuadPart) < sizeof(Header))
+        {
+            ::CloseHandle(file);
+            return nullptr;
+        }
+
+        const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(file);
+        DISTRHO_SAFE_ASSERT_RETURN(mapping != nullptr, nullptr);
+
+        void* const ptr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(mapping);
+        DISTRHO_SAFE_ASSERT_RETURN(ptr != nullptr, nullptr);
+
+        const size_t size = static_cast<size_t>(fileSize.QuadPart);
+        const std::shared_ptr<const void> storage(ptr, [](const void* const p) { ::UnmapViewOfFile(p); });
+       #else
+        const int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* const ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        DISTRHO_SAFE_ASSERT_RETURN(ptr != MAP_FAILED, nullptr);
+
+        ::madvise(ptr, size, MADV_WILLNEED);
+
+        const std::shared_ptr<const void> storage(ptr, [size](const void* const p) { ::munmap(const_cast<void*>(p), size); });
+       #endif
+
+        const Header& header(*static_cast<const Header*>(ptr));
+
+        if (! isHeaderValid(header, size, sourceHash, sampleRate, headLength))
+        {
+            d_stderr("Ignoring invalid cabinet cache file %s", filename.buffer());
+            return nullptr;
+        }
+
+        const float* const payload = reinterpret_cast<const float*>(static_cast<const uint8_t*>(ptr) + sizeof(Header));
+
+        // touch every page now, so the audio thread does not page-fault on first use
+        volatile float sum = 0.f;
+        for (uint64_t i = 0; i < header.payloadFloats; i += 1024)
+            sum += payload[i];
+        (void)sum;
+
+        std::shared_ptr<ConvolverImpulse> impulse = std::make_shared<ConvolverImpulse>();
+        DISTRHO_SAFE_ASSERT_RETURN(impulse->assign(payload,
+                                                   header.irLength,
+                                                   header.headLength,
+                                                   header.headBlockSize,
+                                                   header.tailBlockSize), nullptr);
+        impulse->storage = storage;
+
+        d_stdout("Loaded cabinet from cache file %s", filename.buffer());
+        return impulse;
+    }
+
+    static void storeToDisk(const uint64_t sourceHash, const double sampleRate, const ConvolverImpulse& impulse)
+    {
+        const String dir(getCacheDir());
+
+        if (dir.isEmpty() || ! createDirectories(dir))
+            return;
+
+        const String filename(getCacheFilename(sourceHash, sampleRate, impulse.headLength));
+
+        char suffix[32] = {};
+        std::snprintf(suffix, sizeof(suffix)-1, ".tmp%p", static_cast<const void*>(&impulse));
+        const String tmpFilename(filename + suffix);
+
+        Header header = {};
+        std::memcpy(header.magic, "AIDAXIR", 8);
+        header.version = kVersion;
+        header.fftBackend = ConvolverFFT::getBackendId();
+        header.sourceHash = sourceHash;
+        header.sampleRate = sampleRate;
+        header.headBlockSize = impulse.head.blockSize;
+        header.tailBlockSize = TwoStageThreadedConvolver::kTailBlockSize;
+        header.headLength = impulse.headLength;
+        header.irLength = impulse.irLength;
+        header.payloadFloats = ConvolverImpulse::getPayloadFloats(impulse.irLength,
+                                                                  impulse.headLength,
+                                                                  header.headBlockSize,
+                                                                  header.tailBlockSize);
+
+        FILE* const fd = std::fopen(tmpFilename, "wb");
+        DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr,);
+
+        // the payload is contiguous, starting at the time-domain samples
+        bool ok = std::fwrite(&header, sizeof(header), 1, fd) == 1;
+        ok = ok && std::fwrite(impulse.ir, sizeof(float), header.payloadFloats, fd) == header.payloadFloats;
+        ok = std::fclose(fd) == 0 && ok;
+
+       #ifdef DISTRHO_OS_WINDOWS
+        ok = ok && ::MoveFileExA(tmpFilename, filename, MOVEFILE_REPLACE_EXISTING);
+       #else
+        ok = ok && std::rename(tmpFilename, filename) == 0;
+       #endif
+
+        if (! ok)
+        {
+            d_stderr("Failed to write cabinet cache file %s", filename.buffer());
+            std::remove(tmpFilename);
+        }
+    }
+#endif
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,114 @@
+/*
+ * AIDA-X load timer
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "extra/String.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Times the phases of loading a model or cabinet, for telling which part of a stall is parsing, resampling, waiting
+// on the audio thread and so on.
+// The loader calls start(), then mark() after each phase, the time since the previous call being added to that phase.
+// Marks outside of a load, from code shared with other paths, are ignored. finish() ends the load, a load that fails
+// halfway is simply never finished.
+
+template <uint32_t kNumPhases>
+class LoadTimer
+{
+public:
+    void start() noexcept
+    {
+        std::fill(phaseTimes, phaseTimes + kNumPhases, 0.0);
+        lastTime = std::chrono::steady_clock::now();
+        running = true;
+    }
+
+    void mark(const uint32_t phase) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(phase < kNumPhases,);
+
+        if (! running)
+            return;
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        phaseTimes[phase] += std::chrono::duration<double, std::milli>(now - lastTime).count();
+        lastTime = now;
+    }
+
+    // returns false if no load was started since the last finish
+    bool finish() noexcept
+    {
+        const bool wasRunning = running;
+        running = false;
+        return wasRunning;
+    }
+
+    // in ms
+    double getPhaseTime(const uint32_t phase) const noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(phase < kNumPhases, 0.0);
+
+        return phaseTimes[phase];
+    }
+
+    // in ms
+    double getTotalTime() const noexcept
+    {
+        double total = 0.0;
+
+        for (uint32_t i = 0; i < kNumPhases; ++i)
+            total += phaseTimes[i];
+
+        return total;
+    }
+
+    uint32_t getSlowestPhase() const noexcept
+    {
+        return static_cast<uint32_t>(std::max_element(phaseTimes, phaseTimes + kNumPhases) - phaseTimes);
+    }
+
+   /**
+      Get a single line summary of the last load, like "model foo.json: 12.3 ms, read 0.4, parse 9.1, ...".
+      Phases that took no time, such as resampling when rates match, are left out.
+    */
+    String getSummary(const char* const what, const char* const name, const char* const* const phaseNames) const
+    {
+        char buf[64];
+
+        std::snprintf(buf, sizeof(buf), ": %.1f ms", getTotalTime());
+
+        String ret(what);
+        ret += " ";
+        ret += name;
+        ret += buf;
+
+        for (uint32_t i = 0; i < kNumPhases; ++i)
+        {
+            if (phaseTimes[i] <= 0.0)
+                continue;
+
+            std::snprintf(buf, sizeof(buf), ", %s %.1f", phaseNames[i], phaseTimes[i]);
+            ret += buf;
+        }
+
+        return ret;
+    }
+
+private:
+    double phaseTimes[kNumPhases] = {};
+    std::chrono::steady_clock::time_point lastTime;
+    bool running = false;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,305 @@
+/*
+ * AIDA-X model batch groups
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "BatchedModel.hpp"
+#include "ConvolverWorkerPool.hpp"
+#include "TraceRecorder.hpp"
+
+#include "extra/Mutex.hpp"
+#include "extra/String.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Plugin instances in one process running the same model, stepped together through a single BatchedModel.
+// Meant for hosts that process many instances in parallel within each cycle, such as the rack, which puts chains
+// loading the same file into a group through the "model-batch" state.
+// Every member reaches the group once per cycle, either with its model input through process() or through skip()
+// when its model stage does not run. The last one to arrive steps all streams, skipped ones keep their state.
+// Members waiting for the others run queued jobs of the worker pool meanwhile, the group never waits for a member
+// that has not started yet. Arrivals are counted before waiting, so members can run each other without deadlocks.
+// All members must process the same number of frames per cycle, as with a single host cycle.
+
+class ModelBatchGroup
+{
+public:
+   /**
+      Get the group called @a name, creating it for @a numMembers members if needed. Must be balanced with release().
+      Returns null if the group exists with another number of members.
+    */
+    static ModelBatchGroup* acquire(const char* const name, const uint numMembers)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numMembers >= 1 && numMembers <= BatchedModel::kMaxStreams, nullptr);
+
+        Global& global(getGlobal());
+        const MutexLocker cml(global.mutex);
+
+        for (ModelBatchGroup* group : global.groups)
+        {
+            if (group->name != name)
+                continue;
+
+            DISTRHO_SAFE_ASSERT_RETURN(group->numMembers == numMembers, nullptr);
+
+            ++group->refCount;
+            return group;
+        }
+
+        ModelBatchGroup* const group = new ModelBatchGroup(name, numMembers);
+        global.groups.push_back(group);
+        return group;
+    }
+
+    static void release(ModelBatchGroup* const group)
+    {
+        Global& global(getGlobal());
+        const MutexLocker cml(global.mutex);
+
+        DISTRHO_SAFE_ASSERT_RETURN(group->refCount != 0,);
+
+        if (--group->refCount != 0)
+            return;
+
+        for (auto it = global.groups.begin(); it != global.groups.end(); ++it)
+        {
+            if (*it == group)
+            {
+                global.groups.erase(it);
+                break;
+            }
+        }
+
+        delete group;
+    }
+
+    uint getNumMembers() const noexcept
+    {
+        return numMembers;
+    }
+
+    int getInputSize() const noexcept
+    {
+        return batched.getInputSize();
+    }
+
+   /**
+      Load the model of the group, for models loaded from @a modelName (empty for the built-in one).
+      The first model loaded stays, returns false if it came from another file or could not be batched.
+      Only allowed before processing starts, throws on malformed json like BatchedModel::load() does.
+    */
+    bool load(const char* const modelName, const nlohmann::json& modelJson)
+    {
+        const MutexLocker cml(mutex);
+
+        if (batched.getNumStreams() != 0)
+            return loadedModelName == modelName;
+
+        if (! batched.load(modelJson, numMembers))
+            return false;
+
+        loadedModelName = modelName;
+        savedStates.resize(numMembers * batched.getStreamStateSize());
+        return true;
+    }
+
+   /**
+      Make room for cycles of up to @a maxFrames frames. Only allowed while no member is processing.
+    */
+    void prepare(const uint32_t maxFrames)
+    {
+        const MutexLocker cml(mutex);
+
+        if (maxFrames <= this->maxFrames)
+            return;
+
+        this->maxFrames = maxFrames;
+        silence.assign(maxFrames * BatchedModel::kMaxInputSize, 0.f);
+        scratch.resize(maxFrames);
+    }
+
+   /**
+      Step the stream of @a slot by @a numFrames, together with those of the other members.
+      Reads getInputSize() interleaved values per frame from @a inputs and writes the model output to @a outputs.
+      Returns once all members arrived and the step is done.
+    */
+    void process(const uint slot, const float* const inputs, float* const outputs, const uint32_t numFrames) noexcept
+    {
+        Member& member(members[slot]);
+        member.inputs = inputs;
+        member.outputs = outputs;
+        member.numFrames = numFrames;
+        member.active = true;
+
+        const uint32_t cycle = numCycles.load(std::memory_order_acquire);
+
+        if (arrive())
+            return;
+
+        const TraceScope ts("model batch wait");
+
+        while (numCycles.load(std::memory_order_acquire) == cycle)
+        {
+            if (! pool->runQueuedJob())
+                std::this_thread::yield();
+        }
+    }
+
+   /**
+      Leave the stream of @a slot out of this cycle, its state is kept. Does not wait for the other members.
+    */
+    void skip(const uint slot) noexcept
+    {
+        members[slot].active = false;
+        arrive();
+    }
+
+   /**
+      Run the stream of @a slot alone, such as for warming up a newly loaded model.
+      With @a reset the stream starts over from a zero state first. Only allowed before processing.
+    */
+    void processAlone(const uint slot, const float* const inputs, float* const outputs, const uint32_t numFrames,
+                      const bool reset = false)
+    {
+        const MutexLocker cml(mutex);
+
+        DISTRHO_SAFE_ASSERT_RETURN(numFrames <= maxFrames,);
+
+        if (reset && batched.getNumStreams() != 0)
+            batched.resetStream(slot);
+
+        for (uint k = 0; k < numMembers; ++k)
+            members[k].active = k == slot;
+
+        members[slot].inputs = inputs;
+        members[slot].outputs = outputs;
+        members[slot].numFrames = numFrames;
+        step();
+    }
+
+private:
+    struct Member {
+        const float* inputs = nullptr;
+        float* outputs = nullptr;
+        uint32_t numFrames = 0;
+        bool active = false;
+    };
+
+    struct Global {
+        Mutex mutex;
+        std::vector<ModelBatchGroup*> groups;
+    };
+
+    const String name;
+    const uint numMembers;
+    uint refCount = 1;
+    ConvolverWorkerPool* const pool;
+
+    Mutex mutex;
+    BatchedModel batched;
+    String loadedModelName;
+    Member members[BatchedModel::kMaxStreams];
+    // members still to arrive in this cycle, and cycles completed so far
+    std::atomic<uint> numPending;
+    std::atomic<uint32_t> numCycles { 0 };
+
+    // input and output of skipped streams, and their state while the others step
+    uint32_t maxFrames = 0;
+    std::vector<float> silence;
+    std::vector<float> scratch;
+    std::vector<float> savedStates;
+
+    ModelBatchGroup(const char* const n, const uint numMembers_)
+        : name(n),
+          numMembers(numMembers_),
+          pool(ConvolverWorkerPool::acquire()),
+          numPending(numMembers_) {}
+
+    ~ModelBatchGroup()
+    {
+        ConvolverWorkerPool::release();
+    }
+
+    static Global& getGlobal()
+    {
+        static Global global;
+        return global;
+    }
+
+    // returns true for the last member to arrive, which has run the step by then
+    bool arrive() noexcept
+    {
+        if (numPending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return false;
+
+        step();
+
+        numPending.store(numMembers, std::memory_order_relaxed);
+        numCycles.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    void step() noexcept
+    {
+        if (batched.getNumStreams() == 0)
+            return;
+
+        const float* inputs[BatchedModel::kMaxStreams];
+        float* outputs[BatchedModel::kMaxStreams];
+        uint32_t numFrames = 0;
+
+        for (uint k = 0; k < numMembers; ++k)
+        {
+            if (members[k].active)
+                numFrames = members[k].numFrames;
+        }
+
+        // nobody needs a step, all states stay as they are
+        if (numFrames == 0)
+            return;
+
+        DISTRHO_SAFE_ASSERT_RETURN(numFrames <= maxFrames,);
+
+        const TraceScope ts("model batch step");
+        const uint stateSize = batched.getStreamStateSize();
+
+        for (uint k = 0; k < numMembers; ++k)
+        {
+            const Member& member(members[k]);
+
+            if (member.active)
+            {
+                DISTRHO_SAFE_ASSERT_RETURN(member.numFrames == numFrames,);
+                inputs[k] = member.inputs;
+                outputs[k] = member.outputs;
+            }
+            else
+            {
+                batched.saveStream(k, savedStates.data() + k * stateSize);
+                inputs[k] = silence.data();
+                outputs[k] = scratch.data();
+            }
+        }
+
+        batched.process(inputs, outputs, numFrames);
+
+        for (uint k = 0; k < numMembers; ++k)
+        {
+            if (! members[k].active)
+                batched.restoreStream(k, savedStates.data() + k * stateSize);
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ModelBatchGroup)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
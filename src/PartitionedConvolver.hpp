@@ -0,0 +1,604 @@
+/*
+ * Uniformly Partitioned Convolver
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+// build-time FFT backend selection, pffft is the SIMD-optimized FFT that ships with r8brain
+#ifndef AIDAX_WITH_PFFFT
+# define AIDAX_WITH_PFFFT 1
+#endif
+
+#if AIDAX_WITH_PFFFT
+# include "pffft.h"
+#else
+# include "AudioFFT.h"
+#endif
+#include "Utilities.h"
+
+#include <cstring>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// zero-initialized float storage, aligned for SIMD use
+
+class ConvolverBuffer
+{
+    static constexpr const size_t kAlignment = 64;
+
+    uint8_t* allocated = nullptr;
+    float* buffer = nullptr;
+    size_t size = 0;
+
+public:
+    ConvolverBuffer() noexcept {}
+
+    explicit ConvolverBuffer(const size_t newSize)
+    {
+        resize(newSize);
+    }
+
+    ~ConvolverBuffer()
+    {
+        delete[] allocated;
+    }
+
+    void resize(const size_t newSize)
+    {
+        delete[] allocated;
+
+        if (newSize == 0)
+        {
+            allocated = nullptr;
+            buffer = nullptr;
+            size = 0;
+            return;
+        }
+
+        allocated = new uint8_t[newSize * sizeof(float) + kAlignment];
+        buffer = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(allocated) + kAlignment - 1) & ~(kAlignment - 1));
+        size = newSize;
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        if (size != 0)
+            std::memset(buffer, 0, sizeof(float) * size);
+    }
+
+    float* data() noexcept { return buffer; }
+    const float* data() const noexcept { return buffer; }
+    size_t getSize() const noexcept { return size; }
+
+    float& operator[](const size_t index) noexcept { return buffer[index]; }
+    const float& operator[](const size_t index) const noexcept { return buffer[index]; }
+
+    static void swap(ConvolverBuffer& a, ConvolverBuffer& b) noexcept
+    {
+        std::swap(a.allocated, b.allocated);
+        std::swap(a.buffer, b.buffer);
+        std::swap(a.size, b.size);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolverBuffer)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// real FFT of size 2*blockSize, spectrum layout depends on the backend
+
+#if AIDAX_WITH_PFFFT
+// spectra are kept in pffft internal (unordered) layout, which is all convolution needs
+class ConvolverFFT
+{
+    PFFFT_Setup* setup = nullptr;
+    ConvolverBuffer work;
+    uint32_t fftSize = 0;
+    float scale = 0.f;
+
+public:
+    ConvolverFFT() noexcept {}
+
+    ~ConvolverFFT()
+    {
+        if (setup != nullptr)
+            pffft_destroy_setup(setup);
+    }
+
+    // identifies the spectrum memory layout, stored spectra are only valid for the same backend
+    static uint32_t getBackendId() noexcept
+    {
+        // unordered layout changes with the SIMD width
+        return 0x100 | static_cast<uint32_t>(pffft_simd_size());
+    }
+
+    static uint32_t getSpectrumSize(const uint32_t size) noexcept
+    {
+        return size;
+    }
+
+    void init(const uint32_t size)
+    {
+        if (setup != nullptr)
+            pffft_destroy_setup(setup);
+
+        setup = pffft_new_setup(static_cast<int>(size), PFFFT_REAL);
+        DISTRHO_SAFE_ASSERT_RETURN(setup != nullptr,);
+
+        work.resize(size);
+        fftSize = size;
+        scale = 1.f / static_cast<float>(size);
+    }
+
+    uint32_t getSize() const noexcept
+    {
+        return fftSize;
+    }
+
+    uint32_t getSpectrumSize() const noexcept
+    {
+        return fftSize;
+    }
+
+    void forward(const float* const input, float* const spectrum) noexcept
+    {
+        pffft_transform(setup, input, spectrum, work.data(), PFFFT_FORWARD);
+    }
+
+    // output is scaled by 1/size
+    void inverse(const float* const spectrum, float* const output) noexcept
+    {
+        pffft_transform(setup, spectrum, output, work.data(), PFFFT_BACKWARD);
+
+        for (uint32_t i = 0; i < fftSize; ++i)
+            output[i] *= scale;
+    }
+
+    // acc += a * b
+    void multiplyAccumulate(float* const acc, const float* const a, const float* const b) const noexcept
+    {
+        pffft_zconvolve_accumulate(setup, a, b, acc, 1.f);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolverFFT)
+};
+#else
+// spectra are stored as contiguous real and imaginary halves
+class ConvolverFFT
+{
+    audiofft::AudioFFT fft;
+    uint32_t fftSize = 0;
+    uint32_t complexSize = 0;
+
+public:
+    // identifies the spectrum memory layout, stored spectra are only valid for the same backend
+    static uint32_t getBackendId() noexcept
+    {
+        return 1;
+    }
+
+    static uint32_t getSpectrumSize(const uint32_t size) noexcept
+    {
+        return static_cast<uint32_t>(audiofft::AudioFFT::ComplexSize(size)) * 2;
+    }
+
+    void init(const uint32_t size)
+    {
+        fftSize = size;
+        complexSize = static_cast<uint32_t>(audiofft::AudioFFT::ComplexSize(size));
+        fft.init(size);
+    }
+
+    uint32_t getSize() const noexcept
+    {
+        return fftSize;
+    }
+
+    uint32_t getSpectrumSize() const noexcept
+    {
+        return complexSize * 2;
+    }
+
+    void forward(const float* const input, float* const spectrum)
+    {
+        fft.fft(input, spectrum, spectrum + complexSize);
+    }
+
+    // output is scaled by 1/size
+    void inverse(const float* const spectrum, float* const output)
+    {
+        fft.ifft(output, spectrum, spectrum + complexSize);
+    }
+
+    // acc += a * b
+    void multiplyAccumulate(float* const acc, const float* const a, const float* const b) const noexcept
+    {
+        fftconvolver::ComplexMultiplyAccumulate(acc, acc + complexSize,
+                                                a, a + complexSize,
+                                                b, b + complexSize,
+                                                complexSize);
+    }
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// frequency-domain partitions of an impulse response, memory is owned elsewhere
+
+struct ConvolverSpectrum {
+    uint32_t blockSize = 0;
+    uint32_t spectrumSize = 0;
+    uint32_t numPartitions = 0;
+    const float* data = nullptr;
+
+    static uint32_t getNumPartitions(const uint32_t blockSize, const uint32_t irLen) noexcept
+    {
+        return (irLen + blockSize - 1) / blockSize;
+    }
+
+    static uint32_t getNumFloats(const uint32_t blockSize, const uint32_t irLen) noexcept
+    {
+        return getNumPartitions(blockSize, irLen) * ConvolverFFT::getSpectrumSize(blockSize * 2);
+    }
+
+    const float* getPartition(const uint32_t index) const noexcept
+    {
+        return data + static_cast<size_t>(index) * spectrumSize;
+    }
+
+   /**
+      Compute the partitions of @a ir into @a dest, which must hold getNumFloats(blockSize, irLen) values.
+    */
+    void compute(float* const dest, const uint32_t newBlockSize, const float* const ir, const uint32_t irLen)
+    {
+        ConvolverFFT fft;
+        fft.init(newBlockSize * 2);
+
+        blockSize = newBlockSize;
+        spectrumSize = fft.getSpectrumSize();
+        numPartitions = getNumPartitions(newBlockSize, irLen);
+        data = dest;
+
+        ConvolverBuffer fftBuffer(newBlockSize * 2);
+
+        for (uint32_t i = 0; i < numPartitions; ++i)
+        {
+            const uint32_t offset = i * newBlockSize;
+            const uint32_t len = std::min(newBlockSize, irLen - offset);
+
+            fftBuffer.clear();
+            std::memcpy(fftBuffer.data(), ir + offset, sizeof(float) * len);
+            fft.forward(fftBuffer.data(), dest + static_cast<size_t>(i) * spectrumSize);
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// weighted sum of several impulse response spectra of the same block size
+// as the FFT is linear, convolving against the sum gives the same result as summing the weighted convolutions,
+// for the cost of a single convolution while the weights stay the same
+
+class ConvolverSpectrumMixer
+{
+public:
+    static constexpr const uint32_t kMaxSources = 3;
+
+private:
+    ConvolverSpectrum sources[kMaxSources];
+    ConvolverSpectrum spectrum;
+    ConvolverBuffer mixed;
+    float weights[kMaxSources] = {};
+    bool weighted = false;
+
+public:
+    ConvolverSpectrumMixer() noexcept {}
+
+   /**
+      Set up for @a numSources spectra, entries without partitions are skipped.
+      If @a newWeighted is false a single source is used as-is and weights are ignored.
+    */
+    bool init(const ConvolverSpectrum* const newSources, const uint32_t numSources, const bool newWeighted)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSources <= kMaxSources, false);
+
+        spectrum = ConvolverSpectrum();
+        weighted = newWeighted;
+
+        for (uint32_t i = 0; i < kMaxSources; ++i)
+        {
+            sources[i] = i < numSources ? newSources[i] : ConvolverSpectrum();
+            weights[i] = 0.f;
+
+            if (sources[i].numPartitions == 0)
+                continue;
+
+            if (spectrum.numPartitions == 0)
+            {
+                spectrum = sources[i];
+            }
+            else
+            {
+                DISTRHO_SAFE_ASSERT_RETURN(sources[i].blockSize == spectrum.blockSize, false);
+                spectrum.numPartitions = std::max(spectrum.numPartitions, sources[i].numPartitions);
+            }
+        }
+
+        if (! weighted)
+        {
+            mixed.resize(0);
+            return true;
+        }
+
+        mixed.resize(static_cast<size_t>(spectrum.numPartitions) * spectrum.spectrumSize);
+        spectrum.data = mixed.data();
+        return true;
+    }
+
+    const ConvolverSpectrum& getSpectrum() const noexcept
+    {
+        return spectrum;
+    }
+
+   /**
+      Rebuild the mixed spectrum if @a newWeights changed, returns true if it did.
+    */
+    bool update(const float* const newWeights) noexcept
+    {
+        if (! weighted || std::memcmp(weights, newWeights, sizeof(weights)) == 0)
+            return false;
+
+        std::memcpy(weights, newWeights, sizeof(weights));
+        mixed.clear();
+
+        for (uint32_t i = 0; i < kMaxSources; ++i)
+        {
+            const ConvolverSpectrum& source(sources[i]);
+            const float weight = weights[i];
+
+            if (source.numPartitions == 0 || weight == 0.f)
+                continue;
+
+            const size_t size = static_cast<size_t>(source.numPartitions) * source.spectrumSize;
+            float* const dest = mixed.data();
+            const float* const src = source.data;
+
+            for (size_t j = 0; j < size; ++j)
+                dest[j] += src[j] * weight;
+        }
+
+        return true;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolverSpectrumMixer)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// zero-latency uniformly partitioned convolution against an external spectrum, as done by fftconvolver::FFTConvolver
+// the input spectra history can be longer than the spectrum, so that it can be switched to a longer one later on
+
+class PartitionedConvolver
+{
+    ConvolverFFT fft;
+    ConvolverSpectrum spectrum;
+    ConvolverSpectrum fadeSpectrum;
+    uint32_t blockSize = 0;
+    uint32_t spectrumSize = 0;
+    uint32_t capacity = 0;
+    uint32_t current = 0;
+    uint32_t inputFill = 0;
+    uint32_t fadeBlocks = 0;
+    uint32_t fadePos = 0;
+    float fadeGain = 1.f;
+    ConvolverBuffer inputSpectra;
+    ConvolverBuffer inputBuffer;
+    ConvolverBuffer fftBuffer;
+    ConvolverBuffer overlap;
+    ConvolverBuffer preMultiplied;
+    ConvolverBuffer preMultipliedFade;
+    ConvolverBuffer conv;
+    ConvolverBuffer convFade;
+
+public:
+    PartitionedConvolver() noexcept {}
+
+   /**
+      Set up for @a newSpectrum, keeping an input history of at least @a minCapacity partitions.
+    */
+    bool init(const ConvolverSpectrum& newSpectrum, const uint32_t minCapacity = 0)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(newSpectrum.blockSize != 0, false);
+        DISTRHO_SAFE_ASSERT_RETURN(newSpectrum.numPartitions != 0, false);
+
+        fft.init(newSpectrum.blockSize * 2);
+        DISTRHO_SAFE_ASSERT_RETURN(fft.getSpectrumSize() == newSpectrum.spectrumSize, false);
+
+        spectrum = newSpectrum;
+        fadeSpectrum = ConvolverSpectrum();
+        blockSize = newSpectrum.blockSize;
+        spectrumSize = newSpectrum.spectrumSize;
+        capacity = std::max(newSpectrum.numPartitions, minCapacity);
+
+        inputSpectra.resize(static_cast<size_t>(spectrumSize) * capacity);
+        inputBuffer.resize(blockSize);
+        fftBuffer.resize(blockSize * 2);
+        overlap.resize(blockSize);
+        preMultiplied.resize(spectrumSize);
+        preMultipliedFade.resize(spectrumSize);
+        conv.resize(spectrumSize);
+        convFade.resize(spectrumSize);
+
+        current = inputFill = 0;
+        fadeBlocks = fadePos = 0;
+        fadeGain = 1.f;
+        return true;
+    }
+
+    void reset() noexcept
+    {
+        inputSpectra.clear();
+        inputBuffer.clear();
+        overlap.clear();
+        current = inputFill = 0;
+    }
+
+    uint32_t getBlockSize() const noexcept
+    {
+        return blockSize;
+    }
+
+    // longest spectrum that can be used with the current input history
+    uint32_t getCapacity() const noexcept
+    {
+        return capacity;
+    }
+
+    // samples into the current block, spectrum contents may only change when this is 0
+    uint32_t getInputFill() const noexcept
+    {
+        return inputFill;
+    }
+
+   /**
+      Switch to @a newSpectrum, crossfading from the current one over @a numBlocks blocks.
+      The input history is kept, so the new spectrum starts with its full tail right away.
+      Both spectra are convolved during the fade, which finishes at the end of the last faded block.
+      With 0 blocks the switch is immediate, output continues as if the new spectrum had always been used.
+      Must be called on a block boundary (getInputFill() == 0) and not while still fading.
+    */
+    bool fadeTo(const ConvolverSpectrum& newSpectrum, const uint32_t numBlocks) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(inputFill == 0, false);
+        DISTRHO_SAFE_ASSERT_RETURN(! isFading(), false);
+        DISTRHO_SAFE_ASSERT_RETURN(newSpectrum.numPartitions <= capacity, false);
+        DISTRHO_SAFE_ASSERT_RETURN(newSpectrum.numPartitions == 0 ||
+                                   newSpectrum.spectrumSize == spectrumSize, false);
+
+        if (numBlocks != 0)
+            fadeSpectrum = spectrum;
+
+        spectrum = newSpectrum;
+        fadeBlocks = numBlocks;
+        fadePos = 0;
+
+        // switching at once, the overlap of the previous block must come from the new spectrum too
+        if (numBlocks == 0)
+            recomputeOverlap();
+
+        return true;
+    }
+
+    bool isFading() const noexcept
+    {
+        return fadePos < fadeBlocks;
+    }
+
+   /**
+      Convolve @a len samples, writing (not adding) into @a output.
+    */
+    void process(const float* const input, float* const output, const uint32_t len) noexcept
+    {
+        for (uint32_t processed = 0; processed < len;)
+        {
+            const bool inputBufferWasEmpty = inputFill == 0;
+            const uint32_t processing = std::min(len - processed, blockSize - inputFill);
+            const uint32_t inputBufferPos = inputFill;
+            float* const currentSpectrum = inputSpectra.data() + static_cast<size_t>(current) * spectrumSize;
+            std::memcpy(inputBuffer.data() + inputBufferPos, input + processed, sizeof(float) * processing);
+
+            // forward FFT of the (partially filled) current block
+            std::memcpy(fftBuffer.data(), inputBuffer.data(), sizeof(float) * blockSize);
+            std::memset(fftBuffer.data() + blockSize, 0, sizeof(float) * blockSize);
+            fft.forward(fftBuffer.data(), currentSpectrum);
+
+            // older partitions only change once per block
+            if (inputBufferWasEmpty)
+            {
+                preMultiply(preMultiplied.data(), spectrum);
+
+                if (isFading())
+                {
+                    preMultiply(preMultipliedFade.data(), fadeSpectrum);
+                    fadeGain = static_cast<float>(fadePos + 1) / static_cast<float>(fadeBlocks + 1);
+                }
+            }
+
+            std::memcpy(conv.data(), preMultiplied.data(), sizeof(float) * spectrumSize);
+            if (spectrum.numPartitions != 0)
+                fft.multiplyAccumulate(conv.data(), spectrum.getPartition(0), currentSpectrum);
+
+            if (isFading())
+            {
+                std::memcpy(convFade.data(), preMultipliedFade.data(), sizeof(float) * spectrumSize);
+                if (fadeSpectrum.numPartitions != 0)
+                    fft.multiplyAccumulate(convFade.data(), fadeSpectrum.getPartition(0), currentSpectrum);
+
+                // the transform is linear, so mixing spectra is the same as mixing both outputs
+                float* const convData = conv.data();
+                const float* const convFadeData = convFade.data();
+
+                for (uint32_t i = 0; i < spectrumSize; ++i)
+                    convData[i] = convFadeData[i] + (convData[i] - convFadeData[i]) * fadeGain;
+            }
+
+            fft.inverse(conv.data(), fftBuffer.data());
+
+            // add overlap
+            fftconvolver::Sum(output + processed, fftBuffer.data() + inputBufferPos, overlap.data() + inputBufferPos, processing);
+
+            inputFill += processing;
+
+            if (inputFill == blockSize)
+            {
+                inputBuffer.clear();
+                inputFill = 0;
+
+                std::memcpy(overlap.data(), fftBuffer.data() + blockSize, sizeof(float) * blockSize);
+
+                current = current > 0 ? current - 1 : capacity - 1;
+
+                if (isFading() && ++fadePos == fadeBlocks)
+                    fadeSpectrum = ConvolverSpectrum();
+            }
+
+            processed += processing;
+        }
+    }
+
+private:
+    void recomputeOverlap() noexcept
+    {
+        // the previous block is the one right after the current slot
+        std::memset(conv.data(), 0, sizeof(float) * spectrumSize);
+
+        for (uint32_t i = 0; i < spectrum.numPartitions; ++i)
+        {
+            const uint32_t indexAudio = (current + 1 + i) % capacity;
+            fft.multiplyAccumulate(conv.data(),
+                                   spectrum.getPartition(i),
+                                   inputSpectra.data() + static_cast<size_t>(indexAudio) * spectrumSize);
+        }
+
+        fft.inverse(conv.data(), fftBuffer.data());
+        std::memcpy(overlap.data(), fftBuffer.data() + blockSize, sizeof(float) * blockSize);
+    }
+
+    void preMultiply(float* const dest, const ConvolverSpectrum& spec) noexcept
+    {
+        std::memset(dest, 0, sizeof(float) * spectrumSize);
+
+        for (uint32_t i = 1; i < spec.numPartitions; ++i)
+        {
+            const uint32_t indexAudio = (current + i) % capacity;
+            fft.multiplyAccumulate(dest,
+                                   spec.getPartition(i),
+                                   inputSpectra.data() + static_cast<size_t>(indexAudio) * spectrumSize);
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(PartitionedConvolver)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
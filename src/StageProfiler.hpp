@@ -0,0 +1,199 @@
+/*
+ * AIDA-X stage profiler
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#if AIDAX_WITH_PROFILER && (defined(__x86_64__) || defined(__i386__))
+# include <x86intrin.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+#if AIDAX_WITH_PROFILER
+// --------------------------------------------------------------------------------------------------------------------
+// Measures how much of the audio block duration each processing stage takes, for telling apart CPU issues caused by
+// the model, the cabinet or the filters.
+// The audio thread calls begin() before processing and mark() after each stage, the time since the previous call is
+// added to that stage. Timestamps come from the CPU cycle counter where there is one, which is calibrated against the
+// steady clock whenever results are published, so a block costs a handful of counter reads and no clock calls.
+// Results are a running average per stage and the worst block since the last publish, as a percentage of the block
+// duration, plus the same for all stages together as the last entry.
+
+template <uint32_t kNumStages>
+class StageProfiler
+{
+public:
+    static constexpr const uint32_t kNumResults = kNumStages + 1;
+
+    StageProfiler() noexcept {}
+
+    void setSampleRate(const double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        lastCalibrationTime = 0;
+        windowFrames = 0;
+
+        std::fill(windowTicks, windowTicks + kNumStages, 0);
+        std::fill(averages, averages + kNumResults, 0.f);
+        std::fill(peaks, peaks + kNumResults, 0.f);
+    }
+
+    void begin() noexcept
+    {
+        std::fill(blockTicks, blockTicks + kNumStages, 0);
+        lastTick = readCounter();
+    }
+
+    void mark(const uint32_t stage) noexcept
+    {
+        const uint64_t tick = readCounter();
+        blockTicks[stage] += tick - lastTick;
+        lastTick = tick;
+    }
+
+    // time since the last mark goes to @a stage
+    void end(const uint32_t numSamples, const uint32_t stage) noexcept
+    {
+        mark(stage);
+
+        uint64_t totalTicks = 0;
+
+        for (uint32_t i = 0; i < kNumStages; ++i)
+        {
+            windowTicks[i] += blockTicks[i];
+            totalTicks += blockTicks[i];
+        }
+
+        windowFrames += numSamples;
+
+        // block peaks need a calibrated counter, the first publish takes care of it
+        if (ticksPerSecond <= 0.0 || numSamples == 0)
+            return;
+
+        const double scale = 100.0 * sampleRate / (ticksPerSecond * numSamples);
+
+        for (uint32_t i = 0; i < kNumStages; ++i)
+            peaks[i] = std::max(peaks[i], static_cast<float>(blockTicks[i] * scale));
+
+        peaks[kNumStages] = std::max(peaks[kNumStages], static_cast<float>(totalTicks * scale));
+    }
+
+    // stage that took the longest in the last ended block, kNumStages if unknown
+    uint32_t getSlowestStage() const noexcept
+    {
+        return static_cast<uint32_t>(std::max_element(blockTicks, blockTicks + kNumStages) - blockTicks);
+    }
+
+   /**
+      Write running averages and peaks (in percent of the block duration) to @a outAverages and @a outPeaks,
+      kNumResults values each, then start a new peak window. Realtime safe.
+    */
+    void publish(float* const outAverages, float* const outPeaks) noexcept
+    {
+        const uint64_t tick = readCounter();
+        const uint64_t time = getCurrentTime();
+
+        if (lastCalibrationTime != 0 && time > lastCalibrationTime)
+            ticksPerSecond = static_cast<double>(tick - lastCalibrationTick) * 1e9 / (time - lastCalibrationTime);
+
+        lastCalibrationTick = tick;
+        lastCalibrationTime = time;
+
+        if (ticksPerSecond > 0.0 && windowFrames != 0)
+        {
+            const double scale = 100.0 * sampleRate / (ticksPerSecond * windowFrames);
+            double total = 0.0;
+
+            for (uint32_t i = 0; i < kNumStages; ++i)
+            {
+                const double load = windowTicks[i] * scale;
+                averages[i] += (static_cast<float>(load) - averages[i]) * kAverageWeight;
+                total += load;
+            }
+
+            averages[kNumStages] += (static_cast<float>(total) - averages[kNumStages]) * kAverageWeight;
+        }
+
+        std::copy(averages, averages + kNumResults, outAverages);
+        std::copy(peaks, peaks + kNumResults, outPeaks);
+
+        std::fill(windowTicks, windowTicks + kNumStages, 0);
+        std::fill(peaks, peaks + kNumResults, 0.f);
+        windowFrames = 0;
+    }
+
+private:
+    // weight of each publish window in the running averages
+    static constexpr const float kAverageWeight = 0.2f;
+
+    double sampleRate = 48000.0;
+    double ticksPerSecond = 0.0;
+    uint64_t lastTick = 0;
+    uint64_t lastCalibrationTick = 0;
+    uint64_t lastCalibrationTime = 0;
+    uint64_t blockTicks[kNumStages] = {};
+    uint64_t windowTicks[kNumStages] = {};
+    uint32_t windowFrames = 0;
+    float averages[kNumResults] = {};
+    float peaks[kNumResults] = {};
+
+    static uint64_t getCurrentTime() noexcept
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static inline uint64_t readCounter() noexcept
+    {
+       #if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+       #elif defined(__aarch64__)
+        uint64_t value;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+       #else
+        return getCurrentTime();
+       #endif
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(StageProfiler)
+};
+#else
+// --------------------------------------------------------------------------------------------------------------------
+// Profiling turned off at build time, same API doing nothing
+
+template <uint32_t kNumStages>
+class StageProfiler
+{
+public:
+    static constexpr const uint32_t kNumResults = kNumStages + 1;
+
+    StageProfiler() noexcept {}
+    void setSampleRate(double) noexcept {}
+    void reset() noexcept {}
+    void begin() noexcept {}
+    void mark(uint32_t) noexcept {}
+    void end(uint32_t, uint32_t) noexcept {}
+    uint32_t getSlowestStage() const noexcept { return kNumStages; }
+    void publish(float*, float*) noexcept {}
+
+    DISTRHO_DECLARE_NON_COPYABLE(StageProfiler)
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,240 @@
+/*
+ * AIDA-X trace recorder
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// begin and end events of the audio, worker, loader and UI threads, turned on at build time
+#ifndef AIDAX_WITH_TRACING
+# define AIDAX_WITH_TRACING 0
+#endif
+
+START_NAMESPACE_DISTRHO
+
+#if AIDAX_WITH_TRACING
+// --------------------------------------------------------------------------------------------------------------------
+// Records begin and end events of named sections per thread, for looking at how threads interact (tail waits, loader
+// contention and the like) in a trace viewer such as Perfetto or chrome://tracing.
+// Each thread writes to its own ring of the most recent events, claimed on its first event out of a fixed set
+// allocated up front, so recording never locks nor allocates. Names must be string literals.
+
+struct TraceEvent {
+    uint64_t time;
+    const char* name; // null for end events
+};
+
+template <uint32_t kNumEvents>
+struct TraceRing {
+    std::atomic<uint64_t> writeIndex { 0 };
+    std::atomic<const char*> threadName { nullptr };
+    TraceEvent events[kNumEvents] = {};
+};
+
+class TraceRecorder
+{
+public:
+    static constexpr const uint32_t kMaxThreads = 32;
+    static constexpr const uint32_t kNumEvents = 8192;
+
+    // Realtime safe.
+    static void begin(const char* const name) noexcept
+    {
+        record(name);
+    }
+
+    // Realtime safe, ends the last section begun on this thread.
+    static void end() noexcept
+    {
+        record(nullptr);
+    }
+
+    // Name shown for the calling thread, a string literal. Realtime safe.
+    static void setThreadName(const char* const name) noexcept
+    {
+        if (Ring* const ring = getThreadRing())
+            ring->threadName.store(name, std::memory_order_release);
+    }
+
+   /**
+      Write the events of all threads to @a filename in the Chrome trace event format.
+      Can be called while recording goes on, events being overwritten at the time are left out.
+    */
+    static bool writeChromeTrace(const char* const filename)
+    {
+        FILE* const fd = std::fopen(filename, "w");
+        DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr, false);
+
+        const uint32_t numRings = std::min(numClaimedRings.load(std::memory_order_acquire), kMaxThreads);
+        std::vector<Event> events;
+        uint64_t startTime = UINT64_MAX;
+
+        std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", fd);
+
+        // times relative to the first event in the trace
+        for (uint32_t r = 0; r < numRings; ++r)
+        {
+            copyEvents(rings[r], events);
+
+            if (! events.empty())
+                startTime = std::min(startTime, events.front().time);
+        }
+
+        bool first = true;
+
+        for (uint32_t r = 0; r < numRings; ++r)
+        {
+            const uint32_t tid = r + 1;
+
+            if (const char* const threadName = rings[r].threadName.load(std::memory_order_acquire))
+            {
+                std::fprintf(fd, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                             first ? "" : ",\n", tid, threadName);
+                first = false;
+            }
+
+            copyEvents(rings[r], events);
+
+            // sections that started before the oldest event kept are left out
+            uint32_t depth = 0;
+
+            for (const Event& event : events)
+            {
+                if (event.name == nullptr && depth == 0)
+                    continue;
+
+                const double ts = static_cast<double>(event.time - std::min(startTime, event.time)) / 1e3;
+
+                if (event.name != nullptr)
+                {
+                    std::fprintf(fd, "%s{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                                 first ? "" : ",\n", event.name, tid, ts);
+                    ++depth;
+                }
+                else
+                {
+                    std::fprintf(fd, "%s{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                                 first ? "" : ",\n", tid, ts);
+                    --depth;
+                }
+
+                first = false;
+            }
+        }
+
+        std::fputs("\n]}\n", fd);
+        return std::fclose(fd) == 0;
+    }
+
+private:
+    typedef TraceEvent Event;
+    typedef TraceRing<kNumEvents> Ring;
+
+    // zero initialized, no allocations nor locks for any thread
+    static inline Ring rings[kMaxThreads];
+    static inline std::atomic<uint32_t> numClaimedRings { 0 };
+    static inline thread_local Ring* threadRing = nullptr;
+    static inline thread_local bool threadRingClaimed = false;
+
+    static Ring* getThreadRing() noexcept
+    {
+        if (! threadRingClaimed)
+        {
+            threadRingClaimed = true;
+
+            // threads beyond the maximum are not recorded
+            const uint32_t index = numClaimedRings.fetch_add(1, std::memory_order_acq_rel);
+
+            if (index < kMaxThreads)
+                threadRing = &rings[index];
+        }
+
+        return threadRing;
+    }
+
+    static void record(const char* const name) noexcept
+    {
+        Ring* const ring = getThreadRing();
+
+        if (ring == nullptr)
+            return;
+
+        const uint64_t index = ring->writeIndex.load(std::memory_order_relaxed);
+        Event& event(ring->events[index % kNumEvents]);
+
+        event.time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        event.name = name;
+
+        ring->writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    // events still in the ring, oldest first
+    static void copyEvents(const Ring& ring, std::vector<Event>& events)
+    {
+        const uint64_t end = ring.writeIndex.load(std::memory_order_acquire);
+        const uint64_t start = end > kNumEvents ? end - kNumEvents : 0;
+
+        events.clear();
+
+        for (uint64_t i = start; i < end; ++i)
+            events.push_back(ring.events[i % kNumEvents]);
+
+        // the writer may have wrapped around onto the first ones while copying, including the one it writes now
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t valid = ring.writeIndex.load(std::memory_order_relaxed) + 1;
+
+        if (valid > kNumEvents && valid - kNumEvents > start)
+            events.erase(events.begin(), events.begin() + std::min<uint64_t>(valid - kNumEvents - start, events.size()));
+    }
+};
+#else
+// --------------------------------------------------------------------------------------------------------------------
+// Tracing turned off at build time, same API doing nothing
+
+class TraceRecorder
+{
+public:
+    static void begin(const char*) noexcept {}
+    static void end() noexcept {}
+    static void setThreadName(const char*) noexcept {}
+
+    static bool writeChromeTrace(const char*)
+    {
+        d_stderr("Tracing is not available in this build");
+        return false;
+    }
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// Traces the scope it lives in
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* const name) noexcept
+    {
+        TraceRecorder::begin(name);
+    }
+
+    ~TraceScope() noexcept
+    {
+        TraceRecorder::end();
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(TraceScope)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
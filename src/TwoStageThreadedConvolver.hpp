@@ -7,117 +7,1073 @@
 #pragma once
 
 #ifndef DISTRHO_OS_WASM
-# include "Semaphore.hpp"
-# include "extra/ScopedPointer.hpp"
-# include "extra/Thread.hpp"
+# include "ConvolverWorkerPool.hpp"
 #endif
 
-#include "TwoStageFFTConvolver.h"
+#include "PartitionedConvolver.hpp"
+#include "TraceRecorder.hpp"
+
+#include <cmath>
+#include <memory>
 
 START_NAMESPACE_DISTRHO
 
+// --------------------------------------------------------------------------------------------------------------------
+// ready-to-use impulse response, time-domain samples plus frequency-domain partitions for both stages
+// the payload is a single block of floats so it can be stored on disk and memory-mapped back as-is
+
+struct ConvolverImpulse {
+    uint32_t irLength = 0;
+    uint32_t headLength = 0;
+    const float* ir = nullptr;
+    ConvolverSpectrum head;
+    ConvolverSpectrum tail;
+    std::shared_ptr<const void> storage;
+
+    static uint32_t getIrFloats(const uint32_t irLength) noexcept
+    {
+        // keep spectra aligned after the time-domain samples
+        return (irLength + 15) & ~15u;
+    }
+
+    static size_t getPayloadFloats(const uint32_t irLength, const uint32_t headLength,
+                                   const uint32_t headBlockSize, const uint32_t tailBlockSize) noexcept
+    {
+        return static_cast<size_t>(getIrFloats(irLength))
+             + ConvolverSpectrum::getNumFloats(headBlockSize, std::min(irLength, headLength))
+             + (irLength > headLength ? ConvolverSpectrum::getNumFloats(tailBlockSize, irLength - headLength) : 0);
+    }
+
+   /**
+      Point to an already computed payload, as created by compute().
+    */
+    bool assign(const float* const payload, const uint32_t newIrLength, const uint32_t newHeadLength,
+                const uint32_t headBlockSize, const uint32_t tailBlockSize) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(newIrLength != 0, false);
+
+        irLength = newIrLength;
+        headLength = newHeadLength;
+        ir = payload;
+
+        const uint32_t headIrLen = std::min(irLength, headLength);
+        head.blockSize = headBlockSize;
+        head.spectrumSize = ConvolverFFT::getSpectrumSize(headBlockSize * 2);
+        head.numPartitions = ConvolverSpectrum::getNumPartitions(headBlockSize, headIrLen);
+        head.data = payload + getIrFloats(irLength);
+
+        tail = ConvolverSpectrum();
+
+        if (irLength > headLength)
+        {
+            tail.blockSize = tailBlockSize;
+            tail.spectrumSize = ConvolverFFT::getSpectrumSize(tailBlockSize * 2);
+            tail.numPartitions = ConvolverSpectrum::getNumPartitions(tailBlockSize, irLength - headLength);
+            tail.data = head.data + ConvolverSpectrum::getNumFloats(headBlockSize, headIrLen);
+        }
+
+        return true;
+    }
+
+   /**
+      Fill @a payload (of getPayloadFloats() size) from a time-domain impulse response.
+    */
+    void compute(float* const payload, const float* const newIr, const uint32_t newIrLength, const uint32_t newHeadLength,
+                 const uint32_t headBlockSize, const uint32_t tailBlockSize)
+    {
+        std::memcpy(payload, newIr, sizeof(float) * newIrLength);
+
+        irLength = newIrLength;
+        headLength = newHeadLength;
+        ir = payload;
+
+        float* const headData = payload + getIrFloats(irLength);
+        head.compute(headData, headBlockSize, newIr, std::min(irLength, headLength));
+
+        tail = ConvolverSpectrum();
+
+        if (irLength > headLength)
+        {
+            float* const tailData = headData + ConvolverSpectrum::getNumFloats(headBlockSize, headLength);
+            tail.compute(tailData, tailBlockSize, newIr + headLength, irLength - headLength);
+        }
+    }
+};
+
 // --------------------------------------------------------------------------------------------------------------------
 
 #ifndef DISTRHO_OS_WASM
-class TwoStageThreadedConvolver : public fftconvolver::TwoStageFFTConvolver,
-                                  private Thread
+class TwoStageThreadedConvolver
 {
-    static constexpr const size_t kHeadBlockSize = 128;
-    static constexpr const size_t kTailBlockSize = 1024;
+public:
+    static constexpr const uint32_t kHeadBlockSize = 128;
+    static constexpr const uint32_t kTailBlockSize = 1024;
+    // the head stage covers the first 2 tail blocks, giving the tail stage 1 full tail block to run in background
+    static constexpr const uint32_t kHeadLength = kTailBlockSize * 2;
+    // impulses that can be blended together, see setWeights()
+    static constexpr const uint32_t kMaxImpulses = ConvolverSpectrumMixer::kMaxSources;
+    // maximum weight change per head block, so blend changes are smoothed over ~20 head blocks
+    static constexpr const float kWeightStep = 0.05f;
+    // input history kept by the tail stage, impulses up to this long (plus head) can be changed in place
+    static constexpr const uint32_t kMinTailHistoryLength = kTailBlockSize * 64;
+    // crossfade length of in-place impulse changes, see setImpulses(), both stages fade over 2048 samples
+    static constexpr const uint32_t kHeadFadeBlocks = 16;
+    static constexpr const uint32_t kTailFadeBlocks = 2;
+
+    struct Stats {
+        // tail results that finished after their deadline, and by how much
+        uint32_t numLateBlocks;
+        uint64_t totalLateTime;
+        uint64_t maxLateTime;
+        // times the audio thread had to wait for the tail stage, even after running queued work itself
+        uint32_t numStalls;
+    };
+
+private:
+    // tail blocks submitted to the background worker on top of those waiting to be played
+    static constexpr const uint32_t kNumSpareTailSlots = 4;
+    // impulse changes waiting for their output to be reported, see getLastImpulseChange()
+    static constexpr const uint32_t kMaxPendingChanges = 4;
+
+    // impulses in use together with their mixed spectra, swapped as a whole by setImpulses()
+    struct ImpulseSet {
+        std::shared_ptr<const ConvolverImpulse> impulses[kMaxImpulses];
+        ConvolverSpectrumMixer headMixer;
+        ConvolverSpectrumMixer tailMixer;
+        uint32_t headLength = 0;
+        // as given to setImpulses()
+        uint32_t tag = 0;
+        bool crossfade = true;
+    };
+
+    struct TailSlot {
+        ConvolverBuffer input;
+        ConvolverBuffer output;
+        uint64_t deadline = 0;
+        float weights[kMaxImpulses] = {};
+        ImpulseSet* impulseSet = nullptr;
+    };
 
-    ScopedPointer<fftconvolver::FFTConvolver> nonThreadedConvolver;
-    Semaphore semBgProcStart;
-    Semaphore semBgProcFinished;
+    struct ImpulseChange {
+        uint64_t frame;
+        uint32_t tag;
+    };
+
+    // owned by the audio thread, apart from the initial setup
+    ImpulseSet* impulseSet = nullptr;
+    ImpulseSet* fadingImpulseSet = nullptr;
+    uint32_t fadingLastTailBlock = 0;
+    // owned by the tail stage
+    ImpulseSet* tailImpulseSet = nullptr;
+    ImpulseSet* tailFadingImpulseSet = nullptr;
+    // handoff between setImpulses() and the audio thread
+    std::atomic<ImpulseSet*> pendingImpulseSet { nullptr };
+    std::atomic<ImpulseSet*> retiredImpulseSet { nullptr };
+    // held back by prepareImpulses() until applyImpulses()
+    std::atomic<ImpulseSet*> preparedImpulseSet { nullptr };
+    std::atomic<bool> changingImpulses { false };
+    // where the last process() call output the switch to new impulses, which the head stage did latency frames before
+    int32_t lastImpulseChange = -1;
+    uint32_t lastImpulseTag = 0;
+    ImpulseChange pendingChanges[kMaxPendingChanges];
+    uint32_t numPendingChanges = 0;
+    // changes without crossfade start with the tail stage, the head stage switches once the first tail results
+    // with the new impulses play, so that both switch on the same sample
+    ImpulseSet* deferredImpulseSet = nullptr;
+    uint64_t deferredSwitchFrame = 0;
+    uint32_t tailSwitchBlock = 0;
+    bool tailSwitching = false;
+    uint64_t processedFrames = 0;
+
+    PartitionedConvolver headConvolver;
+    PartitionedConvolver tailConvolver;
+    float headWeights[kMaxImpulses] = {};
+    float targetWeights[kMaxImpulses] = {};
+    std::unique_ptr<TailSlot[]> tailSlots;
+    uint32_t numTailSlots = 0;
+    ConvolverBuffer tailSilence;
+    const float* tailPrecalculated = nullptr;
+    uint32_t tailInputFill = 0;
+    uint32_t tailDelay = 0;
+    // tail blocks between submitting a block and playing its result
+    uint32_t resultDelay = 0;
+    // results of blocks before this one are not played, they belong to input from before the last restart
+    uint32_t tailResumeBlock = 0;
+    bool delayedOutput = false;
+    uint32_t maxBlockSize = kTailBlockSize;
+    uint64_t tailPeriod = 0;
+    std::atomic<uint32_t> tailSubmitted { 0 };
+    std::atomic<uint32_t> tailCompleted { 0 };
+    ConvolverWorkerPool* workerPool = nullptr;
+    ConvolverWorkerJob workerJob;
+
+    // output delay of the delayed output mode, see getLatency()
+    uint32_t latency = 0;
+    uint32_t latencyPos = 0;
+    ConvolverBuffer latencyBuffer;
+
+    std::atomic<uint32_t> numLateBlocks { 0 };
+    std::atomic<uint64_t> totalLateTime { 0 };
+    std::atomic<uint64_t> maxLateTime { 0 };
+    std::atomic<uint32_t> numStalls { 0 };
 
 public:
     TwoStageThreadedConvolver()
-        : fftconvolver::TwoStageFFTConvolver(),
-          Thread("TwoStageThreadedConvolver"),
-          semBgProcStart(1),
-          semBgProcFinished(0)
+        : workerJob(backgroundProcessingCallback, this)
     {
+        setSampleRate(48000.0);
     }
 
-    ~TwoStageThreadedConvolver() override
+    ~TwoStageThreadedConvolver()
     {
-        if (nonThreadedConvolver != nullptr)
+        if (workerPool != nullptr)
         {
-            nonThreadedConvolver = nullptr;
-            return;
+            workerPool->unregisterJob(&workerJob);
+            ConvolverWorkerPool::release();
         }
 
-        signalThreadShouldExit();
-        semBgProcStart.post();
-        stopThread(5000);
+        deleteImpulseSets();
+    }
+
+   /**
+      Set the sample rate used to derive the tail job deadlines, does not affect the convolution itself.
+    */
+    void setSampleRate(const double sampleRate) noexcept
+    {
+        tailPeriod = static_cast<uint64_t>(kTailBlockSize * 1e9 / sampleRate);
+    }
+
+   /**
+      Set if the output is delayed, off by default. Must be called before init().
+      The delay, see getLatency(), gives the tail stage that much extra time to run in background before the audio
+      thread needs its result. A result still not ready is waited for either way, so apart from the delay
+      the output is exactly the same.
+    */
+    void setDelayedOutput(const bool newDelayedOutput) noexcept
+    {
+        delayedOutput = newDelayedOutput;
+    }
+
+   /**
+      Set the maximum number of frames given to each process() call. Must be called before init().
+    */
+    void setMaxBlockSize(const uint32_t newMaxBlockSize) noexcept
+    {
+        maxBlockSize = newMaxBlockSize;
+    }
+
+   /**
+      Get the output delay of the delayed output mode for a maximum process() size, in frames.
+      A whole number of tail blocks, enough that no tail result is needed within the process() call that submits it.
+    */
+    static uint32_t getDelayedOutputLatency(const uint32_t maxBlockSize) noexcept
+    {
+        return kTailBlockSize * std::max(1u, (maxBlockSize + kTailBlockSize - 1) / kTailBlockSize);
+    }
+
+   /**
+      Get the output delay in frames, as set up by init().
+    */
+    uint32_t getLatency() const noexcept
+    {
+        return latency;
+    }
+
+    static std::shared_ptr<const ConvolverImpulse> createImpulse(const float* const ir, const uint32_t irLen,
+                                                                 const uint32_t headLength = kHeadLength)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(irLen != 0, nullptr);
+        DISTRHO_SAFE_ASSERT_RETURN(headLength == kHeadLength, nullptr);
+
+        std::shared_ptr<ConvolverBuffer> payload = std::make_shared<ConvolverBuffer>(
+            ConvolverImpulse::getPayloadFloats(irLen, headLength, kHeadBlockSize, kTailBlockSize));
+
+        std::shared_ptr<ConvolverImpulse> newImpulse = std::make_shared<ConvolverImpulse>();
+        newImpulse->compute(payload->data(), ir, irLen, headLength, kHeadBlockSize, kTailBlockSize);
+        newImpulse->storage = payload;
+        return newImpulse;
     }
 
     bool init(const fftconvolver::Sample* const ir, const size_t irLen)
     {
-        if (fftconvolver::TwoStageFFTConvolver::init(kHeadBlockSize, kTailBlockSize, ir, irLen))
+        const std::shared_ptr<const ConvolverImpulse> newImpulse = createImpulse(ir, static_cast<uint32_t>(irLen));
+        return newImpulse != nullptr && init(newImpulse);
+    }
+
+   /**
+      Initialize from a ready impulse.
+    */
+    bool init(const std::shared_ptr<const ConvolverImpulse>& newImpulse)
+    {
+        return init(&newImpulse, 1);
+    }
+
+   /**
+      Initialize from up to kMaxImpulses ready impulses, which are blended together according to @a weights.
+      Null entries are allowed and act as silent impulses.
+      All impulses share the same input spectra, each extra impulse only costs a spectrum mix when weights change.
+    */
+    bool init(const std::shared_ptr<const ConvolverImpulse>* const newImpulses, const uint32_t numImpulses,
+              const float* const weights = nullptr)
+    {
+        ImpulseSet* const newImpulseSet = createImpulseSet(newImpulses, numImpulses);
+        DISTRHO_SAFE_ASSERT_RETURN(newImpulseSet != nullptr, false);
+
+        deleteImpulseSets();
+        impulseSet = tailImpulseSet = newImpulseSet;
+
+        for (uint32_t i = 0; i < kMaxImpulses; ++i)
+            headWeights[i] = targetWeights[i] = i < numImpulses ? (weights != nullptr ? weights[i] : 1.f) : 0.f;
+
+        impulseSet->headMixer.update(headWeights);
+        impulseSet->tailMixer.update(headWeights);
+
+        // room for the full head, so that any shorter impulse can replace this one in place
+        if (! headConvolver.init(impulseSet->headMixer.getSpectrum(), kHeadLength / kHeadBlockSize))
+            return false;
+
+        // applies to the head stage as well, so that the delay does not depend on the impulse length
+        latency = delayedOutput ? getDelayedOutputLatency(maxBlockSize) : 0;
+        latencyPos = 0;
+        numPendingChanges = 0;
+
+        if (latency != 0)
         {
-            startThread(true);
-            return true;
+            latencyBuffer.resize(latency);
+            latencyBuffer.clear();
+        }
+
+        if (impulseSet->tailMixer.getSpectrum().numPartitions != 0)
+        {
+            // the worker must be done with the previous slots and tail convolver
+            if (workerPool != nullptr)
+                workerPool->wait(workerJob);
+
+            if (! tailConvolver.init(impulseSet->tailMixer.getSpectrum(), kMinTailHistoryLength / kTailBlockSize))
+                return false;
+
+            tailInputFill = 0;
+            tailDelay = impulseSet->headLength / kTailBlockSize;
+            resultDelay = tailDelay - 1 + latency / kTailBlockSize;
+
+            // a slot is reused once the result of its last block has played
+            numTailSlots = resultDelay + 1 + kNumSpareTailSlots;
+            tailSlots.reset(new TailSlot[numTailSlots]);
+
+            for (uint32_t i = 0; i < numTailSlots; ++i)
+            {
+                tailSlots[i].input.resize(kTailBlockSize);
+                tailSlots[i].output.resize(kTailBlockSize);
+                tailSlots[i].impulseSet = impulseSet;
+            }
+
+            tailSilence.resize(kTailBlockSize);
+            tailPrecalculated = tailSilence.data();
+            tailSubmitted = tailCompleted = 0;
+            tailResumeBlock = 0;
+
+            if (workerPool == nullptr)
+            {
+                workerPool = ConvolverWorkerPool::acquire();
+                workerPool->registerJob(&workerJob);
+            }
         }
 
-        ScopedPointer<fftconvolver::FFTConvolver> conv(new fftconvolver::FFTConvolver);
+        return true;
+    }
+
+   /**
+      Replace the impulses while processing, crossfading from the current ones.
+      The input history of both stages is kept and convolved against the old and new impulses during the fade,
+      so the change has no gap and costs no new convolver or worker job.
+      Weights given to setWeights() keep applying per index.
+      Meant to be called from a non-realtime thread, the change starts on the next head block processed.
+      Returns false if the change can't be done in place, a new convolver must be created instead then.
+      That is the case for a different head length, a tail stage appearing or longer than the input history,
+      or a previous change not fully faded yet.
+      Without @a crossfade the new impulses take over at once, for impulses that sound the same as the current
+      ones given the processing around the convolver, see getLastImpulseChange().
+      Such a change is exact, as if the new impulses had always been used, but takes effect a few tail blocks
+      after the next head block.
+      @a tag is reported back by getLastImpulseChange().
+    */
+    bool setImpulses(const std::shared_ptr<const ConvolverImpulse>* const newImpulses, const uint32_t numImpulses,
+                     const uint32_t tag = 0, const bool crossfade = true)
+    {
+        if (! prepareImpulses(newImpulses, numImpulses, tag, crossfade))
+            return false;
+
+        applyImpulses();
+        return true;
+    }
+
+   /**
+      Same as setImpulses(), except that the change is held back until applyImpulses() is called.
+      Lets convolvers running in lockstep, such as both channels of linked stereo, take over new impulses on the same
+      block: all of them are prepared, then applied together from the audio thread, or all cancelled if one failed.
+    */
+    bool prepareImpulses(const std::shared_ptr<const ConvolverImpulse>* const newImpulses, const uint32_t numImpulses,
+                         const uint32_t tag = 0, const bool crossfade = true)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(impulseSet != nullptr, false);
+
+        if (changingImpulses.load(std::memory_order_acquire))
+            return false;
 
-        if (conv->init(kHeadBlockSize, ir, irLen))
+        // impulses replaced by the last change, no longer used by any stage
+        delete retiredImpulseSet.exchange(nullptr, std::memory_order_acquire);
+
+        ImpulseSet* const newImpulseSet = createImpulseSet(newImpulses, numImpulses);
+        DISTRHO_SAFE_ASSERT_RETURN(newImpulseSet != nullptr, false);
+
+        const uint32_t numTailPartitions = newImpulseSet->tailMixer.getSpectrum().numPartitions;
+
+        if (newImpulseSet->headLength != impulseSet->headLength ||
+            (numTailPartitions != 0 && (tailPrecalculated == nullptr || numTailPartitions > tailConvolver.getCapacity())))
         {
-            nonThreadedConvolver = conv.release();
-            return true;
+            delete newImpulseSet;
+            return false;
         }
 
-        return false;
+        newImpulseSet->tag = tag;
+        newImpulseSet->crossfade = crossfade;
+
+        changingImpulses.store(true, std::memory_order_relaxed);
+        preparedImpulseSet.store(newImpulseSet, std::memory_order_release);
+        return true;
+    }
+
+   /**
+      Start the change held back by prepareImpulses(), if any. Realtime safe.
+    */
+    void applyImpulses() noexcept
+    {
+        if (ImpulseSet* const newImpulseSet = preparedImpulseSet.exchange(nullptr, std::memory_order_acq_rel))
+            pendingImpulseSet.store(newImpulseSet, std::memory_order_release);
+    }
+
+   /**
+      Drop the change held back by prepareImpulses(), unless already applied.
+      Meant to be called from the thread that prepared it, before handing it over to the audio thread.
+    */
+    void cancelImpulses()
+    {
+        if (ImpulseSet* const newImpulseSet = preparedImpulseSet.exchange(nullptr, std::memory_order_acquire))
+        {
+            delete newImpulseSet;
+            changingImpulses.store(false, std::memory_order_release);
+        }
+    }
+
+   /**
+      Check if an impulse change given to setImpulses() is still pending or fading.
+    */
+    bool isChangingImpulses() const noexcept
+    {
+        return changingImpulses.load(std::memory_order_acquire);
+    }
+
+   /**
+      Get the sample offset within the output of the last process() call at which impulses given to setImpulses()
+      took over, or -1 if that did not happen. Their tag is written to @a tag.
+      Crossfades start at that offset in the head stage and a few tail blocks later in the tail stage,
+      changes without crossfade apply to both stages at that offset.
+      With a latency the head stage switched that many frames earlier, the offset is where the output has it.
+    */
+    int32_t getLastImpulseChange(uint32_t& tag) const noexcept
+    {
+        tag = lastImpulseTag;
+        return lastImpulseChange;
+    }
+
+   /**
+      Set the blend weights of each impulse, as given in init(). Changes are smoothed.
+      Has no effect if only a single impulse was given.
+    */
+    void setWeights(const float* const weights) noexcept
+    {
+        std::memcpy(targetWeights, weights, sizeof(targetWeights));
+    }
+
+   /**
+      Clear the input history and any pending tail results, as if no audio was processed before.
+      Meant to be called from the audio thread, for resuming after processing was skipped for a while.
+      The last tail block submitted is waited for, by then the worker usually had plenty of time for it.
+    */
+    void reset()
+    {
+        if (tailPrecalculated != nullptr)
+        {
+            // let the tail stage finish first, nothing is pending afterwards
+            const uint32_t lastBlock = tailSubmitted.load(std::memory_order_relaxed) - 1;
+
+            if (! isTailBlockCompleted(lastBlock))
+                waitForTailBlock(lastBlock);
+
+            restartTailStage();
+
+            tailPrecalculated = tailSilence.data();
+            tailInputFill = 0;
+        }
+
+        if (latency != 0)
+        {
+            latencyBuffer.clear();
+            latencyPos = 0;
+        }
+
+        // with the history cleared both stages can take a deferred change on the next head block
+        if (deferredImpulseSet != nullptr)
+        {
+            tailSwitchBlock = tailSubmitted.load(std::memory_order_relaxed);
+            fadingLastTailBlock = tailSwitchBlock - 1;
+            deferredSwitchFrame = processedFrames;
+        }
+
+        headConvolver.reset();
+    }
+
+    void getStats(Stats& stats) const noexcept
+    {
+        stats.numLateBlocks = numLateBlocks.load(std::memory_order_relaxed);
+        stats.totalLateTime = totalLateTime.load(std::memory_order_relaxed);
+        stats.maxLateTime = maxLateTime.load(std::memory_order_relaxed);
+        stats.numStalls = numStalls.load(std::memory_order_relaxed);
     }
 
     void process(const fftconvolver::Sample* const input, fftconvolver::Sample* const output, const size_t len)
     {
-        if (nonThreadedConvolver != nullptr)
-            nonThreadedConvolver->process(input, output, len);
-        else
-            fftconvolver::TwoStageFFTConvolver::process(input, output, len);
+        for (uint32_t processed = 0; processed < len;)
+        {
+            if (headConvolver.getInputFill() == 0)
+            {
+                if (updateImpulseSet(processed) && numPendingChanges != kMaxPendingChanges)
+                    pendingChanges[numPendingChanges++] = { processedFrames + processed + latency, impulseSet->tag };
+
+                updateHeadWeights();
+            }
+
+            const uint32_t processing = std::min(static_cast<uint32_t>(len) - processed,
+                                                 kHeadBlockSize - headConvolver.getInputFill());
+
+            headConvolver.process(input + processed, output + processed, processing);
+            processed += processing;
+        }
+
+        updateLastImpulseChange(static_cast<uint32_t>(len));
+        processedFrames += len;
+
+        // a whole number of tail blocks, the tail stage below keeps the same alignment
+        if (latency != 0)
+            delayOutput(output, static_cast<uint32_t>(len));
+
+        if (tailPrecalculated == nullptr)
+            return;
+
+        for (uint32_t processed = 0; processed < len;)
+        {
+            const uint32_t processing = std::min(static_cast<uint32_t>(len) - processed, kTailBlockSize - tailInputFill);
+            const uint32_t block = tailSubmitted.load(std::memory_order_relaxed);
+
+            // tail block computed in background during the previous periods
+            fftconvolver::Sum(output + processed,
+                              output + processed,
+                              tailPrecalculated + tailInputFill,
+                              processing);
+
+            std::memcpy(tailSlots[block % numTailSlots].input.data() + tailInputFill,
+                        input + processed,
+                        sizeof(float) * processing);
+
+            tailInputFill += processing;
+
+            if (tailInputFill == kTailBlockSize)
+            {
+                submitTailBlock(block);
+                tailInputFill = 0;
+            }
+
+            processed += processing;
+        }
     }
 
 protected:
-    void startBackgroundProcessing() override
+    static ImpulseSet* createImpulseSet(const std::shared_ptr<const ConvolverImpulse>* const newImpulses,
+                                        const uint32_t numImpulses)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numImpulses != 0 && numImpulses <= kMaxImpulses, nullptr);
+
+        ConvolverSpectrum heads[kMaxImpulses];
+        ConvolverSpectrum tails[kMaxImpulses];
+        uint32_t headLength = 0;
+        uint32_t numUsedImpulses = 0;
+
+        for (uint32_t i = 0; i < numImpulses; ++i)
+        {
+            const std::shared_ptr<const ConvolverImpulse>& newImpulse(newImpulses[i]);
+
+            if (newImpulse == nullptr)
+                continue;
+
+            DISTRHO_SAFE_ASSERT_RETURN(newImpulse->head.blockSize == kHeadBlockSize, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(newImpulse->headLength == kHeadLength, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(headLength == 0 || newImpulse->headLength == headLength, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(newImpulse->tail.numPartitions == 0 ||
+                                       newImpulse->tail.blockSize == kTailBlockSize, nullptr);
+
+            heads[i] = newImpulse->head;
+            tails[i] = newImpulse->tail;
+            headLength = newImpulse->headLength;
+            ++numUsedImpulses;
+        }
+
+        DISTRHO_SAFE_ASSERT_RETURN(numUsedImpulses != 0, nullptr);
+
+        ImpulseSet* const newImpulseSet = new ImpulseSet();
+        newImpulseSet->headLength = headLength;
+
+        for (uint32_t i = 0; i < numImpulses; ++i)
+            newImpulseSet->impulses[i] = newImpulses[i];
+
+        // a single impulse is used directly, without any weighting
+        const bool weighted = numImpulses > 1;
+
+        if (! newImpulseSet->headMixer.init(heads, numImpulses, weighted) ||
+            ! newImpulseSet->tailMixer.init(tails, numImpulses, weighted))
+        {
+            delete newImpulseSet;
+            return nullptr;
+        }
+
+        return newImpulseSet;
+    }
+
+    void deleteImpulseSets()
+    {
+        delete deferredImpulseSet;
+        deferredImpulseSet = nullptr;
+        tailSwitching = false;
+
+        delete fadingImpulseSet;
+        delete impulseSet;
+        delete pendingImpulseSet.exchange(nullptr);
+        delete retiredImpulseSet.exchange(nullptr);
+        delete preparedImpulseSet.exchange(nullptr);
+
+        impulseSet = fadingImpulseSet = tailImpulseSet = tailFadingImpulseSet = nullptr;
+        changingImpulses = false;
+    }
+
+    // called on head block boundaries, @a offset samples into the current process() call.
+    // starts and finishes in-place impulse changes, returns true if the head stage just switched to new impulses
+    bool updateImpulseSet(const uint32_t offset)
+    {
+        if (deferredImpulseSet != nullptr)
+        {
+            if (processedFrames + offset < deferredSwitchFrame)
+                return false;
+
+            fadingImpulseSet = impulseSet;
+            impulseSet = deferredImpulseSet;
+            deferredImpulseSet = nullptr;
+            impulseSet->headMixer.update(headWeights);
+            headConvolver.fadeTo(impulseSet->headMixer.getSpectrum(), 0);
+            return true;
+        }
+
+        if (fadingImpulseSet != nullptr)
+        {
+            // the old impulses are released once neither stage uses them anymore
+            if (headConvolver.isFading())
+                return false;
+            if (tailPrecalculated != nullptr && ! isTailBlockCompleted(fadingLastTailBlock))
+                return false;
+
+            retiredImpulseSet.store(fadingImpulseSet, std::memory_order_release);
+            changingImpulses.store(false, std::memory_order_release);
+            fadingImpulseSet = nullptr;
+            tailSwitching = false;
+            return false;
+        }
+
+        ImpulseSet* const newImpulseSet = pendingImpulseSet.exchange(nullptr, std::memory_order_acquire);
+
+        if (newImpulseSet == nullptr)
+            return false;
+
+        if (! newImpulseSet->crossfade && tailPrecalculated != nullptr)
+        {
+            // the tail process() loop runs after this one, tail counters are still at the start of the call
+            const uint32_t tailFill = (tailInputFill + offset) % kTailBlockSize;
+
+            // the tail block being filled is the first one to use the new impulses, its results play
+            // tailDelay blocks after it started, which is when the head stage follows
+            tailSwitchBlock = tailSubmitted.load(std::memory_order_relaxed) + (tailInputFill + offset) / kTailBlockSize;
+            tailSwitching = true;
+            fadingLastTailBlock = tailSwitchBlock - 1;
+            deferredSwitchFrame = processedFrames + offset - tailFill + tailDelay * kTailBlockSize;
+            deferredImpulseSet = newImpulseSet;
+            return false;
+        }
+
+        fadingImpulseSet = impulseSet;
+        impulseSet = newImpulseSet;
+        impulseSet->headMixer.update(headWeights);
+        headConvolver.fadeTo(impulseSet->headMixer.getSpectrum(), impulseSet->crossfade ? kHeadFadeBlocks : 0);
+
+        // the tail block being filled is the first one to use the new impulses,
+        // without a crossfade the old ones are done after the last block submitted so far
+        fadingLastTailBlock = tailSubmitted.load(std::memory_order_relaxed)
+                            + (impulseSet->crossfade ? kTailFadeBlocks : 0) - 1;
+        return true;
+    }
+
+    void updateHeadWeights() noexcept
+    {
+        for (uint32_t i = 0; i < kMaxImpulses; ++i)
+        {
+            const float diff = targetWeights[i] - headWeights[i];
+
+            if (std::abs(diff) <= kWeightStep)
+                headWeights[i] = targetWeights[i];
+            else
+                headWeights[i] += diff > 0.f ? kWeightStep : -kWeightStep;
+        }
+
+        impulseSet->headMixer.update(headWeights);
+
+        if (fadingImpulseSet != nullptr && headConvolver.isFading())
+            fadingImpulseSet->headMixer.update(headWeights);
+    }
+
+    // reports impulse changes once their output is due, see getLastImpulseChange()
+    void updateLastImpulseChange(const uint32_t len) noexcept
     {
-        semBgProcStart.post();
+        lastImpulseChange = -1;
+
+        uint32_t numDue = 0;
+
+        for (; numDue < numPendingChanges && pendingChanges[numDue].frame < processedFrames + len; ++numDue)
+        {
+            lastImpulseChange = static_cast<int32_t>(pendingChanges[numDue].frame - processedFrames);
+            lastImpulseTag = pendingChanges[numDue].tag;
+        }
+
+        if (numDue == 0)
+            return;
+
+        numPendingChanges -= numDue;
+        std::memmove(pendingChanges, pendingChanges + numDue, sizeof(ImpulseChange) * numPendingChanges);
     }
 
-    void waitForBackgroundProcessing() override
+    // delays the output of both stages by swapping it with the latency buffer, in place
+    void delayOutput(float* const output, const uint32_t len) noexcept
     {
-        if (isThreadRunning() && !shouldThreadExit())
-            semBgProcFinished.wait();
+        float* const buffer = latencyBuffer.data();
+
+        for (uint32_t processed = 0; processed < len;)
+        {
+            const uint32_t processing = std::min(len - processed, latency - latencyPos);
+
+            std::swap_ranges(output + processed, output + processed + processing, buffer + latencyPos);
+            processed += processing;
+            latencyPos += processing;
+
+            if (latencyPos == latency)
+                latencyPos = 0;
+        }
     }
 
-    void run() override
+    void submitTailBlock(const uint32_t block)
     {
-        while (!shouldThreadExit())
+        const uint64_t now = ConvolverWorkerPool::getCurrentTime();
+        TailSlot& slot(tailSlots[block % numTailSlots]);
+
+        // the tail stage follows the impulses and weights of the head stage at the time of submission,
+        // apart from changes without crossfade, which the tail stage starts
+        std::memcpy(slot.weights, headWeights, sizeof(headWeights));
+
+        if (tailSwitching)
+        {
+            const bool switched = static_cast<int32_t>(block - tailSwitchBlock) >= 0;
+
+            if (deferredImpulseSet != nullptr)
+                slot.impulseSet = switched ? deferredImpulseSet : impulseSet;
+            else
+                slot.impulseSet = switched ? impulseSet : fadingImpulseSet;
+        }
+        else
+        {
+            slot.impulseSet = impulseSet;
+        }
+
+        // the result is needed once the blocks covered by the head stage and the latency have been played
+        slot.deadline = now + tailPeriod * resultDelay;
+        tailSubmitted.store(block + 1, std::memory_order_release);
+
+        // a running job picks up new blocks by itself, otherwise start a new one
+        submitPendingTailBlocks();
+
+        // result to play during the next block, which is this many blocks behind the one just filled
+        const uint32_t resultBlock = block - resultDelay;
+
+        if (static_cast<int32_t>(resultBlock - tailResumeBlock) >= 0)
         {
-            semBgProcStart.wait();
+            // run it here if no worker got to it yet, and only wait if a worker is already running it.
+            // the result is never skipped, so the output does not depend on how fast the workers are
+            if (! isTailBlockCompleted(resultBlock))
+                workerPool->tryHelp(workerJob);
+            if (! isTailBlockCompleted(resultBlock))
+                waitForTailBlock(resultBlock);
+
+            tailPrecalculated = tailSlots[resultBlock % numTailSlots].output.data();
+        }
+
+        // the worker fell behind by the whole ring, the next slot is still in use
+        if (! isTailBlockCompleted(block + 1 - numTailSlots))
+            waitForTailBlock(block + 1 - numTailSlots);
+    }
+
+    void submitPendingTailBlocks()
+    {
+        if (! workerPool->tryWait(workerJob))
+            return;
 
-            if (shouldThreadExit())
-                break;
+        const uint32_t firstPending = tailCompleted.load(std::memory_order_acquire);
 
+        if (firstPending != tailSubmitted.load(std::memory_order_relaxed))
+            workerPool->submit(workerJob, tailSlots[firstPending % numTailSlots].deadline);
+    }
+
+    // clears the tail history, only once no tail block is pending.
+    // results of the blocks submitted so far are not played, the next ones start from silence
+    void restartTailStage()
+    {
+        tailConvolver.reset();
+        tailResumeBlock = tailSubmitted.load(std::memory_order_relaxed);
+    }
+
+    void waitForTailBlock(const uint32_t block)
+    {
+        const TraceScope ts("cabinet tail wait");
+        numStalls.fetch_add(1, std::memory_order_relaxed);
+        workerPool->wait(workerJob);
+
+        // the job may have finished right before the block was submitted, no worker is running it now
+        if (! isTailBlockCompleted(block))
             doBackgroundProcessing();
-            semBgProcFinished.post();
+    }
+
+    bool isTailBlockCompleted(const uint32_t block) const noexcept
+    {
+        // counters wrap around, compare their distance
+        return static_cast<int32_t>(tailCompleted.load(std::memory_order_acquire) - block) > 0;
+    }
+
+    void doBackgroundProcessing()
+    {
+        const TraceScope ts("cabinet tail");
+        for (uint32_t block = tailCompleted.load(std::memory_order_relaxed);
+             block != tailSubmitted.load(std::memory_order_acquire);
+             ++block)
+        {
+            TailSlot& slot(tailSlots[block % numTailSlots]);
+
+            if (slot.impulseSet != tailImpulseSet)
+            {
+                tailFadingImpulseSet = tailImpulseSet;
+                tailImpulseSet = slot.impulseSet;
+                tailConvolver.fadeTo(tailImpulseSet->tailMixer.getSpectrum(),
+                                     tailImpulseSet->crossfade ? kTailFadeBlocks : 0);
+            }
+
+            tailImpulseSet->tailMixer.update(slot.weights);
+
+            if (tailFadingImpulseSet != nullptr)
+                tailFadingImpulseSet->tailMixer.update(slot.weights);
+
+            tailConvolver.process(slot.input.data(), slot.output.data(), kTailBlockSize);
+
+            if (! tailConvolver.isFading())
+                tailFadingImpulseSet = nullptr;
+
+            const uint64_t now = ConvolverWorkerPool::getCurrentTime();
+
+            if (now > slot.deadline)
+            {
+                const uint64_t lateTime = now - slot.deadline;
+                numLateBlocks.fetch_add(1, std::memory_order_relaxed);
+                totalLateTime.fetch_add(lateTime, std::memory_order_relaxed);
+                if (lateTime > maxLateTime.load(std::memory_order_relaxed))
+                    maxLateTime.store(lateTime, std::memory_order_relaxed);
+            }
+
+            tailCompleted.store(block + 1, std::memory_order_release);
         }
     }
 
+    static void backgroundProcessingCallback(void* const arg)
+    {
+        static_cast<TwoStageThreadedConvolver*>(arg)->doBackgroundProcessing();
+    }
+
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TwoStageThreadedConvolver)
 };
 #else
-class TwoStageThreadedConvolver : public fftconvolver::FFTConvolver
+class TwoStageThreadedConvolver
 {
-    static constexpr const size_t kHeadBlockSize = 128;
+public:
+    static constexpr const uint32_t kHeadBlockSize = 128;
+    static constexpr const uint32_t kTailBlockSize = 1024;
+    // no threads, the head stage covers the full impulse response
+    static constexpr const uint32_t kHeadLength = UINT32_MAX;
+    static constexpr const uint32_t kMaxImpulses = ConvolverSpectrumMixer::kMaxSources;
+    static constexpr const float kWeightStep = 0.05f;
+
+private:
+    std::shared_ptr<const ConvolverImpulse> impulses[kMaxImpulses];
+    ConvolverSpectrumMixer headMixer;
+    PartitionedConvolver headConvolver;
+    float headWeights[kMaxImpulses] = {};
+    float targetWeights[kMaxImpulses] = {};
 
 public:
-    TwoStageThreadedConvolver()
-        : fftconvolver::FFTConvolver() {}
+    TwoStageThreadedConvolver() {}
+
+    void setSampleRate(double) noexcept {}
+    void setDelayedOutput(bool) noexcept {}
+    void setMaxBlockSize(uint32_t) noexcept {}
+
+    static uint32_t getDelayedOutputLatency(uint32_t) noexcept
+    {
+        return 0;
+    }
+
+    uint32_t getLatency() const noexcept
+    {
+        return 0;
+    }
+
+    static std::shared_ptr<const ConvolverImpulse> createImpulse(const float* const ir, const uint32_t irLen,
+                                                                 uint32_t = kHeadLength)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(irLen != 0, nullptr);
+
+        std::shared_ptr<ConvolverBuffer> payload = std::make_shared<ConvolverBuffer>(
+            ConvolverImpulse::getPayloadFloats(irLen, kHeadLength, kHeadBlockSize, kTailBlockSize));
+
+        std::shared_ptr<ConvolverImpulse> newImpulse = std::make_shared<ConvolverImpulse>();
+        newImpulse->compute(payload->data(), ir, irLen, kHeadLength, kHeadBlockSize, kTailBlockSize);
+        newImpulse->storage = payload;
+        return newImpulse;
+    }
 
     bool init(const fftconvolver::Sample* const ir, const size_t irLen)
     {
-        return fftconvolver::FFTConvolver::init(kHeadBlockSize, ir, irLen);
+        const std::shared_ptr<const ConvolverImpulse> newImpulse = createImpulse(ir, static_cast<uint32_t>(irLen));
+        return newImpulse != nullptr && init(newImpulse);
+    }
+
+    bool init(const std::shared_ptr<const ConvolverImpulse>& newImpulse)
+    {
+        return init(&newImpulse, 1);
+    }
+
+    bool init(const std::shared_ptr<const ConvolverImpulse>* const newImpulses, const uint32_t numImpulses,
+              const float* const weights = nullptr)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numImpulses != 0 && numImpulses <= kMaxImpulses, false);
+
+        ConvolverSpectrum heads[kMaxImpulses];
+        uint32_t numUsedImpulses = 0;
+
+        for (uint32_t i = 0; i < numImpulses; ++i)
+        {
+            if (newImpulses[i] == nullptr)
+                continue;
+
+            heads[i] = newImpulses[i]->head;
+            ++numUsedImpulses;
+        }
+
+        DISTRHO_SAFE_ASSERT_RETURN(numUsedImpulses != 0, false);
+
+        if (! headMixer.init(heads, numImpulses, numImpulses > 1))
+            return false;
+
+        for (uint32_t i = 0; i < kMaxImpulses; ++i)
+        {
+            impulses[i] = i < numImpulses ? newImpulses[i] : nullptr;
+            headWeights[i] = targetWeights[i] = i < numImpulses ? (weights != nullptr ? weights[i] : 1.f) : 0.f;
+        }
+
+        headMixer.update(headWeights);
+
+        return headConvolver.init(headMixer.getSpectrum());
+    }
+
+   /**
+      In-place changes are not supported here, a new convolver must be created instead.
+    */
+    bool setImpulses(const std::shared_ptr<const ConvolverImpulse>*, uint32_t, uint32_t = 0, bool = true)
+    {
+        return false;
+    }
+
+    bool prepareImpulses(const std::shared_ptr<const ConvolverImpulse>*, uint32_t, uint32_t = 0, bool = true)
+    {
+        return false;
+    }
+
+    void applyImpulses() noexcept {}
+    void cancelImpulses() {}
+
+    bool isChangingImpulses() const noexcept
+    {
+        return false;
+    }
+
+    int32_t getLastImpulseChange(uint32_t& tag) const noexcept
+    {
+        tag = 0;
+        return -1;
+    }
+
+    void setWeights(const float* const weights) noexcept
+    {
+        std::memcpy(targetWeights, weights, sizeof(targetWeights));
+    }
+
+    void reset()
+    {
+        headConvolver.reset();
+    }
+
+    void process(const fftconvolver::Sample* const input, fftconvolver::Sample* const output, const size_t len)
+    {
+        for (uint32_t processed = 0; processed < len;)
+        {
+            if (headConvolver.getInputFill() == 0)
+            {
+                for (uint32_t i = 0; i < kMaxImpulses; ++i)
+                {
+                    const float diff = targetWeights[i] - headWeights[i];
+
+                    if (std::abs(diff) <= kWeightStep)
+                        headWeights[i] = targetWeights[i];
+                    else
+                        headWeights[i] += diff > 0.f ? kWeightStep : -kWeightStep;
+                }
+
+                headMixer.update(headWeights);
+            }
+
+            const uint32_t processing = std::min(static_cast<uint32_t>(len) - processed,
+                                                 kHeadBlockSize - headConvolver.getInputFill());
+
+            headConvolver.process(input + processed, output + processed, processing);
+            processed += processing;
+        }
     }
 };
 #endif
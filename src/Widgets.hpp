@@ -783,6 +783,8 @@ class AidaFilenameButton : public NanoSubWidget
         } labels;
 
         String filename;
+        // duration of the last load, shown on the right
+        String details;
         AidaFileSwitch* hoverButton = nullptr;
 
         AidaFileButton(NanoTopLevelWidget* const p, const String& label)
@@ -828,12 +830,28 @@ class AidaFilenameButton : public NanoSubWidget
 
             fill();
 
+            const bool showDetails = details.isNotEmpty()
+                                  && ! hoverButton->isHover()
+                                  && (getState() & kButtonStateHover) == 0;
+            double detailsWidth = 0;
+
+            if (showDetails)
+            {
+                fillColor(Color(1.f, 1.f, 1.f, 0.6f));
+                fontSize(12 * scaleFactor);
+                textAlign(ALIGN_RIGHT | ALIGN_MIDDLE);
+
+                Rectangle<float> bounds;
+                detailsWidth = textBounds(0, 0, details, nullptr, bounds) + kSubWidgetsPadding * 2 * scaleFactor;
+                text(width - kSubWidgetsPadding * scaleFactor, height/2, details, nullptr);
+            }
+
             fillColor(Color(1.f, 1.f, 1.f));
             fontSize(16 * scaleFactor);
             textAlign(ALIGN_LEFT | ALIGN_MIDDLE);
             save();
-            scissor(buttonMargin, 0, width - buttonMargin, height/2 + 16 * scaleFactor / 2);
-            textBox(buttonMargin, height/2, width - buttonMargin,
+            scissor(buttonMargin, 0, width - buttonMargin - detailsWidth, height/2 + 16 * scaleFactor / 2);
+            textBox(buttonMargin, height/2, width - buttonMargin - detailsWidth,
                     hoverButton->isHover() ? hoverButton->isChecked() ? labels.disable : labels.enable
                                            : getState() & kButtonStateHover ? labels.load : filename,
                     nullptr);
@@ -891,6 +909,23 @@ public:
         button->repaint();
     }
 
+    // shows how long the last load took, @a ms in milliseconds, and its slowest phase, nothing before any load
+    void setLoadTime(const float ms, const char* const slowestPhase)
+    {
+        if (ms > 0.f)
+        {
+            char details[64];
+            std::snprintf(details, sizeof(details), "%.0f ms, %s", ms, slowestPhase);
+            button->details = details;
+        }
+        else
+        {
+            button->details = "";
+        }
+
+        button->repaint();
+    }
+
 protected:
     void onNanoDisplay() override {}
 
@@ -7,8 +7,15 @@
 
 #include "DistrhoPlugin.hpp"
 
+#include "BatchedModel.hpp"
 #include "Biquad.h"
+#include "BiquadCascade.hpp"
+#include "BlockValueSmoother.hpp"
+#include "DeadlineMonitor.hpp"
 #include "Files.hpp"
+#include "LoadTimer.hpp"
+#include "StageProfiler.hpp"
+#include "TraceRecorder.hpp"
 
 #include "model_variant.hpp"
 #include "extra/ScopedDenormalDisable.hpp"
@@ -16,7 +23,9 @@
 #include "extra/ValueSmoother.hpp"
 
 #include <atomic>
+#include <iterator>
 #include <strstream>
+#include <vector>
 
 #include "dr_flac.h"
 #include "dr_wav.h"
@@ -25,6 +34,16 @@
 
 // must be last
 #include "TwoStageThreadedConvolver.hpp"
+#include "IRCache.hpp"
+#ifndef DISTRHO_OS_WASM
+# include "ModelBatchGroup.hpp"
+#endif
+#if AIDAX_WITH_BAKED_EQ
+# include "CabinetEqBaker.hpp"
+#endif
+#if AIDAX_WITH_AUDIOFILE
+# include "AudioFileStream.hpp"
+#endif
 
 START_NAMESPACE_DISTRHO
 
@@ -51,9 +70,50 @@ static constexpr const float INLPF_MIN_CO = 0.25f * 0.5f; /* coeff * ((samplerat
 /* Gain compensation for cabinet IR (-12dB) */
 static constexpr const float kCabinetMaxGain = 0.251f;
 
+/* Model parameter ramps are computed this many samples at a time */
+static constexpr const uint32_t kModelParamBlockSize = 64;
+
+/* Below this level (-90dB) audio is considered silent */
+static constexpr const float kSilenceThreshold = 3.1623e-5f;
+
+/* Silence on input and output for this long (in seconds) puts processing to sleep */
+static constexpr const float kSleepHoldTime = 0.5f;
+
+/* Model output varying less than this (-120dB) over a silent block means its hidden state has settled */
+static constexpr const float kSettledModelDelta = 1e-6f;
+
+/* Post EQ is folded into the cabinet IRs once its controls stay untouched for this long (in seconds) */
+static constexpr const float kEqBakeHoldTime = 1.f;
+
+/* Post EQ fades back in along the IR crossfade when taken out of the cabinet IRs again */
+static constexpr const uint32_t kEqUnbakeFadeFrames =
+    TwoStageThreadedConvolver::kHeadFadeBlocks * TwoStageThreadedConvolver::kHeadBlockSize;
+
+static_assert(kCabinetSlots == TwoStageThreadedConvolver::kMaxImpulses, "cabinet slots match convolver impulses");
+
+/* Tone controls run as a single fused cascade, in float precision unless AIDAX_EQ_DOUBLE_PRECISION is set */
+#if AIDAX_BIQUAD_SIMD && !defined(AIDAX_EQ_DOUBLE_PRECISION)
+typedef BiquadCascadeSIMD ToneControlCascade;
+#elif defined(AIDAX_EQ_DOUBLE_PRECISION)
+typedef BiquadCascade<double> ToneControlCascade;
+#else
+typedef BiquadCascade<float> ToneControlCascade;
+#endif
+
 // --------------------------------------------------------------------------------------------------------------------
 
 struct AidaToneControl {
+    // filters with parameters that can change while running
+    enum Filter {
+        kFilterInputLPF,
+        kFilterBass,
+        kFilterMid,
+        kFilterTreble,
+        kFilterDepth,
+        kFilterPresence,
+        kNumFilters
+    };
+
     Biquad dc_blocker { bq_type_highpass, 0.5f, COMMON_Q, 0.0f };
     Biquad in_lpf { bq_type_lowpass, 0.5f, COMMON_Q, 0.0f };
     Biquad bass { bq_type_lowshelf, 0.5f, COMMON_Q, 0.0f };
@@ -61,41 +121,98 @@ struct AidaToneControl {
     Biquad treble { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
     Biquad depth { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
     Biquad presence { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
-    ExponentialValueSmoother inlevel;
-    ExponentialValueSmoother outlevel;
+    ToneControlCascade cascade;
+    // right channel of linked stereo, same coefficients as the filters above
+    BiquadState dc_blocker_right;
+    BiquadState in_lpf_right;
+    BiquadState bass_right;
+    BiquadState mid_right;
+    BiquadState treble_right;
+    BiquadState depth_right;
+    BiquadState presence_right;
+    StereoBiquadCascade stereoCascade;
+    BlockValueSmoother inlevel;
+    BlockValueSmoother outlevel;
     bool net_bypass = false;
     bool eq_bypass = false;
     EqPos eq_pos = kEqPost;
     MidEqType mid_type = kMidEqPeak;
 
+    // parameter changes only mark filters as dirty, coefficients are recalculated once per block.
+    // recalculated filters then ramp from their previous coefficients during that block
+    uint32_t dirtyFilters = 0;
+    uint32_t rampingFilters = 0;
+    double rampCoefficients[kNumFilters][5];
+
     AidaToneControl()
     {
         inlevel.setTimeConstant(1);
         outlevel.setTimeConstant(1);
     }
 
-    void setSampleRate(const float parameters[kNumParameters], const double sampleRate)
+    Biquad& getFilter(const Filter filter)
     {
-        dc_blocker.setFc(35.0f / sampleRate);
+        switch (filter)
+        {
+        case kFilterInputLPF:
+            return in_lpf;
+        case kFilterBass:
+            return bass;
+        case kFilterMid:
+            return mid;
+        case kFilterTreble:
+            return treble;
+        case kFilterDepth:
+            return depth;
+        case kFilterPresence:
+        case kNumFilters:
+            break;
+        }
 
-        in_lpf.setFc(MAP(parameters[kParameterINLPF], 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+        return presence;
+    }
+
+    BiquadState& getRightState(const Filter filter)
+    {
+        switch (filter)
+        {
+        case kFilterInputLPF:
+            return in_lpf_right;
+        case kFilterBass:
+            return bass_right;
+        case kFilterMid:
+            return mid_right;
+        case kFilterTreble:
+            return treble_right;
+        case kFilterDepth:
+            return depth_right;
+        case kFilterPresence:
+        case kNumFilters:
+            break;
+        }
+
+        return presence_right;
+    }
 
-        bass.setBiquad(bq_type_lowshelf,
-                       parameters[kParameterBASSFREQ] / sampleRate, COMMON_Q, parameters[kParameterBASSGAIN]);
+    // coefficients to ramp from during the current block, null if the filter is not changing
+    const double* getRampCoefficients(const Filter filter) const
+    {
+        return (rampingFilters & (1u << filter)) != 0 ? rampCoefficients[filter] : nullptr;
+    }
 
-        mid.setBiquad(mid_type == kMidEqBandpass ? bq_type_bandpass : bq_type_peak,
-                      parameters[kParameterMIDFREQ] / sampleRate,
-                      parameters[kParameterMIDQ],
-                      parameters[kParameterMIDGAIN]);
+    void setDirty(const Filter filter)
+    {
+        dirtyFilters |= 1u << filter;
+    }
 
-        treble.setBiquad(bq_type_highshelf,
-                         parameters[kParameterTREBLEFREQ] / sampleRate, COMMON_Q, parameters[kParameterTREBLEGAIN]);
+    void setSampleRate(const float parameters[kNumParameters], const double sampleRate)
+    {
+        dc_blocker.setFc(35.0f / sampleRate);
 
-        depth.setBiquad(bq_type_peak,
-                        DEPTH_FREQ / sampleRate, COMMON_Q, parameters[kParameterDEPTH]);
+        for (uint i = 0; i < kNumFilters; ++i)
+            updateFilter(static_cast<Filter>(i), parameters, sampleRate);
 
-        presence.setBiquad(bq_type_highshelf,
-                           PRESENCE_FREQ / sampleRate, COMMON_Q, parameters[kParameterPRESENCE]);
+        dirtyFilters = rampingFilters = 0;
 
         inlevel.setSampleRate(sampleRate);
         inlevel.setTargetValue(DB_CO(parameters[kParameterINLEVEL]));
@@ -103,45 +220,350 @@ struct AidaToneControl {
         outlevel.setSampleRate(sampleRate);
         outlevel.setTargetValue(DB_CO(parameters[kParameterOUTLEVEL]));
     }
-};
 
-#if AIDAX_WITH_AUDIOFILE
-struct AudioFile {
-    float* buffer;
-    drwav_uint64 currentFrame;
-    drwav_uint64 numFrames;
-    bool resampled;
-
-    AudioFile(float* const buffer_, const drwav_uint64 numFrames_, const bool resampled_) noexcept
-        : buffer(buffer_),
-          currentFrame(0),
-          numFrames(numFrames_),
-          resampled(resampled_) {}
-
-    ~AudioFile() noexcept
-    {
-        if (resampled)
-            delete[] buffer;
-        else
-            drwav_free(buffer, nullptr);
+    // called at the start of each processed block
+    void updateCoefficients(const float parameters[kNumParameters], const double sampleRate)
+    {
+        rampingFilters = dirtyFilters;
+
+        if (dirtyFilters == 0)
+            return;
+
+        for (uint i = 0; i < kNumFilters; ++i)
+        {
+            if ((dirtyFilters & (1u << i)) == 0)
+                continue;
+
+            const Filter filter = static_cast<Filter>(i);
+            getFilter(filter).getCoefficients(rampCoefficients[i]);
+            updateFilter(filter, parameters, sampleRate);
+        }
+
+        dirtyFilters = 0;
+    }
+
+    // filters of the tone controls that currently change the audio, in processing order
+    uint getAudibleFilters(Biquad* filters[5])
+    {
+        if (mid_type == kMidEqBandpass)
+        {
+            filters[0] = &mid;
+            return 1;
+        }
+
+        uint numFilters = 0;
+
+        for (Biquad* const filter : { &depth, &bass, &mid, &treble, &presence })
+        {
+            if (! filter->isIdentity())
+                filters[numFilters++] = filter;
+        }
+
+        return numFilters;
+    }
+
+    void resetToneControls()
+    {
+        bass.reset();
+        mid.reset();
+        treble.reset();
+        depth.reset();
+        presence.reset();
+        bass_right.reset();
+        mid_right.reset();
+        treble_right.reset();
+        depth_right.reset();
+        presence_right.reset();
+    }
+
+    // for when the right channel starts or stops running
+    void resetRightChannel()
+    {
+        dc_blocker_right.reset();
+        in_lpf_right.reset();
+        bass_right.reset();
+        mid_right.reset();
+        treble_right.reset();
+        depth_right.reset();
+        presence_right.reset();
+    }
+
+private:
+    void updateFilter(const Filter filter, const float parameters[kNumParameters], const double sampleRate)
+    {
+        switch (filter)
+        {
+        case kFilterInputLPF:
+            in_lpf.setFc(MAP(parameters[kParameterINLPF], 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+            break;
+        case kFilterBass:
+            bass.setBiquad(bq_type_lowshelf,
+                           parameters[kParameterBASSFREQ] / sampleRate, COMMON_Q, parameters[kParameterBASSGAIN]);
+            break;
+        case kFilterMid:
+            mid.setBiquad(mid_type == kMidEqBandpass ? bq_type_bandpass : bq_type_peak,
+                          parameters[kParameterMIDFREQ] / sampleRate,
+                          parameters[kParameterMIDQ],
+                          parameters[kParameterMIDGAIN]);
+            break;
+        case kFilterTreble:
+            treble.setBiquad(bq_type_highshelf,
+                             parameters[kParameterTREBLEFREQ] / sampleRate, COMMON_Q, parameters[kParameterTREBLEGAIN]);
+            break;
+        case kFilterDepth:
+            depth.setBiquad(bq_type_peak,
+                            DEPTH_FREQ / sampleRate, COMMON_Q, parameters[kParameterDEPTH]);
+            break;
+        case kFilterPresence:
+            presence.setBiquad(bq_type_highshelf,
+                               PRESENCE_FREQ / sampleRate, COMMON_Q, parameters[kParameterPRESENCE]);
+            break;
+        case kNumFilters:
+            break;
+        }
     }
 };
-#endif
 
 struct DynamicModel {
     ModelVariantType variant;
+    BatchedModel stereo; /* Same weights, running left and right together for linked stereo, if loaded */
+    ModelVariantType variantRight; /* Same weights for the right channel of linked stereo, if not batched */
+    bool batched = false; /* Runs through the model batch group of the instance, see ModelBatchGroup */
     bool input_skip; /* Means the model has been trained with first input element skipped to the output */
     float input_gain;
     float output_gain;
 };
 
+// --------------------------------------------------------------------------------------------------------------------
+// Copy the input kept for the bypass mix, measuring its peak on the way
+
+static float copyWithPeak(float* const out, const float* const in, const uint32_t numSamples)
+{
+    float peaks[4] = {};
+    uint32_t i = 0;
+
+    // independent lanes so that the loop vectorizes without reordering the max
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            out[i + j] = in[i + j];
+            peaks[j] = std::max(peaks[j], std::abs(in[i + j]));
+        }
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        out[i] = in[i];
+        peaks[0] = std::max(peaks[0], std::abs(in[i]));
+    }
+
+    return std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+}
+
+#if AIDAX_WITH_AUDIOFILE
+// Same as above, without the copy
+
+static float getPeak(const float* const in, const uint32_t numSamples)
+{
+    float peaks[4] = {};
+    uint32_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+            peaks[j] = std::max(peaks[j], std::abs(in[i + j]));
+    }
+
+    for (; i < numSamples; ++i)
+        peaks[0] = std::max(peaks[0], std::abs(in[i]));
+
+    return std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// Check if a block holds a constant value, within kSettledModelDelta
+
+static bool isSettledBlock(const float* const in, const uint32_t numSamples)
+{
+    float mins[4] = { in[0], in[0], in[0], in[0] };
+    float maxs[4] = { in[0], in[0], in[0], in[0] };
+    uint32_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            mins[j] = std::min(mins[j], in[i + j]);
+            maxs[j] = std::max(maxs[j], in[i + j]);
+        }
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        mins[0] = std::min(mins[0], in[i]);
+        maxs[0] = std::max(maxs[0], in[i]);
+    }
+
+    return std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]))
+         - std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3])) <= kSettledModelDelta;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // Apply a gain ramp to a buffer
 
-static void applyGainRamp(ExponentialValueSmoother& smoother, float* const out, const uint32_t numSamples)
+static void applyGainRamp(const BlockValueSmoother::Ramp gain, float* const out, const float* const in,
+                          const uint32_t numSamples)
 {
-    for (uint32_t i=0; i<numSamples; ++i)
-        out[i] *= smoother.next();
+    for (uint32_t i = 0; i < numSamples; ++i)
+        out[i] = in[i] * gain.at(i);
+}
+
+// Same as above, with a filter running before the gain in the same pass
+
+static void applyFilterGainRamp(Biquad& filter, const BlockValueSmoother::Ramp gain,
+                                float* const out, const float* const in, const uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; ++i)
+        out[i] = filter.process(in[i]) * gain.at(i);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Elementwise stages after the cabinet, all in a single pass that returns the output peak:
+// the cabinet mix with its dry signal, output gain, and the bypass mix with the plugin input
+
+struct OutputStages {
+    const float* cabinetDry;
+    BlockValueSmoother::Ramp cabinetGain;
+    BlockValueSmoother::Ramp cabinetDryGain;
+    BlockValueSmoother::Ramp outputGain;
+    const float* bypassDry;
+    BlockValueSmoother::Ramp bypassGain;
+};
+
+// kGain is off when both gains are settled at unity, kBypassMix needs it on
+template <bool kCabinetMix, bool kGain, bool kBypassMix>
+static float applyOutputStages(const OutputStages& stages, float* const out, const uint32_t numSamples)
+{
+    float peaks[4] = {};
+    uint32_t i = 0;
+
+    const auto process = [&stages, out](const uint32_t k) -> float
+    {
+        float y = out[k];
+
+        if (kCabinetMix)
+            y = y * stages.cabinetGain.at(k) + stages.cabinetDry[k] * stages.cabinetDryGain.at(k);
+
+        if (kGain)
+        {
+            const float b = stages.bypassGain.at(k);
+            y *= stages.outputGain.at(k) * b;
+
+            if (kBypassMix)
+                y += stages.bypassDry[k] * (1.f - b);
+        }
+
+        // nothing to write back when only metering
+        if (kCabinetMix || kGain)
+            out[k] = y;
+
+        return y;
+    };
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+            peaks[j] = std::max(peaks[j], std::abs(process(i + j)));
+    }
+
+    for (; i < numSamples; ++i)
+        peaks[0] = std::max(peaks[0], std::abs(process(i)));
+
+    return std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+}
+
+static float applyOutputStages(const OutputStages& stages, float* const out, const uint32_t numSamples)
+{
+    const bool cabinetMix = stages.cabinetDry != nullptr;
+
+    if (stages.bypassDry != nullptr)
+    {
+        return cabinetMix
+            ? applyOutputStages<true, true, true>(stages, out, numSamples)
+            : applyOutputStages<false, true, true>(stages, out, numSamples);
+    }
+
+    if (! stages.outputGain.isConstantAt(1.f) || ! stages.bypassGain.isConstantAt(1.f))
+    {
+        return cabinetMix
+            ? applyOutputStages<true, true, false>(stages, out, numSamples)
+            : applyOutputStages<false, true, false>(stages, out, numSamples);
+    }
+
+    return cabinetMix
+        ? applyOutputStages<true, false, false>(stages, out, numSamples)
+        : applyOutputStages<false, false, false>(stages, out, numSamples);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Fixed delay applied in place, keeping the signals mixed with the cabinet output aligned with its latency
+
+struct DelayLine {
+    std::vector<float> buffer;
+    uint32_t delay = 0;
+    uint32_t pos = 0;
+
+    // allocates room for delays up to @a maxDelay, not realtime safe
+    void setMaxDelay(const uint32_t maxDelay)
+    {
+        buffer.assign(maxDelay, 0.f);
+        delay = std::min(delay, maxDelay);
+        pos = 0;
+    }
+
+    // realtime safe, the delayed signal is cleared
+    void setDelay(const uint32_t frames) noexcept
+    {
+        delay = std::min(frames, static_cast<uint32_t>(buffer.size()));
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        std::fill(buffer.begin(), buffer.begin() + delay, 0.f);
+        pos = 0;
+    }
+
+    void process(float* const inout, const uint32_t numSamples) noexcept
+    {
+        for (uint32_t processed = 0; processed < numSamples && delay != 0;)
+        {
+            const uint32_t processing = std::min(numSamples - processed, delay - pos);
+
+            std::swap_ranges(inout + processed, inout + processed + processing, buffer.data() + pos);
+            processed += processing;
+            pos += processing;
+
+            if (pos == delay)
+                pos = 0;
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Check if a smoothed gain reached @a value, snapping it there so that the stage using it can be skipped
+
+static bool isSettledAt(BlockValueSmoother& smoother, const float value)
+{
+    if (d_isNotEqual(smoother.getTargetValue(), value))
+        return false;
+    if (! smoother.isSettled())
+        return false;
+
+    smoother.clearToTargetValue();
+    return true;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -153,36 +575,205 @@ static void applyBiquadFilter(Biquad& filter, float* const out, const float* con
         out[i] = filter.process(in[i]);
 }
 
+// Same as above, with coefficients moving from rampFrom to the filter ones during the block
+
+static void applyBiquadFilter(Biquad& filter, const double* const rampFrom,
+                              float* const out, const float* const in, const uint32_t numSamples)
+{
+    if (rampFrom == nullptr)
+        return applyBiquadFilter(filter, out, in, numSamples);
+
+    BiquadCascade<double> ramp;
+    ramp.add(filter, rampFrom);
+    ramp.process(out, in, numSamples);
+    ramp.storeStates();
+}
+
 static void applyBiquadFilter(Biquad& filter, float* const out, const uint32_t numSamples)
 {
     for (uint32_t i=0; i<numSamples; ++i)
         out[i] = filter.process(out[i]);
 }
 
+// Same as above for linked stereo, both channels in a single pass with the right one keeping its state in @a right
+
+static void applyBiquadFilter(Biquad& filter, BiquadState& right, const double* const rampFrom,
+                              float* const outL, float* const outR, const float* const inL, const float* const inR,
+                              const uint32_t numSamples)
+{
+    StereoBiquadCascade cascade;
+    cascade.add(filter, right, rampFrom);
+    cascade.process(outL, outR, inL, inR, numSamples);
+    cascade.storeStates();
+}
+
+// Filters that pass audio unchanged can be skipped once their state has decayed
+
+static bool isBiquadFilterAudible(Biquad& filter)
+{
+    if (filter.isIdentity() && filter.hasDecayed())
+    {
+        filter.reset();
+        return false;
+    }
+
+    return true;
+}
+
+static bool isBiquadFilterAudible(Biquad& filter, BiquadState& right)
+{
+    if (filter.isIdentity() && filter.hasDecayed() && right.hasDecayed())
+    {
+        filter.reset();
+        right.reset();
+        return false;
+    }
+
+    return true;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
-// Apply biquad cascade filters
+// Apply biquad cascade filters, all audible sections in a single pass
+
+static bool applyToneControls(AidaToneControl& aida, float* const out, uint32_t numSamples)
+{
+    ToneControlCascade& cascade(aida.cascade);
+    cascade.clear();
+
+    if (aida.mid_type == kMidEqBandpass)
+    {
+        cascade.add(aida.mid, aida.getRampCoefficients(AidaToneControl::kFilterMid));
+    }
+    else
+    {
+        for (const AidaToneControl::Filter filter : { AidaToneControl::kFilterDepth,
+                                                      AidaToneControl::kFilterBass,
+                                                      AidaToneControl::kFilterMid,
+                                                      AidaToneControl::kFilterTreble,
+                                                      AidaToneControl::kFilterPresence })
+        {
+            Biquad& biquad(aida.getFilter(filter));
+            const double* const rampFrom = aida.getRampCoefficients(filter);
 
-static void applyToneControls(AidaToneControl& aida, float* const out, uint32_t numSamples)
+            // a filter ramping towards pass-through still changes the audio
+            if (rampFrom != nullptr || isBiquadFilterAudible(biquad))
+                cascade.add(biquad, rampFrom);
+        }
+
+        if (cascade.getNumSections() == 0)
+            return false;
+    }
+
+    cascade.process(out, out, numSamples);
+    cascade.storeStates();
+    return true;
+}
+
+// Same as above for linked stereo
+
+static bool applyToneControls(AidaToneControl& aida, float* const outL, float* const outR, uint32_t numSamples)
 {
+    StereoBiquadCascade& cascade(aida.stereoCascade);
+    cascade.clear();
+
     if (aida.mid_type == kMidEqBandpass)
     {
-        applyBiquadFilter(aida.mid, out, numSamples);
+        cascade.add(aida.mid, aida.mid_right, aida.getRampCoefficients(AidaToneControl::kFilterMid));
+    }
+    else
+    {
+        for (const AidaToneControl::Filter filter : { AidaToneControl::kFilterDepth,
+                                                      AidaToneControl::kFilterBass,
+                                                      AidaToneControl::kFilterMid,
+                                                      AidaToneControl::kFilterTreble,
+                                                      AidaToneControl::kFilterPresence })
+        {
+            Biquad& biquad(aida.getFilter(filter));
+            BiquadState& right(aida.getRightState(filter));
+            const double* const rampFrom = aida.getRampCoefficients(filter);
+
+            if (rampFrom != nullptr || isBiquadFilterAudible(biquad, right))
+                cascade.add(biquad, right, rampFrom);
+        }
+
+        if (cascade.getNumSections() == 0)
+            return false;
+    }
+
+    cascade.process(outL, outR, outL, outR, numSamples);
+    cascade.storeStates();
+    return true;
+}
+
+// Same as above, crossfading from the unprocessed audio over the remaining fadeFrames (out of numFadeFrames)
+
+static bool applyToneControlsFadeIn(AidaToneControl& aida, float* const out, float* const tmp, uint32_t numSamples,
+                                    uint32_t& fadeFrames, const uint32_t numFadeFrames)
+{
+    std::memcpy(tmp, out, sizeof(float)*numSamples);
+
+    if (! applyToneControls(aida, tmp, numSamples))
+    {
+        fadeFrames = 0;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numSamples; ++i)
+    {
+        if (fadeFrames != 0)
+        {
+            const float wet = 1.f - static_cast<float>(fadeFrames--) / numFadeFrames;
+            out[i] += (tmp[i] - out[i]) * wet;
+        }
+        else
+        {
+            out[i] = tmp[i];
+        }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Interleaved inputs of the batched model for a block of audio, with the parameters as ramps or as single values
+
+static void writeModelInputs(float* const in, const float* const audio, const uint32_t blockSize, const int input_size,
+                             const float input_gain, const float* const values1, const float* const values2,
+                             const float value1, const float value2)
+{
+    for (uint32_t i=0; i<blockSize; ++i)
+    {
+        in[i * input_size] = audio[i] * input_gain;
+
+        if (input_size >= 2)
+            in[i * input_size + 1] = values1 != nullptr ? values1[i] : value1;
+        if (input_size >= 3)
+            in[i * input_size + 2] = values2 != nullptr ? values2[i] : value2;
+    }
+}
+
+// Output of the batched model for a block, @a out can be the same buffer as the model results @a y
+
+static void writeModelOutputs(float* const out, const float* const in, const float* const y, const uint32_t blockSize,
+                              const int input_size, const bool input_skip, const float output_gain)
+{
+    if (input_skip)
+    {
+        for (uint32_t i=0; i<blockSize; ++i)
+            out[i] = (in[i * input_size] + y[i]) * output_gain;
     }
     else
     {
-        applyBiquadFilter(aida.depth, out, numSamples);
-        applyBiquadFilter(aida.bass, out, numSamples);
-        applyBiquadFilter(aida.mid, out, numSamples);
-        applyBiquadFilter(aida.treble, out, numSamples);
-        applyBiquadFilter(aida.presence, out, numSamples);
+        for (uint32_t i=0; i<blockSize; ++i)
+            out[i] = y[i] * output_gain;
     }
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 // This function carries model calculations
 
-void applyModel(DynamicModel* model, float* const out, uint32_t numSamples,
-                LinearValueSmoother& param1, LinearValueSmoother& param2)
+void applyModel(DynamicModel* model, ModelVariantType& variant, float* const out, uint32_t numSamples,
+                LinearBlockValueSmoother& param1, LinearBlockValueSmoother& param2)
 {
     const bool input_skip = model->input_skip;
     const float input_gain = model->input_gain;
@@ -215,48 +806,64 @@ void applyModel(DynamicModel* model, float* const out, uint32_t numSamples,
             else if constexpr (ModelType::input_size == 2)
             {
                 float inArray1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[2];
+                float param1Values[kModelParamBlockSize];
 
-                if (input_skip)
+                for (uint32_t offset=0; offset<numSamples; offset+=kModelParamBlockSize)
                 {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray1[0] = out[i];
-                        inArray1[1] = param1.next();
-                        out[i] += custom_model.forward(inArray1);
-                    }
-                }
-                else
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
+                    float* const blockOut = out + offset;
+                    const uint32_t blockSize = std::min(numSamples - offset, kModelParamBlockSize);
+
+                    // settled parameters are set once for the whole block
+                    const bool ramp1 = ! param1.fillBlock(param1Values, blockSize);
+
+                    if (! ramp1)
+                        inArray1[1] = param1.getTargetValue();
+
+                    for (uint32_t i=0; i<blockSize; ++i)
                     {
-                        inArray1[0] = out[i];
-                        inArray1[1] = param1.next();
-                        out[i] = custom_model.forward(inArray1) * output_gain;
+                        inArray1[0] = blockOut[i];
+                        if (ramp1)
+                            inArray1[1] = param1Values[i];
+
+                        if (input_skip)
+                            blockOut[i] += custom_model.forward(inArray1);
+                        else
+                            blockOut[i] = custom_model.forward(inArray1) * output_gain;
                     }
                 }
             }
             else if constexpr (ModelType::input_size == 3)
             {
                 float inArray2 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3];
+                float param1Values[kModelParamBlockSize];
+                float param2Values[kModelParamBlockSize];
 
-                if (input_skip)
+                for (uint32_t offset=0; offset<numSamples; offset+=kModelParamBlockSize)
                 {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray2[0] = out[i];
-                        inArray2[1] = param1.next();
-                        inArray2[2] = param2.next();
-                        out[i] += custom_model.forward(inArray2);
-                    }
-                }
-                else
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
+                    float* const blockOut = out + offset;
+                    const uint32_t blockSize = std::min(numSamples - offset, kModelParamBlockSize);
+
+                    // settled parameters are set once for the whole block
+                    const bool ramp1 = ! param1.fillBlock(param1Values, blockSize);
+                    const bool ramp2 = ! param2.fillBlock(param2Values, blockSize);
+
+                    if (! ramp1)
+                        inArray2[1] = param1.getTargetValue();
+                    if (! ramp2)
+                        inArray2[2] = param2.getTargetValue();
+
+                    for (uint32_t i=0; i<blockSize; ++i)
                     {
-                        inArray2[0] = out[i];
-                        inArray2[1] = param1.next();
-                        inArray2[2] = param2.next();
-                        out[i] = custom_model.forward(inArray2) * output_gain;
+                        inArray2[0] = blockOut[i];
+                        if (ramp1)
+                            inArray2[1] = param1Values[i];
+                        if (ramp2)
+                            inArray2[2] = param2Values[i];
+
+                        if (input_skip)
+                            blockOut[i] += custom_model.forward(inArray2);
+                        else
+                            blockOut[i] = custom_model.forward(inArray2) * output_gain;
                     }
                 }
             }
@@ -267,10 +874,103 @@ void applyModel(DynamicModel* model, float* const out, uint32_t numSamples,
                     out[i] *= output_gain;
             }
         },
-        model->variant
+        variant
     );
 }
 
+// Same as above for linked stereo, both channels step through the batched model together.
+// Gains are applied per sample, multiplying by unity where applyModel() skips it gives the same results
+
+void applyModelStereo(DynamicModel* model, float* const outL, float* const outR, uint32_t numSamples,
+                      LinearBlockValueSmoother& param1, LinearBlockValueSmoother& param2)
+{
+    BatchedModel& stereo(model->stereo);
+
+    // architectures the batched model does not support run each channel through its own copy instead,
+    // with the parameters ramping the same way for both
+    if (stereo.getNumStreams() != 2)
+    {
+        LinearBlockValueSmoother param1Right(param1);
+        LinearBlockValueSmoother param2Right(param2);
+
+        applyModel(model, model->variant, outL, numSamples, param1, param2);
+        applyModel(model, model->variantRight, outR, numSamples, param1Right, param2Right);
+        return;
+    }
+
+    const int input_size = stereo.getInputSize();
+    const bool input_skip = model->input_skip;
+    const float input_gain = model->input_gain;
+    const float output_gain = model->output_gain;
+
+    float inputs[2][kModelParamBlockSize * BatchedModel::kMaxInputSize];
+    float results[2][kModelParamBlockSize];
+    float param1Values[kModelParamBlockSize];
+    float param2Values[kModelParamBlockSize];
+    const float* const inputPtrs[2] = { inputs[0], inputs[1] };
+    float* const resultPtrs[2] = { results[0], results[1] };
+    float* const outs[2] = { outL, outR };
+
+    for (uint32_t offset=0; offset<numSamples; offset+=kModelParamBlockSize)
+    {
+        const uint32_t blockSize = std::min(numSamples - offset, kModelParamBlockSize);
+
+        // parameters are shared by both channels, settled ones are set once for the whole block
+        const bool ramp1 = input_size >= 2 && ! param1.fillBlock(param1Values, blockSize);
+        const bool ramp2 = input_size >= 3 && ! param2.fillBlock(param2Values, blockSize);
+        const float value1 = param1.getTargetValue();
+        const float value2 = param2.getTargetValue();
+
+        for (uint c=0; c<2; ++c)
+            writeModelInputs(inputs[c], outs[c] + offset, blockSize, input_size, input_gain,
+                             ramp1 ? param1Values : nullptr, ramp2 ? param2Values : nullptr, value1, value2);
+
+        stereo.process(inputPtrs, resultPtrs, blockSize);
+
+        for (uint c=0; c<2; ++c)
+            writeModelOutputs(outs[c] + offset, inputs[c], results[c], blockSize, input_size, input_skip, output_gain);
+    }
+}
+
+#ifndef DISTRHO_OS_WASM
+// Same as applyModel() for an instance in a model batch group, its stream steps together with those of the other
+// members. @a inputs holds the interleaved model inputs of all @a numSamples frames.
+// With @a alone only this stream runs, starting from a zero state, for warming up before processing starts
+
+void applyModelBatched(DynamicModel* model, ModelBatchGroup& group, const uint slot, float* const inputs,
+                       float* const out, uint32_t numSamples,
+                       LinearBlockValueSmoother& param1, LinearBlockValueSmoother& param2, const bool alone = false)
+{
+    const int input_size = group.getInputSize();
+    const bool input_skip = model->input_skip;
+    const float input_gain = model->input_gain;
+    const float output_gain = model->output_gain;
+
+    float param1Values[kModelParamBlockSize];
+    float param2Values[kModelParamBlockSize];
+
+    for (uint32_t offset=0; offset<numSamples; offset+=kModelParamBlockSize)
+    {
+        const uint32_t blockSize = std::min(numSamples - offset, kModelParamBlockSize);
+
+        // settled parameters are set once for the whole block
+        const bool ramp1 = input_size >= 2 && ! param1.fillBlock(param1Values, blockSize);
+        const bool ramp2 = input_size >= 3 && ! param2.fillBlock(param2Values, blockSize);
+
+        writeModelInputs(inputs + offset * input_size, out + offset, blockSize, input_size, input_gain,
+                         ramp1 ? param1Values : nullptr, ramp2 ? param2Values : nullptr,
+                         param1.getTargetValue(), param2.getTargetValue());
+    }
+
+    if (alone)
+        group.processAlone(slot, inputs, out, numSamples, true);
+    else
+        group.process(slot, inputs, out, numSamples);
+
+    writeModelOutputs(out, inputs, out, numSamples, input_size, input_skip, output_gain);
+}
+#endif
+
 // --------------------------------------------------------------------------------------------------------------------
 
 class AidaDSPLoaderPlugin : public Plugin
@@ -278,26 +978,74 @@ class AidaDSPLoaderPlugin : public Plugin
     AidaToneControl aida;
     DynamicModel* model = nullptr;
     TwoStageThreadedConvolver* cabsim = nullptr;
+    // right channel of linked stereo, sharing the impulses of the one above
+    TwoStageThreadedConvolver* cabsimRight = nullptr;
     std::atomic<bool> activeModel { false };
     std::atomic<bool> activeConvolver { false };
-    String cabsimFilename;
-    ExponentialValueSmoother cabsimGain;
+    // impulses prepared in both convolvers of linked stereo, applied together on the next cabinet block
+    std::atomic<bool> cabinetImpulsesPrepared { false };
+    std::shared_ptr<const ConvolverImpulse> cabinetImpulses[kCabinetSlots];
+    String cabsimFilenames[kCabinetSlots];
+    float cabinetWeights[kCabinetSlots] = {};
+    BlockValueSmoother cabsimGain;
     float* cabsimInplaceBuffer = nullptr;
-    ExponentialValueSmoother bypassGain;
+    float* cabsimInplaceBufferRight = nullptr;
+    BlockValueSmoother bypassGain;
     float* bypassInplaceBuffer = nullptr;
+    float* bypassInplaceBufferRight = nullptr;
+    // latency of the active cabinet convolver, the dry signals mixed with it are delayed to match
+    uint32_t cabinetLatency = 0;
+    // set by the "cabinet-latency" state, convolvers then delay their output unless rendering offline
+    bool cabinetLatencyEnabled = false;
+    bool cabinetDelayedOutput = false;
+    DelayLine cabinetDryDelay, cabinetDryDelayRight;
+    DelayLine bypassDryDelay, bypassDryDelayRight;
     float parameters[kNumParameters];
-    LinearValueSmoother param1;
-    LinearValueSmoother param2;
+    LinearBlockValueSmoother param1;
+    LinearBlockValueSmoother param2;
     bool enabledLPF = true;
     bool enabledDC = true;
     bool isStereoAU = false;
     bool paramFirstRun = true;
+    bool offline = false;
+    uint32_t activeStages = 0;
+    uint32_t silentFrames = 0;
+    uint32_t sleepHoldFrames = 0;
     std::atomic<bool> resetMeters { true };
     float tmpMeterIn, tmpMeterOut;
     uint32_t tmpMeterFrames, meterMaxFrameCount;
+    StageProfiler<kProfileCount> profiler;
+    DeadlineMonitor deadlineMonitor;
+    String modelFilename;
+   #ifndef DISTRHO_OS_WASM
+    // set through the "model-batch" state, the model named there runs through the group instead of on its own
+    ModelBatchGroup* modelBatch = nullptr;
+    uint modelBatchSlot = 0;
+    String modelBatchModel;
+    std::vector<float> modelBatchInputs;
+   #endif
+    bool activated = false;
+    LoadTimer<kModelLoadPhaseCount> modelLoadTimer;
+    LoadTimer<kCabinetLoadPhaseCount> cabinetLoadTimer;
+    String lastModelLoad, lastCabinetLoad;
+    String loadLogFilename;
+   #if AIDAX_WITH_BAKED_EQ
+    CabinetEqBaker cabinetEqBaker;
+    std::atomic<bool> cabinetReplaced { false };
+    // changes along with the tone control coefficients, baked impulses are tagged with it
+    uint32_t eqGeneration = 1;
+    uint32_t eqStableFrames = 0;
+    uint32_t eqBakeHoldFrames = 0;
+    // tag of the impulses used by the convolver, 0 for the plain ones
+    uint32_t cabinetEqTag = 0;
+    uint32_t eqFadeInFrames = 0;
+   #endif
    #if AIDAX_WITH_AUDIOFILE
-    AudioFile* audiofile = nullptr;
+    AudioFileStream* audiofile = nullptr;
     std::atomic<bool> activeAudiofile { false };
+   #ifndef DISTRHO_OS_WASM
+    AudioFileStreamReader audiofileReader;
+   #endif
    #endif
 
 public:
@@ -323,6 +1071,7 @@ public:
         // initialize
         bufferSizeChanged(getBufferSize());
         sampleRateChanged(getSampleRate());
+        updateMonitorConfiguration();
 
         // load default model
         loadDefaultModel();
@@ -330,13 +1079,30 @@ public:
 
     ~AidaDSPLoaderPlugin()
     {
+       #if AIDAX_WITH_BAKED_EQ
+        {
+            const MutexLocker cml(cabinetEqBaker.getMutex());
+            cabinetEqBaker.setCabinet(nullptr, nullptr, 0);
+        }
+       #endif
+
         delete model;
         delete cabsim;
+        delete cabsimRight;
+       #ifndef DISTRHO_OS_WASM
+        if (modelBatch != nullptr)
+            ModelBatchGroup::release(modelBatch);
+       #endif
        #if AIDAX_WITH_AUDIOFILE
+       #ifndef DISTRHO_OS_WASM
+        audiofileReader.setStream(nullptr);
+       #endif
         delete audiofile;
        #endif
         delete[] bypassInplaceBuffer;
+        delete[] bypassInplaceBufferRight;
         delete[] cabsimInplaceBuffer;
+        delete[] cabsimInplaceBufferRight;
     }
 
 protected:
@@ -470,6 +1236,33 @@ protected:
             state.fileTypes = "cabsim";
            #endif
             break;
+        case kStateImpulseFile2:
+            state.hints = kStateIsFilenamePath;
+            state.key = "cabinet2";
+            state.defaultValue = "";
+            state.label = "Cabinet Impulse Response 2";
+            state.description = "Blended with the main cabinet impulse response";
+           #ifdef __MOD_DEVICES__
+            state.fileTypes = "cabsim";
+           #endif
+            break;
+        case kStateImpulseFile3:
+            state.hints = kStateIsFilenamePath;
+            state.key = "cabinet3";
+            state.defaultValue = "";
+            state.label = "Cabinet Impulse Response 3";
+            state.description = "Blended with the main cabinet impulse response";
+           #ifdef __MOD_DEVICES__
+            state.fileTypes = "cabsim";
+           #endif
+            break;
+        case kStateCabinetLatency:
+            state.hints = kStateIsOnlyForDSP;
+            state.key = "cabinet-latency";
+            state.defaultValue = "false";
+            state.label = "Cabinet Latency";
+            state.description = "Delays the output while a cabinet is active, for a lighter audio thread";
+            break;
        #if AIDAX_WITH_AUDIOFILE
         case kStateAudioFile:
             state.hints = kStateIsFilenamePath;
@@ -505,12 +1298,10 @@ protected:
     {
         parameters[index] = value;
 
-        const double sampleRate = getSampleRate();
-
         switch (static_cast<Parameters>(index))
         {
         case kParameterINLPF:
-            aida.in_lpf.setFc(MAP(value, 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+            aida.setDirty(AidaToneControl::kFilterInputLPF);
             enabledLPF = d_isNotZero(value);
             break;
         case kParameterINLEVEL:
@@ -526,34 +1317,35 @@ protected:
             aida.eq_pos = value > 0.5f ? kEqPre : kEqPost;
             break;
         case kParameterBASSGAIN:
-            aida.bass.setPeakGain(value);
+            aida.setDirty(AidaToneControl::kFilterBass);
             break;
         case kParameterBASSFREQ:
-            aida.bass.setFc(value / sampleRate);
+            aida.setDirty(AidaToneControl::kFilterBass);
             break;
         case kParameterMIDGAIN:
-            aida.mid.setPeakGain(value);
+            aida.setDirty(AidaToneControl::kFilterMid);
             break;
         case kParameterMIDFREQ:
-            aida.mid.setFc(value / sampleRate);
+            aida.setDirty(AidaToneControl::kFilterMid);
             break;
         case kParameterMIDQ:
-            aida.mid.setQ(value);
+            aida.setDirty(AidaToneControl::kFilterMid);
             break;
         case kParameterMTYPE:
             aida.mid_type = value > 0.5f ? kMidEqBandpass : kMidEqPeak;
+            aida.setDirty(AidaToneControl::kFilterMid);
             break;
         case kParameterTREBLEGAIN:
-            aida.treble.setPeakGain(value);
+            aida.setDirty(AidaToneControl::kFilterTreble);
             break;
         case kParameterTREBLEFREQ:
-            aida.treble.setFc(value / sampleRate);
+            aida.setDirty(AidaToneControl::kFilterTreble);
             break;
         case kParameterDEPTH:
-            aida.depth.setPeakGain(value);
+            aida.setDirty(AidaToneControl::kFilterDepth);
             break;
         case kParameterPRESENCE:
-            aida.presence.setPeakGain(value);
+            aida.setDirty(AidaToneControl::kFilterPresence);
             break;
         case kParameterOUTLEVEL:
             aida.outlevel.setTargetValue(DB_CO(value));
@@ -573,9 +1365,35 @@ protected:
         case kParameterDCBLOCKER:
             enabledDC = value > 0.5f;
             break;
+        case kParameterCABIR1LEVEL:
+        case kParameterCABIR2LEVEL:
+        case kParameterCABIR3LEVEL:
+            updateCabinetWeights();
+            break;
         case kParameterModelInputSize:
         case kParameterMeterIn:
         case kParameterMeterOut:
+        case kParameterActiveStages:
+        case kParameterLoadInput:
+        case kParameterLoadModel:
+        case kParameterLoadDCBlocker:
+        case kParameterLoadCabinet:
+        case kParameterLoadToneControls:
+        case kParameterLoadOutput:
+        case kParameterLoadTotal:
+        case kParameterPeakInput:
+        case kParameterPeakModel:
+        case kParameterPeakDCBlocker:
+        case kParameterPeakCabinet:
+        case kParameterPeakToneControls:
+        case kParameterPeakOutput:
+        case kParameterPeakTotal:
+        case kParameterOverruns:
+        case kParameterWorstLoad:
+        case kParameterModelLoadTime:
+        case kParameterModelLoadSlowest:
+        case kParameterCabinetLoadTime:
+        case kParameterCabinetLoadSlowest:
         case kParameterCount:
             break;
         }
@@ -588,13 +1406,148 @@ protected:
             resetMeters.store(true);
             return;
         }
+        // set by offline renderers before loading anything, processing then never trades accuracy for time
+        if (std::strcmp(key, "offline") == 0)
+        {
+            DISTRHO_SAFE_ASSERT_RETURN(value != nullptr,);
+            offline = std::strcmp(value, "true") == 0;
+            updateCabinetDelayedOutput();
+            return;
+        }
+        if (std::strcmp(key, "cabinet-latency") == 0)
+        {
+            DISTRHO_SAFE_ASSERT_RETURN(value != nullptr,);
+            cabinetLatencyEnabled = std::strcmp(value, "true") == 0;
+            updateCabinetDelayedOutput();
+            return;
+        }
+       #ifndef DISTRHO_OS_WASM
+        // set by hosts running many instances in parallel, before activating any of them.
+        // the value is "SLOT/COUNT:GROUP:MODEL", this instance takes SLOT of the COUNT members of the group named
+        // "GROUP:MODEL" and runs the model file MODEL (empty for the built-in one) through it, see ModelBatchGroup
+        if (std::strcmp(key, "model-batch") == 0)
+        {
+            DISTRHO_SAFE_ASSERT_RETURN(value != nullptr,);
+            DISTRHO_SAFE_ASSERT_RETURN(! activated,);
+
+            if (modelBatch != nullptr)
+            {
+                ModelBatchGroup::release(modelBatch);
+                modelBatch = nullptr;
+            }
+
+            uint slot, count;
+            int offset = 0;
+            const char* groupName;
+            const char* modelName;
+
+            if (std::sscanf(value, "%u/%u:%n", &slot, &count, &offset) != 2 || offset == 0 || slot >= count
+                || (modelName = std::strchr(groupName = value + offset, ':')) == nullptr)
+            {
+                d_stderr2("Invalid model batch: %s", value);
+                return;
+            }
+
+            modelBatch = ModelBatchGroup::acquire(groupName, count);
+            DISTRHO_SAFE_ASSERT_RETURN(modelBatch != nullptr,);
+
+            modelBatchSlot = slot;
+            modelBatchModel = modelName + 1;
+            modelBatch->prepare(static_cast<uint32_t>(modelBatchInputs.size() / BatchedModel::kMaxInputSize));
+
+            // the model already loaded joins the group if it is the one named
+            if (model != nullptr && modelFilename == modelBatchModel)
+                reloadModel();
+            return;
+        }
+        if (std::strcmp(key, "worker-diagnostics") == 0)
+        {
+            d_stdout("%s", ConvolverWorkerPool::getDiagnostics().buffer());
+
+            if (cabsim != nullptr)
+            {
+                TwoStageThreadedConvolver::Stats stats;
+                cabsim->getStats(stats);
+                d_stdout("cabinet tail: %u late (total %.3f ms, max %.3f ms), %u stalls",
+                         stats.numLateBlocks,
+                         static_cast<double>(stats.totalLateTime) / 1e6,
+                         static_cast<double>(stats.maxLateTime) / 1e6,
+                         stats.numStalls);
+            }
+            return;
+        }
+       #endif
+        // recent events of all threads in the Chrome trace event format, written to the given file
+        if (std::strcmp(key, "trace-dump") == 0)
+        {
+            DISTRHO_SAFE_ASSERT_RETURN(value != nullptr && value[0] != '\0',);
+
+            if (TraceRecorder::writeChromeTrace(value))
+                d_stdout("Trace written to %s", value);
+            return;
+        }
+        // report of the deadline monitor, written to the given file or stdout
+        if (std::strcmp(key, "deadline-report") == 0)
+        {
+            static const char* const kStageNames[kProfileCount] = {
+                "input", "model", "dc blocker", "cabinet", "tone controls", "output"
+            };
+
+            const String report(deadlineMonitor.getReport(kStageNames, kProfileCount));
+
+            if (value == nullptr || value[0] == '\0')
+            {
+                d_stdout("%s", report.buffer());
+                return;
+            }
+
+            FILE* const fd = std::fopen(value, "w");
+            DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr,);
+
+            std::fputs(report.buffer(), fd);
+            std::fclose(fd);
+            return;
+        }
+        // phases of the last model and cabinet loads, written to the given file or stdout
+        if (std::strcmp(key, "load-report") == 0)
+        {
+            String report;
+
+            if (lastModelLoad.isNotEmpty())
+                report += lastModelLoad + "\n";
+            if (lastCabinetLoad.isNotEmpty())
+                report += lastCabinetLoad + "\n";
+
+            if (value == nullptr || value[0] == '\0')
+            {
+                d_stdout("%s", report.buffer());
+                return;
+            }
+
+            FILE* const fd = std::fopen(value, "w");
+            DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr,);
+
+            std::fputs(report.buffer(), fd);
+            std::fclose(fd);
+            return;
+        }
+        // file to append the phases of every load to from now on, empty to stop
+        if (std::strcmp(key, "load-log") == 0)
+        {
+            loadLogFilename = value;
+            return;
+        }
 
         const bool isDefault = value == nullptr || value[0] == '\0' || std::strcmp(value, "default") == 0;
 
         if (std::strcmp(key, "json") == 0)
             return isDefault ? loadDefaultModel() : loadModelFromFile(value);
         if (std::strcmp(key, "cabinet") == 0)
-            return isDefault ? loadDefaultCabinet() : loadCabinetFromFile(value);
+            return isDefault ? loadDefaultCabinet() : loadCabinetFromFile(value, 0);
+        if (std::strcmp(key, "cabinet2") == 0)
+            return isDefault ? unloadCabinet(1) : loadCabinetFromFile(value, 1);
+        if (std::strcmp(key, "cabinet3") == 0)
+            return isDefault ? unloadCabinet(2) : loadCabinetFromFile(value, 2);
        #if AIDAX_WITH_AUDIOFILE
         if (std::strcmp(key, "audiofile") == 0)
             return loadAudioFile(value);
@@ -604,6 +1557,17 @@ protected:
    /* -----------------------------------------------------------------------------------------------------------------
     * Model loader */
 
+    // loads the current model again, such as for having it set up for another configuration
+    void reloadModel()
+    {
+        const String filename(modelFilename);
+
+        if (filename.isNotEmpty())
+            loadModelFromFile(filename);
+        else
+            loadDefaultModel();
+    }
+
     void loadDefaultModel()
     {
         using namespace Files;
@@ -611,7 +1575,7 @@ protected:
         try {
             std::istrstream jsonStream(static_cast<const char*>(static_cast<const void*>(tw40_california_clean_deerinkstudiosData)),
                                        tw40_california_clean_deerinkstudiosDataSize);
-            loadModelFromStream(jsonStream);
+            loadModelFromStream(jsonStream, nullptr);
         }
         catch (const std::exception& e) {
             d_stderr2("Unable to load json, error: %s", e.what());
@@ -622,14 +1586,15 @@ protected:
     {
         try {
             std::ifstream jsonStream(filename, std::ifstream::binary);
-            loadModelFromStream(jsonStream);
+            loadModelFromStream(jsonStream, filename);
         }
         catch (const std::exception& e) {
             d_stderr2("Unable to load json file: %s\nError: %s", filename, e.what());
         };
     }
 
-    void loadModelFromStream(std::istream& jsonStream)
+    // filename is null for the built-in model
+    void loadModelFromStream(std::istream& jsonStream, const char* const filename)
     {
         int input_size;
         int input_skip;
@@ -637,8 +1602,16 @@ protected:
         float output_gain;
         nlohmann::json model_json;
 
+        modelLoadTimer.start();
+
         try {
-            jsonStream >> model_json;
+            const TraceScope ts("model parse");
+
+            const std::string jsonText((std::istreambuf_iterator<char>(jsonStream)), std::istreambuf_iterator<char>());
+            modelLoadTimer.mark(kModelLoadRead);
+
+            std::istrstream jsonTextStream(jsonText.data(), static_cast<std::streamsize>(jsonText.size()));
+            jsonTextStream >> model_json;
 
             /* Understand which model type to load */
             input_size = model_json["in_shape"].back().get<int>();
@@ -668,6 +1641,8 @@ protected:
             else {
                 output_gain = 1.0f;
             }
+
+            modelLoadTimer.mark(kModelLoadParse);
         }
         catch (const std::exception& e) {
             d_stderr2("Unable to load json, error: %s", e.what());
@@ -677,20 +1652,65 @@ protected:
         std::unique_ptr<DynamicModel> newmodel = std::make_unique<DynamicModel>();
 
         try {
+            const TraceScope ts("model create");
+
             if (! custom_model_creator (model_json, newmodel->variant))
                 throw std::runtime_error ("Unable to identify a known model architecture!");
 
-            std::visit (
-                [&model_json] (auto&& custom_model)
-                {
-                    using ModelType = std::decay_t<decltype (custom_model)>;
-                    if constexpr (! std::is_same_v<ModelType, NullModel>)
+            modelLoadTimer.mark(kModelLoadDetect);
+
+            const auto parseWeights = [&model_json] (ModelVariantType& variant)
+            {
+                std::visit (
+                    [&model_json] (auto&& custom_model)
                     {
-                        custom_model.parseJson (model_json, true);
-                        custom_model.reset();
-                    }
-                },
-                newmodel->variant);
+                        using ModelType = std::decay_t<decltype (custom_model)>;
+                        if constexpr (! std::is_same_v<ModelType, NullModel>)
+                        {
+                            custom_model.parseJson (model_json, true);
+                            custom_model.reset();
+                        }
+                    },
+                    variant);
+            };
+
+            parseWeights(newmodel->variant);
+
+            // linked stereo runs both channels through the batched model, or through two copies of the model if
+            // the batched one can't be loaded. mono needs neither, ioChanged() reloads the model when that changes
+            if (isStereoAU)
+            {
+                bool batched;
+
+                try {
+                    batched = newmodel->stereo.load(model_json, 2);
+                }
+                catch (const std::exception& e) {
+                    d_stderr2("Unable to batch the model for stereo processing: %s", e.what());
+                    batched = false;
+                }
+
+                if (! batched)
+                {
+                    custom_model_creator (model_json, newmodel->variantRight);
+                    parseWeights(newmodel->variantRight);
+                }
+            }
+           #ifndef DISTRHO_OS_WASM
+            // the model named by the batch group runs through it, the other members then wait for this one every
+            // cycle, so that can only be set up before processing starts
+            else if (modelBatch != nullptr && ! activated && modelBatchModel == (filename != nullptr ? filename : ""))
+            {
+                try {
+                    newmodel->batched = modelBatch->load(modelBatchModel, model_json);
+                }
+                catch (const std::exception& e) {
+                    d_stderr2("Unable to batch the model with other instances: %s", e.what());
+                }
+            }
+           #endif
+
+            modelLoadTimer.mark(kModelLoadWeights);
         }
         catch (const std::exception& e) {
             d_stderr2("Error loading model: %s", e.what());
@@ -707,21 +1727,60 @@ protected:
         newmodel->output_gain = output_gain;
 
         // Pre-buffer to avoid "clicks" during initialization
-        float out[2048] = {};
-        applyModel(newmodel.get(), out, ARRAY_SIZE(out), param1, param2);
+        {
+            const TraceScope ts("model warm-up");
+
+            float out[2048] = {};
+
+           #ifndef DISTRHO_OS_WASM
+            if (newmodel->batched)
+                applyModelBatched(newmodel.get(), *modelBatch, modelBatchSlot, modelBatchInputs.data(),
+                                  out, ARRAY_SIZE(out), param1, param2, true);
+            else
+           #endif
+            applyModel(newmodel.get(), newmodel->variant, out, ARRAY_SIZE(out), param1, param2);
+
+            if (isStereoAU)
+            {
+                float outRight[2048] = {};
+                std::memset(out, 0, sizeof(out));
+                applyModelStereo(newmodel.get(), out, outRight, ARRAY_SIZE(out), param1, param2);
+            }
+
+            modelLoadTimer.mark(kModelLoadWarmUp);
+        }
 
         // swap active model
         DynamicModel* const oldmodel = model;
         model = newmodel.release();
 
         // if processing, wait for process cycle to complete
-        while (oldmodel != nullptr && activeModel.load())
-            d_msleep(1);
+        {
+            const TraceScope ts("model swap wait");
+
+            while (oldmodel != nullptr && activeModel.load())
+                d_msleep(1);
+        }
 
         // report model in dim
         parameters[kParameterModelInputSize] = input_size;
 
         delete oldmodel;
+
+        modelLoadTimer.mark(kModelLoadSwapWait);
+
+        modelFilename = filename != nullptr ? filename : "";
+        updateMonitorConfiguration();
+
+        if (modelLoadTimer.finish())
+        {
+            parameters[kParameterModelLoadTime] = modelLoadTimer.getTotalTime();
+            parameters[kParameterModelLoadSlowest] = modelLoadTimer.getSlowestPhase();
+
+            lastModelLoad = modelLoadTimer.getSummary("model", filename != nullptr ? filename : "default",
+                                                      kModelLoadPhaseNames);
+            logLoad(lastModelLoad);
+        }
     }
 
    /* -----------------------------------------------------------------------------------------------------------------
@@ -731,6 +1790,18 @@ protected:
     {
         using namespace Files;
 
+        cabinetLoadTimer.start();
+
+        const uint64_t sourceHash = IRCache::hash(V30_P2_audix_i5_deerinkstudiosData,
+                                                  V30_P2_audix_i5_deerinkstudiosDataSize);
+
+        if (loadCabinetFromCache(sourceHash, 0))
+        {
+            setCabinetFilename(0, "");
+            finishCabinetLoad(0);
+            return;
+        }
+
         uint channels;
         uint sampleRate;
         drwav_uint64 numFrames;
@@ -743,35 +1814,149 @@ protected:
         DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr,);
         DISTRHO_SAFE_ASSERT_RETURN(channels == 1,);
 
-        loadCabinet(channels, sampleRate, numFrames, ir);
+        cabinetLoadTimer.mark(kCabinetLoadDecode);
+
+        loadCabinet(channels, sampleRate, numFrames, ir, sourceHash, 0);
+
+        setCabinetFilename(0, "");
+        finishCabinetLoad(0);
     }
 
-    void loadCabinetFromFile(const char* const filename)
+    void loadCabinetFromFile(const char* const filename, const uint slot)
     {
+        cabinetLoadTimer.start();
+
+        uint64_t sourceHash;
+        DISTRHO_SAFE_ASSERT_RETURN(IRCache::hashFile(filename, sourceHash),);
+
+        if (loadCabinetFromCache(sourceHash, slot))
+        {
+            setCabinetFilename(slot, filename);
+            finishCabinetLoad(slot);
+            return;
+        }
+
         uint channels;
         uint sampleRate;
         drwav_uint64 numFrames;
         const size_t valuelen = std::strlen(filename);
 
         float* ir;
+        TraceRecorder::begin("cabinet decode");
         if (::strncasecmp(filename + std::max(0, static_cast<int>(valuelen) - 5), ".flac", 5) == 0)
             ir = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
         else
             ir = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+        TraceRecorder::end();
         DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr,);
 
-        loadCabinet(channels, sampleRate, numFrames, ir);
+        cabinetLoadTimer.mark(kCabinetLoadDecode);
+
+        loadCabinet(channels, sampleRate, numFrames, ir, sourceHash, slot);
+
+        setCabinetFilename(slot, filename);
+        finishCabinetLoad(slot);
+    }
+
+    void unloadCabinet(const uint slot)
+    {
+        setCabinetFilename(slot, "");
+
+        if (cabinetImpulses[slot] == nullptr)
+            return;
+
+        cabinetImpulses[slot] = nullptr;
+        updateCabinet();
+    }
+
+    void setCabinetFilename(const uint slot, const char* const filename)
+    {
+        cabsimFilenames[slot] = filename;
+        updateMonitorConfiguration();
+    }
+
+    // files and channel layout, reported with the worst blocks of the deadline monitor
+    void updateMonitorConfiguration()
+    {
+        String description("model ");
+
+        if (model == nullptr)
+            description += "none";
+        else
+            description += modelFilename.isNotEmpty() ? modelFilename.buffer() : "default";
+
+        for (uint i = 0; i < kCabinetSlots; ++i)
+        {
+            if (cabinetImpulses[i] == nullptr)
+                continue;
+
+            description += i == 0 ? ", cabinet " : " + ";
+            description += cabsimFilenames[i].isNotEmpty() ? cabsimFilenames[i].buffer() : "default";
+        }
+
+        description += isStereoAU ? ", linked stereo" : ", mono";
+
+        deadlineMonitor.setConfiguration(description);
+    }
+
+    // publishes the phases of a successful cabinet load started by cabinetLoadTimer.start()
+    void finishCabinetLoad(const uint slot)
+    {
+        if (! cabinetLoadTimer.finish())
+            return;
+
+        parameters[kParameterCabinetLoadTime] = cabinetLoadTimer.getTotalTime();
+        parameters[kParameterCabinetLoadSlowest] = cabinetLoadTimer.getSlowestPhase();
+
+        String what("cabinet");
+        if (slot != 0)
+            what += String(slot + 1);
+
+        lastCabinetLoad = cabinetLoadTimer.getSummary(what, cabsimFilenames[slot].isNotEmpty() ? cabsimFilenames[slot].buffer()
+                                                                                             : "default",
+                                                      kCabinetLoadPhaseNames);
+        logLoad(lastCabinetLoad);
+    }
+
+    // only written if asked for with the load-log state, load-report gives the last ones on demand
+    void logLoad(const String& summary)
+    {
+        if (loadLogFilename.isEmpty())
+            return;
+
+        FILE* const fd = std::fopen(loadLogFilename, "a");
+        DISTRHO_SAFE_ASSERT_RETURN(fd != nullptr,);
+
+        std::fprintf(fd, "%s\n", summary.buffer());
+        std::fclose(fd);
+    }
+
+    bool loadCabinetFromCache(const uint64_t sourceHash, const uint slot)
+    {
+        const TraceScope ts("cabinet cache load");
+        const std::shared_ptr<const ConvolverImpulse> impulse = IRCache::load(sourceHash, getSampleRate(), TwoStageThreadedConvolver::kHeadLength);
+
+        if (impulse == nullptr)
+            return false;
+
+        // shows up as the cache phase in the load report and log
+        cabinetLoadTimer.mark(kCabinetLoadCache);
 
-        cabsimFilename = filename;
+        cabinetImpulses[slot] = impulse;
+        updateCabinet();
+        return true;
     }
 
-    void loadCabinet(const uint channels, const uint sampleRate, drwav_uint64 numFrames, float* const ir)
+    void loadCabinet(const uint channels, const uint sampleRate, drwav_uint64 numFrames, float* const ir,
+                     const uint64_t sourceHash, const uint slot)
     {
         if (channels > 1)
         {
             for (drwav_uint64 i=0, j=0; j<numFrames; ++i, j+=channels)
                 ir[i] = ir[j];
             numFrames /= channels;
+
+            cabinetLoadTimer.mark(kCabinetLoadFold);
         }
 
         d_stdout("Loading cabinet with %u channels, %u Hz sample rate and %lu frames",
@@ -782,6 +1967,7 @@ protected:
 
         if (sampleRate != hostSampleRate)
         {
+            const TraceScope ts("cabinet resample");
             r8b::CDSPResampler16IR resampler(sampleRate, hostSampleRate, numFrames);
             const int numResampledFrames = resampler.getMaxOutLen(0);
             DISTRHO_SAFE_ASSERT_RETURN(numResampledFrames > 0,);
@@ -794,25 +1980,228 @@ protected:
             irBuf = irBufResampled;
 
             numFrames = numResampledFrames;
+
+            cabinetLoadTimer.mark(kCabinetLoadResample);
         }
 
-        TwoStageThreadedConvolver* const newConvolver = new TwoStageThreadedConvolver();
-        newConvolver->init(irBuf, numFrames);
+        TraceRecorder::begin("cabinet partition");
+        const std::shared_ptr<const ConvolverImpulse> impulse =
+            TwoStageThreadedConvolver::createImpulse(irBuf, static_cast<uint32_t>(numFrames), TwoStageThreadedConvolver::kHeadLength);
+        TraceRecorder::end();
 
         if (irBuf != ir)
             delete[] irBuf;
 
-        drwav_free(ir, nullptr);
+        drwav_free(ir, nullptr);
+
+        DISTRHO_SAFE_ASSERT_RETURN(impulse != nullptr,);
+
+        cabinetLoadTimer.mark(kCabinetLoadPartition);
+
+        IRCache::store(sourceHash, hostSampleRate, impulse);
+
+        cabinetLoadTimer.mark(kCabinetLoadCache);
+
+        cabinetImpulses[slot] = impulse;
+        updateCabinet();
+    }
+
+   #if AIDAX_WITH_BAKED_EQ
+    // Called from the audio thread right after the cabinet convolver ran.
+    // Follows impulse changes reported by the convolver, narrowing the range of samples that need the post EQ,
+    // and requests baked or plain impulses as the tone controls settle or change.
+    void updateCabinetEq(uint32_t& postEqStart, uint32_t& postEqEnd, const uint32_t numSamples,
+                         const uint32_t lastActiveStages)
+    {
+        uint32_t tag;
+        const int32_t change = cabsim->getLastImpulseChange(tag);
+
+        if (change >= 0)
+        {
+            if (cabinetEqTag == 0 && tag != 0)
+            {
+                // baked impulses take over at once, the EQ stage stops right there
+                postEqEnd = change;
+            }
+            else if (cabinetEqTag != 0 && tag == 0)
+            {
+                // plain impulses crossfade in, and so does the EQ stage
+                postEqStart = change;
+                eqFadeInFrames = kEqUnbakeFadeFrames;
+            }
+            else if (tag != 0)
+            {
+                postEqEnd = 0;
+            }
+
+            cabinetEqTag = tag;
+        }
+        else if (cabinetEqTag != 0)
+        {
+            postEqEnd = 0;
+        }
+
+        const bool postEq = !aida.eq_bypass && aida.eq_pos == kEqPost;
+
+        if (! isSettledAt(cabsimGain, kCabinetMaxGain))
+        {
+            // the dry signal mixed in while the cabinet fades lacks the EQ that baked impulses carry
+            if (cabinetEqTag != 0 && postEq)
+            {
+                if ((lastActiveStages & kStagePostEq) == 0)
+                    aida.resetToneControls();
+
+                if (applyToneControls(aida, cabsimInplaceBuffer, numSamples))
+                    activeStages |= kStagePostEq;
+            }
+
+            return;
+        }
+
+        if (eqFadeInFrames != 0 || ! cabinetEqBaker.isIdle())
+            return;
+
+        Biquad* filters[5];
+        const uint numFilters = postEq && eqStableFrames >= eqBakeHoldFrames ? aida.getAudibleFilters(filters) : 0;
+        const uint32_t wantedTag = numFilters != 0 ? eqGeneration : 0;
+
+        if (wantedTag == cabinetEqTag || (wantedTag != 0 && wantedTag == cabinetEqBaker.getFailedTag()))
+            return;
+
+        CabinetEqBaker::Request& request(cabinetEqBaker.getRequest());
+
+        for (uint i = 0; i < numFilters; ++i)
+            request.filters[i] = *filters[i];
+
+        request.numFilters = numFilters;
+        request.tag = wantedTag;
+        cabinetEqBaker.submit();
+    }
+   #endif
+
+    // blend weights follow the level of each loaded IR, normalized so that the blend keeps unity gain
+    void updateCabinetWeights()
+    {
+        float sum = 0.f;
+
+        for (uint i = 0; i < kCabinetSlots; ++i)
+        {
+            cabinetWeights[i] = cabinetImpulses[i] != nullptr ? parameters[kParameterCABIR1LEVEL + i] : 0.f;
+            sum += cabinetWeights[i];
+        }
+
+        for (uint i = 0; i < kCabinetSlots; ++i)
+            cabinetWeights[i] = sum > 0.f ? cabinetWeights[i] / sum : 0.f;
+    }
+
+    // with @a inPlace the running convolvers take the new impulses if they can, otherwise new ones replace them
+    void updateCabinet(const bool inPlace = true)
+    {
+        uint numImpulses = 0;
+
+        for (uint i = 0; i < kCabinetSlots; ++i)
+        {
+            if (cabinetImpulses[i] != nullptr)
+                numImpulses = i + 1;
+        }
+
+        if (numImpulses == 0)
+            return;
+
+        updateCabinetWeights();
+
+       #if AIDAX_WITH_BAKED_EQ
+        // the baker applies its impulses to the convolver while holding this lock
+        const MutexLocker cml(cabinetEqBaker.getMutex());
+       #endif
+
+        const bool stereo = isStereoAU;
+
+        // crossfade into the new impulses within the running convolver if possible, keeping its input history.
+        // in stereo both convolvers run in lockstep and the change is handed over to both on the same block,
+        // or to none of them, a new pair being created then
+        if (inPlace && cabsim != nullptr && ! stereo && cabsim->setImpulses(cabinetImpulses, numImpulses))
+        {
+           #if AIDAX_WITH_BAKED_EQ
+            cabinetEqBaker.setCabinet(cabsim, cabinetImpulses, numImpulses);
+           #endif
+            cabinetLoadTimer.mark(kCabinetLoadConvolverInit);
+            return;
+        }
+
+        if (inPlace && cabsim != nullptr && stereo && cabsimRight != nullptr
+            && cabsim->prepareImpulses(cabinetImpulses, numImpulses))
+        {
+            if (cabsimRight->prepareImpulses(cabinetImpulses, numImpulses))
+            {
+                cabinetImpulsesPrepared.store(true);
+                cabinetLoadTimer.mark(kCabinetLoadConvolverInit);
+                return;
+            }
+
+            cabsim->cancelImpulses();
+        }
+
+        TwoStageThreadedConvolver* const newConvolver = createConvolver(numImpulses);
+
+        if (newConvolver == nullptr)
+            return;
+
+        TwoStageThreadedConvolver* newConvolverRight = nullptr;
+
+        if (stereo)
+        {
+            newConvolverRight = createConvolver(numImpulses);
+
+            if (newConvolverRight == nullptr)
+            {
+                delete newConvolver;
+                return;
+            }
+        }
+
+        cabinetLoadTimer.mark(kCabinetLoadConvolverInit);
 
         // swap active cabsim
         TwoStageThreadedConvolver* const oldcabsim = cabsim;
+        TwoStageThreadedConvolver* const oldcabsimRight = cabsimRight;
         cabsim = newConvolver;
+        cabsimRight = newConvolverRight;
+
+       #if AIDAX_WITH_BAKED_EQ
+        cabinetEqBaker.setCabinet(cabsim, cabinetImpulses, numImpulses);
+        cabinetReplaced.store(true);
+       #endif
 
         // if processing, wait for process cycle to complete
-        while (oldcabsim != nullptr && activeConvolver.load())
-            d_msleep(1);
+        {
+            const TraceScope ts("cabinet swap wait");
+
+            while ((oldcabsim != nullptr || oldcabsimRight != nullptr) && activeConvolver.load())
+                d_msleep(1);
+        }
 
         delete oldcabsim;
+        delete oldcabsimRight;
+
+        cabinetLoadTimer.mark(kCabinetLoadSwapWait);
+    }
+
+    TwoStageThreadedConvolver* createConvolver(const uint numImpulses)
+    {
+        const TraceScope ts("convolver init");
+        TwoStageThreadedConvolver* const convolver = new TwoStageThreadedConvolver();
+        convolver->setSampleRate(getSampleRate());
+        convolver->setDelayedOutput(cabinetDelayedOutput);
+        convolver->setMaxBlockSize(getBufferSize());
+
+        if (! convolver->init(cabinetImpulses, numImpulses, cabinetWeights))
+        {
+            delete convolver;
+            return nullptr;
+        }
+
+        return convolver;
     }
 
    #if AIDAX_WITH_AUDIOFILE
@@ -824,50 +2213,16 @@ public:
     {
         d_stdout("Loading filename %s", filename);
 
-        uint channels;
-        uint sampleRate;
-        drwav_uint64 numFrames;
-        float* data;
-        if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
-            data = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        else
-            data = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        DISTRHO_SAFE_ASSERT_RETURN(data != nullptr,);
-
-        // use left channel if not mono
-        if (channels > 1)
-        {
-            for (drwav_uint64 i=0, j=0; j<numFrames; ++i, j+=channels)
-                data[i] = data[j];
-            numFrames /= channels;
-        }
-
-        const double hostSampleRate = getSampleRate();
-
-        float* dataResampled;
-        if (sampleRate != hostSampleRate)
-        {
-            r8b::CDSPResampler24 resampler(sampleRate, hostSampleRate, numFrames);
-            const int numResampledFrames = resampler.getMaxOutLen(0);
-            DISTRHO_SAFE_ASSERT_RETURN(numResampledFrames > 0,);
-
-            dataResampled = new float[numResampledFrames];
-            resampler.oneshot(data, numFrames, dataResampled, numResampledFrames);
-
-            numFrames = numResampledFrames;
-        }
-        else
-        {
-            dataResampled = data;
-        }
-
-        if (dataResampled != data)
-            drwav_free(data, nullptr);
+        // decoded while playing, only the start of the file is read here
+        AudioFileStream* const newaudiofile = AudioFileStream::open(filename, getSampleRate());
+        DISTRHO_SAFE_ASSERT_RETURN(newaudiofile != nullptr,);
 
-        // swap active cabsim
-        AudioFile* const newaudiofile = new AudioFile(dataResampled, numFrames, dataResampled != data);
-        AudioFile* const oldaudiofile = audiofile;
+        // swap active audio file
+        AudioFileStream* const oldaudiofile = audiofile;
         audiofile = newaudiofile;
+       #ifndef DISTRHO_OS_WASM
+        audiofileReader.setStream(newaudiofile);
+       #endif
 
         // if processing, wait for process cycle to complete
         while (oldaudiofile != nullptr && activeAudiofile.load())
@@ -892,6 +2247,11 @@ protected:
         bypassGain.clearToTargetValue();
         cabsimGain.clearToTargetValue();
         resetMeters.store(true);
+        silentFrames = 0;
+        cabinetDryDelay.clear();
+        cabinetDryDelayRight.clear();
+        bypassDryDelay.clear();
+        bypassDryDelayRight.clear();
 
         if (model != nullptr)
         {
@@ -900,25 +2260,52 @@ protected:
 
             activeModel.store(true);
 
-            std::visit (
-                [] (auto&& custom_model)
-                {
-                    using ModelType = std::decay_t<decltype (custom_model)>;
-                    if constexpr (! std::is_same_v<ModelType, NullModel>)
+            for (ModelVariantType* const variant : { &model->variant, &model->variantRight })
+            {
+                std::visit (
+                    [] (auto&& custom_model)
                     {
-                        custom_model.reset();
-                    }
-                },
-                model->variant);
+                        using ModelType = std::decay_t<decltype (custom_model)>;
+                        if constexpr (! std::is_same_v<ModelType, NullModel>)
+                        {
+                            custom_model.reset();
+                        }
+                    },
+                    *variant);
+            }
 
             param1.clearToTargetValue();
             param2.clearToTargetValue();
             paramFirstRun = true;
 
-            applyModel(model, out, ARRAY_SIZE(out), param1, param2);
+           #ifndef DISTRHO_OS_WASM
+            if (model->batched)
+                applyModelBatched(model, *modelBatch, modelBatchSlot, modelBatchInputs.data(),
+                                  out, ARRAY_SIZE(out), param1, param2, true);
+            else
+           #endif
+            applyModel(model, model->variant, out, ARRAY_SIZE(out), param1, param2);
+
+            if (isStereoAU)
+            {
+                float outRight[2048] = {};
+                std::memset(out, 0, sizeof(out));
+                model->stereo.reset();
+                applyModelStereo(model, out, outRight, ARRAY_SIZE(out), param1, param2);
+            }
 
             activeModel.store(false);
         }
+
+        activated = true;
+    }
+
+   /**
+      Deactivate this plugin.
+    */
+    void deactivate() override
+    {
+        activated = false;
     }
 
    /**
@@ -931,8 +2318,16 @@ protected:
        #endif
         /* */ float* const out = outputs[0];
 
+        // linked stereo, the right channel runs through the same stages with its own state
+        const bool stereo = isStereoAU;
+        float* const outRight = stereo ? outputs[1] : nullptr;
+
         // optimize for non-denormal usage
         const ScopedDenormalDisable sdd;
+        deadlineMonitor.begin();
+        profiler.begin();
+        TraceRecorder::setThreadName("audio");
+        const TraceScope traceRun("run");
         for (uint32_t i = 0; i < numSamples; ++i)
         {
            #if DISTRHO_PLUGIN_NUM_INPUTS != 0
@@ -943,31 +2338,33 @@ protected:
                 __builtin_unreachable();
         }
 
+        float peakIn = 0.f;
+        float peakOut = 0.f;
+
        #if AIDAX_WITH_AUDIOFILE
         if (audiofile != nullptr)
         {
             activeAudiofile.store(true);
-            const uint32_t numPartialSamples = std::min((uint32_t)(audiofile->numFrames - audiofile->currentFrame), numSamples);
-            std::memcpy(bypassInplaceBuffer, audiofile->buffer + audiofile->currentFrame, sizeof(float) * numPartialSamples);
-
-            if (numSamples != numPartialSamples)
-            {
-                const uint32_t extraSamples = numSamples - numPartialSamples;
-                std::memcpy(bypassInplaceBuffer, audiofile->buffer, sizeof(float) * extraSamples);
-                audiofile->currentFrame = extraSamples;
-            }
-            else
-            {
-                audiofile->currentFrame += numSamples;
-            }
+           #ifdef DISTRHO_OS_WASM
+            // no threads on the web, the file is decoded in small steps right before playing it
+            audiofile->fill(numSamples * 2);
+           #endif
+            audiofile->read(bypassInplaceBuffer, numSamples);
+            peakIn = getPeak(bypassInplaceBuffer, numSamples);
             activeAudiofile.store(false);
+
+            if (stereo)
+                std::memcpy(bypassInplaceBufferRight, bypassInplaceBuffer, sizeof(float)*numSamples);
         }
         else
        #endif
         {
            #if DISTRHO_PLUGIN_NUM_INPUTS != 0
             // Copy input for bypass buffer
-            std::memcpy(bypassInplaceBuffer, in, sizeof(float)*numSamples);
+            peakIn = copyWithPeak(bypassInplaceBuffer, in, numSamples);
+
+            if (stereo)
+                peakIn = std::max(peakIn, copyWithPeak(bypassInplaceBufferRight, inputs[1], numSamples));
            #else
             std::memset(bypassInplaceBuffer, 0, sizeof(float)*numSamples);
            #endif
@@ -988,8 +2385,28 @@ protected:
             tmpMeterFrames += numSamples;
         }
 
-        for (uint32_t i = 0; i < numSamples; ++i)
-            meterIn = std::max(meterIn, std::abs(bypassInplaceBuffer[i]));
+        meterIn = std::max(meterIn, peakIn);
+
+        updateCabinetLatency(stereo);
+
+        // stages that did not run during the previous cycle have their state reset before running again
+        const uint32_t lastActiveStages = activeStages;
+        activeStages = 0;
+        bool sleeping = false;
+        // elementwise stages after the cabinet, run in a single pass at the end
+        OutputStages outputStages = {};
+       #ifndef DISTRHO_OS_WASM
+        // the model batch group waits for every member once per cycle, whether its model runs or not
+        bool modelBatchPending = modelBatch != nullptr;
+       #endif
+        bool cabinet;
+        // with the model bypassed or not loaded, nothing has hidden state that could still be moving
+        bool modelSettled = true;
+       #if AIDAX_WITH_BAKED_EQ
+        // range of output samples that needs the post EQ, the rest has it baked into the cabinet IRs
+        uint32_t postEqStart = 0;
+        uint32_t postEqEnd = numSamples;
+       #endif
 
        #ifdef MOD_BUILD
         // Special handling for MOD web version: stop further audio processing on bypass
@@ -998,23 +2415,148 @@ protected:
             bypassGain.clearToTargetValue();
             goto the_end;
         }
+       #else
+        // Fully bypassed, output the dry signal and skip all processing
+        if (isSettledAt(bypassGain, 0.f))
+        {
+            bypassDryDelay.process(bypassInplaceBuffer, numSamples);
+            std::memcpy(out, bypassInplaceBuffer, sizeof(float)*numSamples);
+            if (stereo)
+            {
+                bypassDryDelayRight.process(bypassInplaceBufferRight, numSamples);
+                std::memcpy(outRight, bypassInplaceBufferRight, sizeof(float)*numSamples);
+            }
+            meterOut = std::max(meterOut, peakIn);
+
+            silentFrames = 0;
+            goto the_end;
+        }
        #endif
 
-        // High frequencies roll-off (lowpass)
-        if (enabledLPF)
-            applyBiquadFilter(aida.in_lpf, out, bypassInplaceBuffer, numSamples);
+        // Sleep after a while of silence, once all tails have decayed and the model has settled, waking up as soon as
+        // the input is not silent.
+        // The idle state is captured by leaving stage states untouched while asleep, nothing else writes to them,
+        // and restored by resuming from them on wake-up. Rather than a copy, that is the state processing would be in
+        // had it continued through the silence: the model hidden state is at the fixed point its constant output
+        // showed, the filters and the convolver history only hold silence. The DC blocker also stays matched to
+        // the model idle output that way, which avoids a click on wake-up
+        if (peakIn <= kSilenceThreshold && silentFrames >= sleepHoldFrames)
+        {
+            std::memset(out, 0, sizeof(float)*numSamples);
+            if (stereo)
+                std::memset(outRight, 0, sizeof(float)*numSamples);
+            activeStages = lastActiveStages;
+            sleeping = true;
+            goto the_end;
+        }
+
+        // Filter coefficients follow parameter changes once per block
+        aida.updateCoefficients(parameters, getSampleRate());
+
+       #if AIDAX_WITH_BAKED_EQ
+        // Impulses baked with other tone control settings no longer apply
+        if ((aida.rampingFilters & ~(1u << AidaToneControl::kFilterInputLPF)) != 0)
+        {
+            eqGeneration = eqGeneration != UINT32_MAX ? eqGeneration + 1 : 1;
+            eqStableFrames = 0;
+        }
         else
-            std::memcpy(out, bypassInplaceBuffer, sizeof(float)*numSamples);
+        {
+            eqStableFrames = std::min(eqStableFrames + numSamples, eqBakeHoldFrames);
+        }
+
+        if (cabinetReplaced.exchange(false))
+        {
+            cabinetEqTag = 0;
+            eqFadeInFrames = 0;
+        }
+       #endif
 
-        // Pre-gain
-        applyGainRamp(aida.inlevel, out, numSamples);
+        // High frequencies roll-off (lowpass) and pre-gain, in a single pass unless the filter is changing
+        {
+            const TraceScope ts("input");
+            const bool inputGain = ! isSettledAt(aida.inlevel, 1.f);
+            const BlockValueSmoother::Ramp inputRamp = aida.inlevel.nextBlock(numSamples);
+
+            if (enabledLPF)
+            {
+                if ((lastActiveStages & kStageInputLPF) == 0)
+                {
+                    aida.in_lpf.reset();
+                    aida.in_lpf_right.reset();
+                }
+
+                if (stereo)
+                {
+                    applyBiquadFilter(aida.in_lpf, aida.in_lpf_right,
+                                      aida.getRampCoefficients(AidaToneControl::kFilterInputLPF),
+                                      out, outRight, bypassInplaceBuffer, bypassInplaceBufferRight, numSamples);
+
+                    if (inputGain)
+                    {
+                        applyGainRamp(inputRamp, out, out, numSamples);
+                        applyGainRamp(inputRamp, outRight, outRight, numSamples);
+                    }
+                }
+                else if (const double* const rampFrom = aida.getRampCoefficients(AidaToneControl::kFilterInputLPF))
+                {
+                    applyBiquadFilter(aida.in_lpf, rampFrom, out, bypassInplaceBuffer, numSamples);
+
+                    if (inputGain)
+                        applyGainRamp(inputRamp, out, out, numSamples);
+                }
+                else if (inputGain)
+                {
+                    applyFilterGainRamp(aida.in_lpf, inputRamp, out, bypassInplaceBuffer, numSamples);
+                }
+                else
+                {
+                    applyBiquadFilter(aida.in_lpf, out, bypassInplaceBuffer, numSamples);
+                }
+
+                activeStages |= kStageInputLPF;
+            }
+            else if (inputGain)
+            {
+                applyGainRamp(inputRamp, out, bypassInplaceBuffer, numSamples);
+                if (stereo)
+                    applyGainRamp(inputRamp, outRight, bypassInplaceBufferRight, numSamples);
+            }
+            else
+            {
+                std::memcpy(out, bypassInplaceBuffer, sizeof(float)*numSamples);
+                if (stereo)
+                    std::memcpy(outRight, bypassInplaceBufferRight, sizeof(float)*numSamples);
+            }
+
+            if (inputGain)
+                activeStages |= kStageInputGain;
+        }
+
+        // the input was taken from it above, from now on it is the dry signal for the bypass mix
+        bypassDryDelay.process(bypassInplaceBuffer, numSamples);
+        if (stereo)
+            bypassDryDelayRight.process(bypassInplaceBufferRight, numSamples);
+
+        profiler.mark(kProfileInput);
 
         // Equalizer section
         if (!aida.eq_bypass && aida.eq_pos == kEqPre)
-            applyToneControls(aida, out, numSamples);
+        {
+            const TraceScope ts("pre eq");
+            if ((lastActiveStages & kStagePreEq) == 0)
+                aida.resetToneControls();
+
+            if (stereo ? applyToneControls(aida, out, outRight, numSamples)
+                       : applyToneControls(aida, out, numSamples))
+                activeStages |= kStagePreEq;
+
+            profiler.mark(kProfileToneControls);
+        }
 
         if (!aida.net_bypass && model != nullptr)
         {
+            const TraceScope ts("model");
             activeModel.store(true);
 
             if (paramFirstRun)
@@ -1024,58 +2566,224 @@ protected:
                 param2.clearToTargetValue();
             }
 
-            applyModel(model, out, numSamples, param1, param2);
+            if (stereo)
+                applyModelStereo(model, out, outRight, numSamples, param1, param2);
+           #ifndef DISTRHO_OS_WASM
+            else if (model->batched && numSamples * BatchedModel::kMaxInputSize <= modelBatchInputs.size())
+            {
+                applyModelBatched(model, *modelBatch, modelBatchSlot, modelBatchInputs.data(),
+                                  out, numSamples, param1, param2);
+                modelBatchPending = false;
+            }
+           #endif
+            else
+                applyModel(model, model->variant, out, numSamples, param1, param2);
             activeModel.store(false);
+            activeStages |= kStageModel;
+
+            // only needed while the input is silent, for going to sleep
+            if (peakIn <= kSilenceThreshold)
+                modelSettled = isSettledBlock(out, numSamples) && (! stereo || isSettledBlock(outRight, numSamples));
+
+            profiler.mark(kProfileModel);
         }
 
-        // DC blocker filter (highpass)
+       #ifndef DISTRHO_OS_WASM
+        // not taking part in this step lets the others go on without waiting for the rest of this cycle
+        if (modelBatchPending)
+        {
+            modelBatch->skip(modelBatchSlot);
+            modelBatchPending = false;
+        }
+       #endif
+
+        // Cabinet convolution, skipped once fully faded out by its bypass
+        cabinet = cabsim != nullptr && (! stereo || cabsimRight != nullptr)
+               && ! isSettledAt(cabsimGain, 0.f);
+
+        // DC blocker filter (highpass), writing straight into the cabinet input
         if (enabledDC)
-            applyBiquadFilter(aida.dc_blocker, out, numSamples);
+        {
+            const TraceScope ts("dc blocker");
+            if ((lastActiveStages & kStageDCBlocker) == 0)
+            {
+                aida.dc_blocker.reset();
+                aida.dc_blocker_right.reset();
+            }
 
-        // Cabinet convolution
-        if (cabsim != nullptr)
+            if (stereo)
+                applyBiquadFilter(aida.dc_blocker, aida.dc_blocker_right, nullptr,
+                                  cabinet ? cabsimInplaceBuffer : out, cabinet ? cabsimInplaceBufferRight : outRight,
+                                  out, outRight, numSamples);
+            else
+                applyBiquadFilter(aida.dc_blocker, cabinet ? cabsimInplaceBuffer : out, out, numSamples);
+            activeStages |= kStageDCBlocker;
+            profiler.mark(kProfileDCBlocker);
+        }
+        else if (cabinet)
         {
             std::memcpy(cabsimInplaceBuffer, out, sizeof(float)*numSamples);
+            if (stereo)
+                std::memcpy(cabsimInplaceBufferRight, outRight, sizeof(float)*numSamples);
+        }
 
+        if (cabinet)
+        {
+            const TraceScope ts("cabinet");
             activeConvolver.store(true);
+            if ((lastActiveStages & kStageCabinet) == 0)
+            {
+                cabsim->reset();
+                if (stereo)
+                    cabsimRight->reset();
+            }
+            if (cabinetImpulsesPrepared.exchange(false))
+            {
+                cabsim->applyImpulses();
+                if (stereo)
+                    cabsimRight->applyImpulses();
+            }
+            cabsim->setWeights(cabinetWeights);
             cabsim->process(cabsimInplaceBuffer, out, numSamples);
+            if (stereo)
+            {
+                cabsimRight->setWeights(cabinetWeights);
+                cabsimRight->process(cabsimInplaceBufferRight, outRight, numSamples);
+            }
             activeConvolver.store(false);
 
+            // the convolver took its input, from now on it is the dry signal for the cabinet mix
+            cabinetDryDelay.process(cabsimInplaceBuffer, numSamples);
+            if (stereo)
+                cabinetDryDelayRight.process(cabsimInplaceBufferRight, numSamples);
+
+           #if AIDAX_WITH_BAKED_EQ
+            // baked impulses are only made for a single convolver, stereo keeps the post EQ stage
+            if (! stereo)
+                updateCabinetEq(postEqStart, postEqEnd, numSamples, lastActiveStages);
+           #endif
+
             // cabsim smooth bypass and -12dB compensation
-            for (uint32_t i = 0; i < numSamples; ++i)
-            {
-                const float b = cabsimGain.next();
-                out[i] = out[i] * b + cabsimInplaceBuffer[i] * ((kCabinetMaxGain - b) / kCabinetMaxGain);
-            }
+            const BlockValueSmoother::Ramp cabinetRamp = cabsimGain.nextBlock(numSamples);
+            outputStages.cabinetDry = cabsimInplaceBuffer;
+            outputStages.cabinetGain = cabinetRamp;
+            outputStages.cabinetDryGain = { 1.f - cabinetRamp.start / kCabinetMaxGain, -cabinetRamp.step / kCabinetMaxGain };
+
+            activeStages |= kStageCabinet;
+            profiler.mark(kProfileCabinet);
+        }
+        else
+        {
+            // keeps the same latency as the cabinet
+            cabinetDryDelay.process(out, numSamples);
+            if (stereo)
+                cabinetDryDelayRight.process(outRight, numSamples);
         }
 
         // Equalizer section
         if (!aida.eq_bypass && aida.eq_pos == kEqPost)
-            applyToneControls(aida, out, numSamples);
+        {
+            const TraceScope ts("post eq");
+            // the cabinet mix goes first, as the EQ runs in between
+           #if AIDAX_WITH_BAKED_EQ
+            if (outputStages.cabinetDry != nullptr && postEqStart < postEqEnd)
+           #else
+            if (outputStages.cabinetDry != nullptr)
+           #endif
+            {
+                applyOutputStages<true, false, false>(outputStages, out, numSamples);
+                if (stereo)
+                    applyOutputStages<true, false, false>(getRightOutputStages(outputStages), outRight, numSamples);
+                outputStages.cabinetDry = nullptr;
+            }
 
-        // Output volume
-        applyGainRamp(aida.outlevel, out, numSamples);
+           #if AIDAX_WITH_BAKED_EQ
+            if (((lastActiveStages | activeStages) & kStagePostEq) == 0)
+                aida.resetToneControls();
 
-        // Bypass and output meter
-        for (uint32_t i = 0; i < numSamples; ++i)
-        {
-           #ifndef MOD_BUILD
-            const float b = bypassGain.next();
-            out[i] = out[i] * b + bypassInplaceBuffer[i] * (1.f - b);
+            if (stereo)
+            {
+                if (applyToneControls(aida, out, outRight, numSamples))
+                    activeStages |= kStagePostEq;
+            }
+            else if (postEqStart < postEqEnd)
+            {
+                float* const postEqOut = out + postEqStart;
+                const uint32_t numPostEqSamples = postEqEnd - postEqStart;
+
+                if (eqFadeInFrames != 0
+                    ? applyToneControlsFadeIn(aida, postEqOut, cabsimInplaceBuffer, numPostEqSamples,
+                                              eqFadeInFrames, kEqUnbakeFadeFrames)
+                    : applyToneControls(aida, postEqOut, numPostEqSamples))
+                    activeStages |= kStagePostEq;
+            }
            #else
-            out[i] *= bypassGain.next();
+            if ((lastActiveStages & kStagePostEq) == 0)
+                aida.resetToneControls();
+
+            if (stereo ? applyToneControls(aida, out, outRight, numSamples)
+                       : applyToneControls(aida, out, numSamples))
+                activeStages |= kStagePostEq;
            #endif
-            meterOut = std::max(meterOut, std::abs(out[i]));
+
+            profiler.mark(kProfileToneControls);
+        }
+
+        // Output volume
+        TraceRecorder::begin("output");
+
+        if (! isSettledAt(aida.outlevel, 1.f))
+            activeStages |= kStageOutputGain;
+
+        outputStages.outputGain = aida.outlevel.nextBlock(numSamples);
+
+        // Bypass
+       #ifndef MOD_BUILD
+        if (! isSettledAt(bypassGain, 1.f))
+        {
+            outputStages.bypassDry = bypassInplaceBuffer;
+            activeStages |= kStageBypassMix;
         }
+       #else
+        activeStages |= kStageBypassMix;
+       #endif
+
+        outputStages.bypassGain = bypassGain.nextBlock(numSamples);
+
+        // Output meter, along with the stages above in a single pass
+        peakOut = applyOutputStages(outputStages, out, numSamples);
+
+        if (stereo)
+            peakOut = std::max(peakOut, applyOutputStages(getRightOutputStages(outputStages), outRight, numSamples));
+
+        TraceRecorder::end();
+
+        meterOut = std::max(meterOut, peakOut);
+
+        if (peakIn <= kSilenceThreshold && peakOut <= kSilenceThreshold && modelSettled)
+            silentFrames = std::min(silentFrames + numSamples, sleepHoldFrames);
+        else
+            silentFrames = 0;
 
-#ifdef MOD_BUILD
 the_end:
-#endif
+       #ifndef DISTRHO_OS_WASM
+        if (modelBatchPending)
+            modelBatch->skip(modelBatchSlot);
+       #endif
+
+        parameters[kParameterActiveStages] = sleeping ? static_cast<uint32_t>(kStageSleeping) : activeStages;
+
+        // output stages, or whatever ran before skipping to here
+        profiler.end(numSamples, kProfileOutput);
+
         if (tmpMeterFrames >= meterMaxFrameCount)
         {
             parameters[kParameterMeterIn] = tmpMeterIn = meterIn;
             parameters[kParameterMeterOut] = tmpMeterOut = meterOut;
             tmpMeterFrames -= meterMaxFrameCount;
+            profiler.publish(parameters + kParameterLoadInput, parameters + kParameterPeakInput);
+            parameters[kParameterOverruns] = deadlineMonitor.getNumOverruns();
+            parameters[kParameterWorstLoad] = deadlineMonitor.getWorstLoad();
         }
         else
         {
@@ -1083,16 +2791,99 @@ the_end:
             tmpMeterOut = meterOut;
         }
 
-        if (isStereoAU || DISTRHO_PLUGIN_NUM_OUTPUTS == 2)
+        // mono source with a stereo output (standalone), both sides get the same signal
+        if (! stereo && DISTRHO_PLUGIN_NUM_OUTPUTS == 2)
             std::memcpy(outputs[1], out, sizeof(float)*numSamples);
+
+        deadlineMonitor.end(numSamples,
+                            static_cast<uint32_t>(parameters[kParameterActiveStages]),
+                            profiler.getSlowestStage());
+    }
+
+    // output stages of the right channel, the same ramps applied to its own dry signals
+    OutputStages getRightOutputStages(const OutputStages& stages) const
+    {
+        OutputStages right(stages);
+
+        if (right.cabinetDry != nullptr)
+            right.cabinetDry = cabsimInplaceBufferRight;
+        if (right.bypassDry != nullptr)
+            right.bypassDry = bypassInplaceBufferRight;
+
+        return right;
     }
 
     void bufferSizeChanged(const uint newBufferSize) override
     {
         delete[] bypassInplaceBuffer;
+        delete[] bypassInplaceBufferRight;
         delete[] cabsimInplaceBuffer;
+        delete[] cabsimInplaceBufferRight;
         bypassInplaceBuffer = new float[newBufferSize];
+        bypassInplaceBufferRight = new float[newBufferSize];
         cabsimInplaceBuffer = new float[newBufferSize];
+        cabsimInplaceBufferRight = new float[newBufferSize];
+
+       #ifndef DISTRHO_OS_WASM
+        // model inputs of a whole cycle, or of a warm-up
+        const uint32_t maxModelFrames = std::max(newBufferSize, 2048u);
+        modelBatchInputs.resize(maxModelFrames * BatchedModel::kMaxInputSize);
+
+        if (modelBatch != nullptr)
+            modelBatch->prepare(maxModelFrames);
+       #endif
+
+        // room for the largest cabinet latency at this buffer size, see updateCabinetLatency()
+        const uint32_t maxLatency = TwoStageThreadedConvolver::getDelayedOutputLatency(newBufferSize);
+        cabinetDryDelay.setMaxDelay(maxLatency);
+        cabinetDryDelayRight.setMaxDelay(maxLatency);
+        bypassDryDelay.setMaxDelay(maxLatency);
+        bypassDryDelayRight.setMaxDelay(maxLatency);
+
+        // the latency of delayed convolvers follows the buffer size, they are set up for a single one
+        if (cabinetDelayedOutput && cabsim != nullptr)
+            updateCabinet(false);
+    }
+
+    // convolvers are set up for a single mode, new ones take over through the same swap as new impulses.
+    // offline rendering keeps the convolvers blocking, the output then has no latency to compensate
+    void updateCabinetDelayedOutput()
+    {
+        const bool delayedOutput = cabinetLatencyEnabled && ! offline;
+
+        if (delayedOutput == cabinetDelayedOutput)
+            return;
+
+        cabinetDelayedOutput = delayedOutput;
+
+        if (cabsim != nullptr)
+            updateCabinet(false);
+    }
+
+    // the plugin latency is the one of the cabinet, only while it is active.
+    // the dry signals are delayed to match, their delay lines are allocated for any latency beforehand
+    void updateCabinetLatency(const bool stereo)
+    {
+        uint32_t newLatency = 0;
+
+        if (! isSettledAt(cabsimGain, 0.f))
+        {
+            // the convolver may be swapped meanwhile, see updateCabinet()
+            activeConvolver.store(true);
+            if (cabsim != nullptr && (! stereo || cabsimRight != nullptr))
+                newLatency = cabsim->getLatency();
+            activeConvolver.store(false);
+        }
+
+        if (newLatency == cabinetLatency)
+            return;
+
+        cabinetLatency = newLatency;
+        cabinetDryDelay.setDelay(newLatency);
+        cabinetDryDelayRight.setDelay(newLatency);
+        bypassDryDelay.setDelay(newLatency);
+        bypassDryDelayRight.setDelay(newLatency);
+        setLatency(newLatency);
     }
 
    /**
@@ -1110,9 +2901,37 @@ the_end:
         paramFirstRun = true;
 
         meterMaxFrameCount = newSampleRate * 0.016666; // max 60fps
+        profiler.setSampleRate(newSampleRate);
+        deadlineMonitor.setSampleRate(newSampleRate);
+
+        sleepHoldFrames = newSampleRate * kSleepHoldTime;
+        silentFrames = 0;
+
+        // reload cabsim files into a new convolver, the input history of the current one no longer applies.
+        // extra IRs are dropped first so they are never blended at the wrong sample rate
+       #if AIDAX_WITH_BAKED_EQ
+        eqBakeHoldFrames = newSampleRate * kEqBakeHoldTime;
+        eqStableFrames = 0;
+
+        {
+            const MutexLocker cml(cabinetEqBaker.getMutex());
+            cabinetEqBaker.setCabinet(nullptr, nullptr, 0);
+        }
+       #endif
+
+        delete cabsim;
+        delete cabsimRight;
+        cabsim = cabsimRight = nullptr;
+
+        char* extraFilenames[kCabinetSlots] = {};
+
+        for (uint i = 1; i < kCabinetSlots; ++i)
+        {
+            extraFilenames[i] = cabsimFilenames[i].getAndReleaseBuffer();
+            cabinetImpulses[i] = nullptr;
+        }
 
-        // reload cabsim file
-        if (char* const filename = cabsimFilename.getAndReleaseBuffer())
+        if (char* const filename = cabsimFilenames[0].getAndReleaseBuffer())
         {
             setState("cabinet", filename);
             std::free(filename);
@@ -1121,11 +2940,46 @@ the_end:
         {
             loadDefaultCabinet();
         }
+
+        for (uint i = 1; i < kCabinetSlots; ++i)
+        {
+            if (extraFilenames[i] != nullptr)
+            {
+                loadCabinetFromFile(extraFilenames[i], i);
+                std::free(extraFilenames[i]);
+            }
+        }
     }
 
     void ioChanged(const uint16_t numInputs, const uint16_t numOutputs) override
     {
-        isStereoAU = numInputs == 2 && numOutputs == 2;
+        const bool stereo = numInputs == 2 && numOutputs == 2;
+
+        if (stereo == isStereoAU)
+            return;
+
+        isStereoAU = stereo;
+        aida.resetRightChannel();
+
+        // the model only has its stereo parts when loaded in stereo
+        if (stereo && model != nullptr)
+            reloadModel();
+
+        // the cabinet is rebuilt with a convolver per channel, or a single one again.
+        // stereo runs on the plain impulses, baked ones are only made for a single convolver
+       #if AIDAX_WITH_BAKED_EQ
+        {
+            const MutexLocker cml(cabinetEqBaker.getMutex());
+            cabinetEqBaker.setCabinet(nullptr, nullptr, 0);
+        }
+       #endif
+
+        delete cabsim;
+        delete cabsimRight;
+        cabsim = cabsimRight = nullptr;
+
+        updateCabinet();
+        updateMonitorConfiguration();
     }
 
     // ----------------------------------------------------------------------------------------------------------------
@@ -11,6 +11,7 @@
 
 #include "Graphics.hpp"
 #include "Layout.hpp"
+#include "TraceRecorder.hpp"
 #include "Widgets.hpp"
 
 #if AIDAX_WITH_STANDALONE_CONTROLS
@@ -109,6 +110,8 @@ class AidaDSPLoaderUI : public UI,
 
    #ifndef MOD_BUILD
     String aboutLabel;
+    // DSP load and deadline overruns over the pedal head, toggled by clicking the version label
+    bool showDiagnostics = false;
    #endif
     String lastDirModel;
     String lastDirCabinet;
@@ -325,6 +328,43 @@ protected:
         case kParameterPARAM1:
         case kParameterPARAM2:
         case kParameterDCBLOCKER:
+        case kParameterCABIR1LEVEL:
+        case kParameterCABIR2LEVEL:
+        case kParameterCABIR3LEVEL:
+        case kParameterLoadInput:
+        case kParameterLoadModel:
+        case kParameterLoadDCBlocker:
+        case kParameterLoadCabinet:
+        case kParameterLoadToneControls:
+        case kParameterLoadOutput:
+        case kParameterLoadTotal:
+        case kParameterPeakInput:
+        case kParameterPeakModel:
+        case kParameterPeakDCBlocker:
+        case kParameterPeakCabinet:
+        case kParameterPeakToneControls:
+        case kParameterPeakOutput:
+        case kParameterPeakTotal:
+        case kParameterOverruns:
+        case kParameterWorstLoad:
+           #ifndef MOD_BUILD
+            if (showDiagnostics)
+                repaint();
+           #endif
+            break;
+        case kParameterModelLoadTime:
+        case kParameterModelLoadSlowest:
+            loaders.model->setLoadTime(parameters[kParameterModelLoadTime],
+                                       kModelLoadPhaseNames[std::min(static_cast<uint>(parameters[kParameterModelLoadSlowest] + 0.5f),
+                                                                     static_cast<uint>(kModelLoadPhaseCount - 1))]);
+            break;
+        case kParameterCabinetLoadTime:
+        case kParameterCabinetLoadSlowest:
+            loaders.cabsim->setLoadTime(parameters[kParameterCabinetLoadTime],
+                                        kCabinetLoadPhaseNames[std::min(static_cast<uint>(parameters[kParameterCabinetLoadSlowest] + 0.5f),
+                                                                        static_cast<uint>(kCabinetLoadPhaseCount - 1))]);
+            break;
+        case kParameterActiveStages:
         case kParameterCount:
             break;
         }
@@ -345,6 +385,9 @@ protected:
 
     void onNanoDisplay() override
     {
+        TraceRecorder::setThreadName("ui");
+        const TraceScope ts("ui draw");
+
         const uint width = getWidth();
         const uint height = getHeight();
         const double scaleFactor = getScaleFactor();
@@ -487,6 +530,11 @@ protected:
         text(marginHorizontal + widthPedal - 10 * scaleFactor, marginVertical/2, aboutLabel, nullptr);
        #endif
 
+       #ifndef MOD_BUILD
+        if (showDiagnostics)
+            drawDiagnostics(marginHorizontal + marginHead, marginVertical + marginHead, heightHead);
+       #endif
+
        #if AIDAX_WITH_STANDALONE_CONTROLS
         textAlign(ALIGN_CENTER | ALIGN_MIDDLE);
 
@@ -510,6 +558,100 @@ protected:
        #endif
     }
 
+   #ifndef MOD_BUILD
+    // average and peak load of each stage as a percentage of the audio block duration, then deadline overruns
+    void drawDiagnostics(const double x, const double y, const double height)
+    {
+       #if AIDAX_WITH_PROFILER
+        static const char* const kStageNames[kProfileCount + 1] = {
+            "input", "model", "dc blocker", "cabinet", "tone controls", "output", "total"
+        };
+        constexpr const uint kNumStageRows = kProfileCount + 2;
+       #else
+        constexpr const uint kNumStageRows = 0;
+       #endif
+
+        const double scaleFactor = getScaleFactor();
+        const double lineHeight = height / (kNumStageRows + 4);
+        const double padding = lineHeight / 2;
+        char value[32];
+
+        beginPath();
+        roundedRect(x, y, 260 * scaleFactor, height, 12 * scaleFactor);
+        fillColor(Color(0, 0, 0, 0.75f));
+        fill();
+
+        fontSize(kSubWidgetsFontSize * scaleFactor);
+
+       #if AIDAX_WITH_PROFILER
+        textAlign(ALIGN_LEFT | ALIGN_TOP);
+        fillColor(Color(0x8b, 0xf7, 0x00));
+        text(x + padding, y + padding, "DSP load", nullptr);
+        textAlign(ALIGN_RIGHT | ALIGN_TOP);
+        text(x + 180 * scaleFactor, y + padding, "avg", nullptr);
+        text(x + 245 * scaleFactor, y + padding, "peak", nullptr);
+
+        for (uint i = 0; i <= kProfileCount; ++i)
+        {
+            const double ly = y + padding + lineHeight * (i + 1);
+
+            fillColor(i == kProfileCount ? Color(0x8b, 0xf7, 0x00) : Color(1.f, 1.f, 1.f));
+            textAlign(ALIGN_LEFT | ALIGN_TOP);
+            text(x + padding, ly, kStageNames[i], nullptr);
+
+            textAlign(ALIGN_RIGHT | ALIGN_TOP);
+            std::snprintf(value, sizeof(value), "%.1f%%", parameters[kParameterLoadInput + i]);
+            text(x + 180 * scaleFactor, ly, value, nullptr);
+            std::snprintf(value, sizeof(value), "%.1f%%", parameters[kParameterPeakInput + i]);
+            text(x + 245 * scaleFactor, ly, value, nullptr);
+        }
+       #endif
+
+        const double dy = y + padding + lineHeight * kNumStageRows;
+        const bool overruns = parameters[kParameterOverruns] > 0.5f;
+
+        textAlign(ALIGN_LEFT | ALIGN_TOP);
+        fillColor(Color(0x8b, 0xf7, 0x00));
+        text(x + padding, dy, "deadline", nullptr);
+
+        fillColor(Color(1.f, 1.f, 1.f));
+        text(x + padding, dy + lineHeight, "worst block, last second", nullptr);
+        fillColor(overruns ? Color(0xff, 0x40, 0x40) : Color(1.f, 1.f, 1.f));
+        text(x + padding, dy + lineHeight * 2, "overruns", nullptr);
+
+        textAlign(ALIGN_RIGHT | ALIGN_TOP);
+        std::snprintf(value, sizeof(value), "%.1f%%", parameters[kParameterWorstLoad]);
+        fillColor(parameters[kParameterWorstLoad] >= 100.f ? Color(0xff, 0x40, 0x40) : Color(1.f, 1.f, 1.f));
+        text(x + 245 * scaleFactor, dy + lineHeight, value, nullptr);
+        std::snprintf(value, sizeof(value), "%u", static_cast<uint>(parameters[kParameterOverruns] + 0.5f));
+        fillColor(overruns ? Color(0xff, 0x40, 0x40) : Color(1.f, 1.f, 1.f));
+        text(x + 245 * scaleFactor, dy + lineHeight * 2, value, nullptr);
+    }
+
+    bool onMouse(const MouseEvent& event) override
+    {
+        if (event.press && event.button == kMouseButtonLeft)
+        {
+            const double scaleFactor = getScaleFactor();
+            const double widthPedal = kPedalWidth * scaleFactor;
+            const double marginHorizontal = kPedalMargin * scaleFactor + (getWidth() - DISTRHO_UI_DEFAULT_WIDTH * scaleFactor) / 2;
+            const double marginTop = kPedalMarginTop * scaleFactor;
+
+            // version label, right side of the top margin
+            if (event.pos.getY() < marginTop
+                && event.pos.getX() > marginHorizontal + widthPedal * 3 / 4
+                && event.pos.getX() < marginHorizontal + widthPedal)
+            {
+                showDiagnostics = !showDiagnostics;
+                repaint();
+                return true;
+            }
+        }
+
+        return UI::onMouse(event);
+    }
+   #endif
+
     void onResize(const ResizeEvent& event) override
     {
         UI::onResize(event);
@@ -0,0 +1,150 @@
+/*
+ * AIDA-X command line host helpers
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+// Shared by the command line hosts, which run the plugin DSP directly through DPF's PluginExporter.
+// This pulls in the DPF plugin implementation, so it must only be included once per program.
+
+#include "src/DistrhoPlugin.cpp"
+#include "src/DistrhoUtils.cpp"
+
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static const char* const kCabinetKeys[kCabinetSlots] = { "cabinet", "cabinet2", "cabinet3" };
+
+// what a plugin instance is loaded with, null files keep the plugin defaults
+struct PluginSetup {
+    const char* model = nullptr;
+    // "model-batch" state of instances sharing their model with others in the process, see ModelBatchGroup
+    const char* modelBatch = nullptr;
+    const char* cabinets[kCabinetSlots] = {};
+    std::vector<std::pair<uint32_t, float>> parameters;
+};
+
+static inline void listParameters()
+{
+    for (uint32_t i = 0; i < kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+
+        std::printf("%-14s %-16s %g .. %g, default %g %s\n",
+                    param.symbol.buffer(), param.name.buffer(),
+                    param.ranges.min, param.ranges.max, param.ranges.def, param.unit.buffer());
+    }
+}
+
+// parameter from its symbol or name (case insensitive, @a len characters of @a name) and value string
+static inline bool parseParameter(const char* const name, const size_t len, const char* const value,
+                                  std::pair<uint32_t, float>& result)
+{
+    char* end;
+    const float fvalue = std::strtof(value, &end);
+    DISTRHO_SAFE_ASSERT_RETURN(end != value && *end == '\0', false);
+
+    for (uint32_t i = 0; i < kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+
+        if ((param.symbol.length() == len && ::strncasecmp(param.symbol, name, len) == 0) ||
+            (param.name.length() == len && ::strncasecmp(param.name, name, len) == 0))
+        {
+            result = { i, param.ranges.getFixedValue(fvalue) };
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// parameter from a SYMBOL=VALUE string
+static inline bool parseParameter(const char* const arg, std::pair<uint32_t, float>& result)
+{
+    const char* const sep = std::strchr(arg, '=');
+    DISTRHO_SAFE_ASSERT_RETURN(sep != nullptr && sep != arg, false);
+
+    return parseParameter(arg, static_cast<size_t>(sep - arg), sep + 1, result);
+}
+
+// checked up front, the plugin only reports load errors on the console
+static inline bool checkSetupFiles(const PluginSetup& setup)
+{
+    const char* const files[] = { setup.model, setup.cabinets[0], setup.cabinets[1], setup.cabinets[2] };
+
+    for (const char* const file : files)
+    {
+        if (file == nullptr)
+            continue;
+
+        if (FILE* const f = std::fopen(file, "rb"))
+        {
+            std::fclose(f);
+            continue;
+        }
+
+        std::fprintf(stderr, "cannot open %s\n", file);
+        return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// the plugin constructor takes its buffer size and sample rate from globals, so instances are created one at a time
+static std::mutex sInstanceMutex;
+
+static inline PluginExporter* createPluginInstance(const PluginSetup& setup, const uint32_t bufferSize,
+                                                   const double sampleRate, const bool offline)
+{
+    PluginExporter* plugin;
+
+    {
+        const std::lock_guard<std::mutex> lock(sInstanceMutex);
+        d_nextBufferSize = bufferSize;
+        d_nextSampleRate = sampleRate;
+        plugin = new PluginExporter(nullptr, nullptr, nullptr, nullptr);
+    }
+
+    // must come first, so the cabinet is set up for offline processing as it loads
+    if (offline)
+        plugin->setState("offline", "true");
+
+    // before the model, which then loads into the group
+    if (setup.modelBatch != nullptr)
+        plugin->setState("model-batch", setup.modelBatch);
+
+    if (setup.model != nullptr)
+        plugin->setState("json", setup.model);
+
+    for (uint i = 0; i < kCabinetSlots; ++i)
+    {
+        if (setup.cabinets[i] != nullptr)
+            plugin->setState(kCabinetKeys[i], setup.cabinets[i]);
+    }
+
+    for (const std::pair<uint32_t, float>& param : setup.parameters)
+        plugin->setParameterValue(param.first, param.second);
+
+    plugin->activate();
+    return plugin;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,497 @@
+/*
+ * AIDA-X multi-channel rack
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// JACK client running many independent chains in one process, each with a mono input and output.
+// A chain is a plugin instance with its own model, cabinets and parameters, so players on the same host share one
+// process, one set of cabinet workers and one IR cache instead of each running a separate standalone.
+// Every cycle the chains are queued as jobs on the worker pool the cabinets already use, with the end of the cycle as
+// deadline. The JACK thread runs the first chain itself and then waits for the others, running any that no worker
+// picked up yet, so all chains are done before the cycle returns.
+// Chains loading the same model file step through it together as streams of one batched model, so that its weights
+// are read once per sample for all of them, unless --no-model-batch is given.
+// Cabinets block on their tail stage unless --cabinet-latency is given, the latency of each chain is then reported
+// on its ports and JACK is told to recompute it when it changes.
+
+#include "PluginHost.hpp"
+#include "ConvolverWorkerPool.hpp"
+#include "ModelBatchGroup.hpp"
+
+#include <jack/jack.h>
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static constexpr const uint kMaxChains = 64;
+
+struct Chain {
+    PluginSetup setup;
+    String modelBatch;
+    PluginExporter* plugin = nullptr;
+    jack_port_t* input = nullptr;
+    jack_port_t* output = nullptr;
+    ConvolverWorkerJob job;
+
+    // set by the JACK thread before the job is submitted
+    const float* inputBuffer = nullptr;
+    float* outputBuffer = nullptr;
+    uint32_t numFrames = 0;
+
+    // plugin latency after the last cycle, and the one last reported to JACK
+    std::atomic<uint32_t> latency { 0 };
+    uint32_t reportedLatency = 0;
+
+    Chain()
+        : job(run, this) {}
+
+    static void run(void* const arg)
+    {
+        Chain* const chain = static_cast<Chain*>(arg);
+        const float* inputs[1] = { chain->inputBuffer };
+        float* outputs[1] = { chain->outputBuffer };
+
+        chain->plugin->run(inputs, outputs, chain->numFrames);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(Chain)
+};
+
+struct Rack {
+    jack_client_t* client = nullptr;
+    ConvolverWorkerPool* pool = nullptr;
+    std::vector<Chain*> chains;
+    double sampleRate = 0.0;
+};
+
+static volatile std::sig_atomic_t sRunning = 1;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static void printUsage(const char* const name)
+{
+    std::fprintf(stderr,
+                 "usage: %s [options] --chain SPEC [--chain SPEC...]\n"
+                 "  --chain SPEC   add a chain, SPEC is a comma separated list of model=FILE, cabinet=FILE,\n"
+                 "                 cabinet2=FILE, cabinet3=FILE and SYMBOL=VALUE parameters (see --list-params)\n"
+                 "  --chains N     add chains with the plugin defaults up to a total of N\n"
+                 "  --name NAME    JACK client name (default aidax-rack)\n"
+                 "  --connect      connect chains to physical inputs and outputs in order\n"
+                 "  --cabinet-latency  delay cabinets for a lighter JACK thread, reported as port latency\n"
+                 "  --no-model-batch   run a separate copy of the model per chain, even for the same file\n"
+                 "  --list-params  show parameter symbols and ranges, then exit\n"
+                 "Chain N uses the JACK ports in_N and out_N.\n",
+                 name);
+}
+
+// the setup keeps pointers into @a spec, which is split in place
+static bool parseChain(char* const spec, PluginSetup& setup)
+{
+    for (char* s = spec; *s != '\0';)
+    {
+        char* const comma = std::strchr(s, ',');
+        char* const end = comma != nullptr ? comma : s + std::strlen(s);
+        char* const sep = static_cast<char*>(std::memchr(s, '=', static_cast<size_t>(end - s)));
+
+        if (comma != nullptr)
+            *comma = '\0';
+
+        if (sep == nullptr || sep == s)
+        {
+            std::fprintf(stderr, "invalid chain item '%s', expected KEY=VALUE\n", s);
+            return false;
+        }
+
+        const size_t keylen = static_cast<size_t>(sep - s);
+        const char* const value = sep + 1;
+
+        if (keylen == 5 && std::strncmp(s, "model", 5) == 0)
+        {
+            setup.model = value;
+        }
+        else if (keylen == 7 && std::strncmp(s, "cabinet", 7) == 0)
+        {
+            setup.cabinets[0] = value;
+        }
+        else if (keylen == 8 && std::strncmp(s, "cabinet2", 8) == 0)
+        {
+            setup.cabinets[1] = value;
+        }
+        else if (keylen == 8 && std::strncmp(s, "cabinet3", 8) == 0)
+        {
+            setup.cabinets[2] = value;
+        }
+        else
+        {
+            std::pair<uint32_t, float> param;
+
+            if (! parseParameter(s, keylen, value, param))
+            {
+                std::fprintf(stderr, "invalid parameter '%s' in chain, see --list-params\n", s);
+                return false;
+            }
+
+            setup.parameters.push_back(param);
+        }
+
+        s = comma != nullptr ? comma + 1 : end;
+    }
+
+    return checkSetupFiles(setup);
+}
+
+// chains with the same model file become members of a model batch group, up to the streams a batched model can run.
+// groups are named by their index and model, which is empty for the built-in one
+static void setupModelBatches(const std::vector<Chain*>& chains)
+{
+    std::vector<bool> grouped(chains.size(), false);
+    uint numGroups = 0;
+
+    for (size_t i = 0; i < chains.size(); ++i)
+    {
+        if (grouped[i])
+            continue;
+
+        const char* const model = chains[i]->setup.model;
+        const bool isDefault = model == nullptr || model[0] == '\0' || std::strcmp(model, "default") == 0;
+        std::vector<Chain*> members;
+
+        for (size_t j = i; j < chains.size() && members.size() < BatchedModel::kMaxStreams; ++j)
+        {
+            const char* const other = chains[j]->setup.model;
+            const bool otherIsDefault = other == nullptr || other[0] == '\0' || std::strcmp(other, "default") == 0;
+
+            if (grouped[j] || otherIsDefault != isDefault || (! isDefault && std::strcmp(model, other) != 0))
+                continue;
+
+            grouped[j] = true;
+            members.push_back(chains[j]);
+        }
+
+        // a single chain has nothing to share
+        if (members.size() < 2)
+            continue;
+
+        for (size_t k = 0; k < members.size(); ++k)
+        {
+            Chain* const chain = members[k];
+            char prefix[32];
+            std::snprintf(prefix, sizeof(prefix), "%u/%u:%u:",
+                          static_cast<uint>(k), static_cast<uint>(members.size()), numGroups);
+
+            chain->modelBatch = prefix;
+            chain->modelBatch += isDefault ? "" : model;
+            chain->setup.modelBatch = chain->modelBatch.buffer();
+        }
+
+        ++numGroups;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static int processCallback(const jack_nframes_t nframes, void* const arg)
+{
+    Rack* const rack = static_cast<Rack*>(arg);
+    const std::vector<Chain*>& chains(rack->chains);
+    const uint64_t deadline = ConvolverWorkerPool::getCurrentTime()
+                            + static_cast<uint64_t>(nframes * 1e9 / rack->sampleRate);
+
+    for (Chain* chain : chains)
+    {
+        chain->inputBuffer = static_cast<const float*>(jack_port_get_buffer(chain->input, nframes));
+        chain->outputBuffer = static_cast<float*>(jack_port_get_buffer(chain->output, nframes));
+        chain->numFrames = nframes;
+    }
+
+    for (size_t i = 1; i < chains.size(); ++i)
+        rack->pool->submit(chains[i]->job, deadline);
+
+    Chain::run(chains[0]);
+
+    for (size_t i = 1; i < chains.size(); ++i)
+        rack->pool->wait(chains[i]->job);
+
+    for (Chain* chain : chains)
+        chain->latency.store(chain->plugin->getLatency(), std::memory_order_relaxed);
+
+    return 0;
+}
+
+// each chain delays its signal by its own latency, on top of whatever is connected to the other side
+static void latencyCallback(const jack_latency_callback_mode_t mode, void* const arg)
+{
+    Rack* const rack = static_cast<Rack*>(arg);
+
+    for (Chain* chain : rack->chains)
+    {
+        const uint32_t latency = chain->reportedLatency;
+        jack_latency_range_t range;
+
+        if (mode == JackCaptureLatency)
+        {
+            jack_port_get_latency_range(chain->input, mode, &range);
+            range.min += latency;
+            range.max += latency;
+            jack_port_set_latency_range(chain->output, mode, &range);
+        }
+        else
+        {
+            jack_port_get_latency_range(chain->output, mode, &range);
+            range.min += latency;
+            range.max += latency;
+            jack_port_set_latency_range(chain->input, mode, &range);
+        }
+    }
+}
+
+// the latency of a chain follows its cabinet, JACK recomputes the graph latencies when one changed
+static void updateLatencies(Rack& rack)
+{
+    bool changed = false;
+
+    for (Chain* chain : rack.chains)
+    {
+        const uint32_t latency = chain->latency.load(std::memory_order_relaxed);
+
+        if (latency != chain->reportedLatency)
+        {
+            chain->reportedLatency = latency;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        jack_recompute_total_latencies(rack.client);
+}
+
+static int bufferSizeCallback(const jack_nframes_t nframes, void* const arg)
+{
+    Rack* const rack = static_cast<Rack*>(arg);
+
+    for (Chain* chain : rack->chains)
+    {
+        chain->plugin->deactivate();
+        chain->plugin->setBufferSize(nframes, true);
+        chain->plugin->activate();
+    }
+
+    return 0;
+}
+
+static int sampleRateCallback(const jack_nframes_t nframes, void* const arg)
+{
+    Rack* const rack = static_cast<Rack*>(arg);
+    rack->sampleRate = nframes;
+
+    for (Chain* chain : rack->chains)
+    {
+        chain->plugin->deactivate();
+        chain->plugin->setSampleRate(nframes, true);
+        chain->plugin->activate();
+    }
+
+    return 0;
+}
+
+static void shutdownCallback(void*)
+{
+    sRunning = 0;
+}
+
+static void signalHandler(int)
+{
+    sRunning = 0;
+}
+
+// connects ports of one direction to the matching physical ports, in order
+static void connectPhysicalPorts(Rack& rack, const bool inputs)
+{
+    const char** const physicalPorts = jack_get_ports(rack.client, nullptr, JACK_DEFAULT_AUDIO_TYPE,
+                                                      JackPortIsPhysical | (inputs ? JackPortIsOutput
+                                                                                   : JackPortIsInput));
+    if (physicalPorts == nullptr)
+        return;
+
+    for (size_t i = 0; i < rack.chains.size() && physicalPorts[i] != nullptr; ++i)
+    {
+        if (inputs)
+            jack_connect(rack.client, physicalPorts[i], jack_port_name(rack.chains[i]->input));
+        else
+            jack_connect(rack.client, jack_port_name(rack.chains[i]->output), physicalPorts[i]);
+    }
+
+    jack_free(physicalPorts);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    Rack rack;
+    const char* clientName = "aidax-rack";
+    bool connect = false;
+    bool cabinetLatency = false;
+    bool modelBatch = true;
+    uint numChains = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+        char* const next = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--list-params") == 0)
+        {
+            listParameters();
+            return 0;
+        }
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+
+        if (std::strcmp(arg, "--connect") == 0)
+        {
+            connect = true;
+            continue;
+        }
+
+        if (std::strcmp(arg, "--cabinet-latency") == 0)
+        {
+            cabinetLatency = true;
+            continue;
+        }
+
+        if (std::strcmp(arg, "--no-model-batch") == 0)
+        {
+            modelBatch = false;
+            continue;
+        }
+
+        if (next == nullptr)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        ++i;
+
+        if (std::strcmp(arg, "--chain") == 0)
+        {
+            Chain* const chain = new Chain();
+            rack.chains.push_back(chain);
+
+            if (! parseChain(next, chain->setup))
+                return 1;
+        }
+        else if (std::strcmp(arg, "--chains") == 0)
+        {
+            numChains = static_cast<uint>(std::strtoul(next, nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--name") == 0)
+        {
+            clientName = next;
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    while (rack.chains.size() < numChains)
+        rack.chains.push_back(new Chain());
+
+    if (rack.chains.empty() || rack.chains.size() > kMaxChains)
+    {
+        std::fprintf(stderr, "between 1 and %u chains are needed\n", kMaxChains);
+        return 1;
+    }
+
+    if (modelBatch)
+        setupModelBatches(rack.chains);
+
+    rack.client = jack_client_open(clientName, JackNoStartServer, nullptr);
+
+    if (rack.client == nullptr)
+    {
+        std::fprintf(stderr, "cannot connect to JACK\n");
+        return 1;
+    }
+
+    const uint32_t bufferSize = jack_get_buffer_size(rack.client);
+    rack.sampleRate = jack_get_sample_rate(rack.client);
+    rack.pool = ConvolverWorkerPool::acquire();
+
+    for (size_t i = 0; i < rack.chains.size(); ++i)
+    {
+        Chain* const chain = rack.chains[i];
+        char portName[32];
+
+        chain->plugin = createPluginInstance(chain->setup, bufferSize, rack.sampleRate, false);
+
+        if (cabinetLatency)
+            chain->plugin->setState("cabinet-latency", "true");
+
+        std::snprintf(portName, sizeof(portName), "in_%u", static_cast<uint>(i + 1));
+        chain->input = jack_port_register(rack.client, portName, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+
+        std::snprintf(portName, sizeof(portName), "out_%u", static_cast<uint>(i + 1));
+        chain->output = jack_port_register(rack.client, portName, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+
+        DISTRHO_SAFE_ASSERT_RETURN(chain->input != nullptr && chain->output != nullptr, 1);
+
+        rack.pool->registerJob(&chain->job);
+    }
+
+    jack_set_process_callback(rack.client, processCallback, &rack);
+    jack_set_buffer_size_callback(rack.client, bufferSizeCallback, &rack);
+    jack_set_sample_rate_callback(rack.client, sampleRateCallback, &rack);
+    jack_set_latency_callback(rack.client, latencyCallback, &rack);
+    jack_on_shutdown(rack.client, shutdownCallback, nullptr);
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    if (jack_activate(rack.client) != 0)
+    {
+        std::fprintf(stderr, "cannot activate JACK client\n");
+        return 1;
+    }
+
+    if (connect)
+    {
+        connectPhysicalPorts(rack, true);
+        connectPhysicalPorts(rack, false);
+    }
+
+    std::printf("%s running %u chains at %u frames, %.0f Hz\n",
+                jack_get_client_name(rack.client), static_cast<uint>(rack.chains.size()), bufferSize, rack.sampleRate);
+
+    while (sRunning)
+    {
+        d_msleep(200);
+        updateLatencies(rack);
+    }
+
+    jack_deactivate(rack.client);
+    jack_client_close(rack.client);
+
+    for (Chain* chain : rack.chains)
+    {
+        rack.pool->unregisterJob(&chain->job);
+        chain->plugin->deactivate();
+        delete chain->plugin;
+        delete chain;
+    }
+
+    ConvolverWorkerPool::release();
+    return 0;
+}
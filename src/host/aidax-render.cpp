@@ -0,0 +1,547 @@
+/*
+ * AIDA-X offline renderer
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Headless host that runs the plugin over audio files, for reamping DI tracks in batch.
+// Each file gets its own plugin instance at the file sample rate, so the model, tone controls, cabinet and gain
+// stages are exactly the ones the plugin formats use. Instances are told they render offline, which keeps the
+// cabinet from delaying its output whatever the "cabinet-latency" state says, and are run in large blocks.
+// The first channel of each file is rendered into a mono 32-bit float WAV.
+//
+// Long files are split into chunks rendered in parallel, so a single take scales with the number of cores too.
+// The model is recurrent, but its memory of past input fades within a few hundred milliseconds, and the filters and
+// cabinet only remember as far back as their impulse response. So each chunk starts with its own instance rendering
+// a pre-roll of the audio before it, discarded once the state has settled, and chunks are simply put back together.
+// --verify renders every chunked file sequentially as well and checks the difference against a tolerance.
+
+#include "PluginHost.hpp"
+
+#include "dr_flac.h"
+#include "dr_wav.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+USE_NAMESPACE_DISTRHO
+
+static constexpr const uint32_t kDefaultBlockSize = 4096;
+static constexpr const uint32_t kMaxBlockSize = 65536;
+static constexpr const double kDefaultChunkTime = 60.0;
+static constexpr const double kDefaultPrerollTime = 1.0;
+
+struct Options {
+    PluginSetup setup;
+    uint32_t blockSize = kDefaultBlockSize;
+    uint numJobs = 0;
+    double chunkTime = kDefaultChunkTime;
+    double prerollTime = kDefaultPrerollTime;
+    bool verify = false;
+    double verifyTolerance = 0.0;
+    std::string outputDir;
+    std::vector<const char*> inputs;
+};
+
+// a file being rendered, chunks of it are handed out to workers one at a time
+struct FileJob {
+    const char* filename = nullptr;
+    std::vector<float> input;
+    std::vector<float> output;
+    uint sampleRate = 0;
+    uint64_t chunkFrames = 0;
+    uint64_t prerollFrames = 0;
+    uint numChunks = 0;
+    uint nextChunk = 0;
+    std::atomic<uint> numChunksDone { 0 };
+    std::chrono::steady_clock::time_point startTime;
+
+    // set once done
+    double audioSeconds = 0.0;
+    bool ok = false;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static void printUsage(const char* const name)
+{
+    std::fprintf(stderr,
+                 "usage: %s [options] input.wav|input.flac...\n"
+                 "  --model FILE          neural model json, the plugin default if not set\n"
+                 "  --cabinet FILE        cabinet impulse response, the plugin default if not set\n"
+                 "  --cabinet2 FILE       second cabinet impulse response\n"
+                 "  --cabinet3 FILE       third cabinet impulse response\n"
+                 "  --param SYMBOL=VALUE  set a parameter, can be repeated (see --list-params)\n"
+                 "  --output DIR          directory for rendered files, next to each input if not set\n"
+                 "  --block N             frames processed per run (default %u)\n"
+                 "  --jobs N              worker threads (default: number of CPUs)\n"
+                 "  --chunk SECONDS       split files into chunks rendered in parallel, 0 to disable (default %g)\n"
+                 "  --preroll SECONDS     audio rendered and discarded before each chunk (default %g)\n"
+                 "  --verify DBFS         also render chunked files sequentially, fail if they differ by more\n"
+                 "  --list-params         show parameter symbols and ranges, then exit\n"
+                 "Each input is written as <name>-aidax.wav, mono 32-bit float at the input sample rate.\n",
+                 name, kDefaultBlockSize, kDefaultChunkTime, kDefaultPrerollTime);
+}
+
+static bool isFlacFile(const char* const filename)
+{
+    const size_t len = std::strlen(filename);
+    return len > 5 && ::strcasecmp(filename + (len - 5), ".flac") == 0;
+}
+
+// length of an impulse response file in seconds, 0 if unknown
+static double getImpulseTime(const char* const filename)
+{
+    double time = 0.0;
+
+    if (isFlacFile(filename))
+    {
+        if (drflac* const flac = drflac_open_file(filename, nullptr))
+        {
+            time = static_cast<double>(flac->totalPCMFrameCount) / flac->sampleRate;
+            drflac_close(flac);
+        }
+    }
+    else
+    {
+        drwav wav;
+        if (drwav_init_file(&wav, filename, nullptr))
+        {
+            time = static_cast<double>(wav.totalPCMFrameCount) / wav.sampleRate;
+            drwav_uninit(&wav);
+        }
+    }
+
+    return time;
+}
+
+static bool parseOptions(const int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+        const char* const next = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--list-params") == 0)
+        {
+            listParameters();
+            std::exit(0);
+        }
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+        {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+
+        if (arg[0] != '-')
+        {
+            options.inputs.push_back(arg);
+            continue;
+        }
+
+        if (next == nullptr)
+        {
+            std::fprintf(stderr, "missing value for %s\n", arg);
+            return false;
+        }
+        ++i;
+
+        if (std::strcmp(arg, "--model") == 0)
+        {
+            options.setup.model = next;
+        }
+        else if (std::strcmp(arg, "--cabinet") == 0)
+        {
+            options.setup.cabinets[0] = next;
+        }
+        else if (std::strcmp(arg, "--cabinet2") == 0)
+        {
+            options.setup.cabinets[1] = next;
+        }
+        else if (std::strcmp(arg, "--cabinet3") == 0)
+        {
+            options.setup.cabinets[2] = next;
+        }
+        else if (std::strcmp(arg, "--param") == 0)
+        {
+            std::pair<uint32_t, float> param;
+
+            if (! parseParameter(next, param))
+            {
+                std::fprintf(stderr, "invalid parameter '%s', see --list-params\n", next);
+                return false;
+            }
+
+            options.setup.parameters.push_back(param);
+        }
+        else if (std::strcmp(arg, "--output") == 0)
+        {
+            options.outputDir = next;
+        }
+        else if (std::strcmp(arg, "--block") == 0)
+        {
+            options.blockSize = static_cast<uint32_t>(std::strtoul(next, nullptr, 10));
+
+            if (options.blockSize == 0 || options.blockSize > kMaxBlockSize)
+            {
+                std::fprintf(stderr, "block size must be between 1 and %u\n", kMaxBlockSize);
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--jobs") == 0)
+        {
+            options.numJobs = static_cast<uint>(std::strtoul(next, nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--chunk") == 0)
+        {
+            options.chunkTime = std::max(0.0, std::atof(next));
+        }
+        else if (std::strcmp(arg, "--preroll") == 0)
+        {
+            options.prerollTime = std::max(0.0, std::atof(next));
+        }
+        else if (std::strcmp(arg, "--verify") == 0)
+        {
+            options.verify = true;
+            options.verifyTolerance = std::atof(next);
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    if (! checkSetupFiles(options.setup))
+        return false;
+
+    // the cabinets must be fully primed for chunks to match a sequential render
+    for (const char* const cabinet : options.setup.cabinets)
+    {
+        if (cabinet != nullptr)
+            options.prerollTime = std::max(options.prerollTime, getImpulseTime(cabinet));
+    }
+
+    return ! options.inputs.empty();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// first channel of a WAV or FLAC file
+static bool readInput(const char* const filename, std::vector<float>& samples, uint& sampleRate)
+{
+    uint channels = 0;
+    drwav_uint64 numFrames = 0;
+
+    const bool flac = isFlacFile(filename);
+
+    float* const data = flac
+                      ? drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr)
+                      : drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+    DISTRHO_SAFE_ASSERT_RETURN(data != nullptr, false);
+
+    if (channels > 1)
+        std::fprintf(stderr, "%s: %u channels, rendering the first one\n", filename, channels);
+
+    if (channels != 0 && sampleRate != 0)
+    {
+        samples.resize(numFrames);
+
+        for (drwav_uint64 i = 0; i < numFrames; ++i)
+            samples[i] = data[i * channels];
+    }
+
+    if (flac)
+        drflac_free(data, nullptr);
+    else
+        drwav_free(data, nullptr);
+
+    return channels != 0 && sampleRate != 0;
+}
+
+static bool writeOutput(const char* const filename, const float* const data, const uint64_t numFrames,
+                        const uint sampleRate)
+{
+    drwav_data_format format = {};
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = 1;
+    format.sampleRate = sampleRate;
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    DISTRHO_SAFE_ASSERT_RETURN(drwav_init_file_write(&wav, filename, &format, nullptr), false);
+
+    const drwav_uint64 numWritten = drwav_write_pcm_frames(&wav, numFrames, data);
+    drwav_uninit(&wav);
+
+    return numWritten == numFrames;
+}
+
+static std::string getOutputFilename(const Options& options, const char* const input)
+{
+    std::string name(input);
+    std::string dir;
+
+    const size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+    {
+        dir = name.substr(0, slash + 1);
+        name.erase(0, slash + 1);
+    }
+
+    const size_t dot = name.rfind('.');
+    if (dot != std::string::npos && dot != 0)
+        name.erase(dot);
+
+    if (! options.outputDir.empty())
+    {
+        dir = options.outputDir;
+        if (dir.back() != '/' && dir.back() != '\\')
+            dir += '/';
+    }
+
+    return dir + name + "-aidax.wav";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static void process(PluginExporter* const plugin, const Options& options,
+                    const float* const input, float* const output, const uint64_t numFrames)
+{
+    for (uint64_t pos = 0; pos < numFrames;)
+    {
+        const uint32_t numSamples = static_cast<uint32_t>(std::min<uint64_t>(options.blockSize, numFrames - pos));
+        const float* inputs[1] = { input + pos };
+        float* outputs[1] = { output + pos };
+
+        plugin->run(inputs, outputs, numSamples);
+        pos += numSamples;
+    }
+}
+
+// output of the pre-roll only settles the plugin state, it is overwritten block after block
+static void preroll(PluginExporter* const plugin, const Options& options,
+                    const float* const input, const uint64_t numFrames)
+{
+    std::vector<float> scratch(options.blockSize);
+
+    for (uint64_t pos = 0; pos < numFrames;)
+    {
+        const uint32_t numSamples = static_cast<uint32_t>(std::min<uint64_t>(options.blockSize, numFrames - pos));
+        const float* inputs[1] = { input + pos };
+        float* outputs[1] = { scratch.data() };
+
+        plugin->run(inputs, outputs, numSamples);
+        pos += numSamples;
+    }
+}
+
+static void renderChunk(const Options& options, FileJob& job, const uint chunk)
+{
+    const uint64_t numFrames = job.input.size();
+    const uint64_t start = chunk * job.chunkFrames;
+    const uint64_t end = std::min(start + job.chunkFrames, numFrames);
+    const uint64_t prerollStart = start > job.prerollFrames ? start - job.prerollFrames : 0;
+
+    PluginExporter* const plugin = createPluginInstance(options.setup, options.blockSize, job.sampleRate, true);
+
+    preroll(plugin, options, job.input.data() + prerollStart, start - prerollStart);
+    process(plugin, options, job.input.data() + start, job.output.data() + start, end - start);
+
+    plugin->deactivate();
+    delete plugin;
+}
+
+// renders the whole file in one go and compares, returns false if the chunks are off by more than the tolerance
+static bool verifyChunks(const Options& options, const FileJob& job)
+{
+    const uint64_t numFrames = job.input.size();
+    std::vector<float> sequential(numFrames);
+
+    PluginExporter* const plugin = createPluginInstance(options.setup, options.blockSize, job.sampleRate, true);
+    process(plugin, options, job.input.data(), sequential.data(), numFrames);
+    plugin->deactivate();
+    delete plugin;
+
+    float maxError = 0.f;
+    uint64_t maxErrorFrame = 0;
+
+    for (uint64_t i = 0; i < numFrames; ++i)
+    {
+        const float error = std::abs(job.output[i] - sequential[i]);
+
+        if (error > maxError)
+        {
+            maxError = error;
+            maxErrorFrame = i;
+        }
+    }
+
+    const double maxErrorDb = maxError > 0.f ? 20.0 * std::log10(maxError) : -INFINITY;
+    const bool ok = maxErrorDb <= options.verifyTolerance;
+
+    std::printf("%s: %u chunks differ from a sequential render by %.1f dBFS at most, at %.3f s, %s\n",
+                job.filename, job.numChunks, maxErrorDb, static_cast<double>(maxErrorFrame) / job.sampleRate,
+                ok ? "ok" : "above tolerance");
+
+    return ok;
+}
+
+static void finishFile(const Options& options, FileJob& job)
+{
+    const double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.startTime).count();
+    const uint64_t numFrames = job.input.size();
+    const std::string outputFilename = getOutputFilename(options, job.filename);
+
+    job.audioSeconds = static_cast<double>(numFrames) / job.sampleRate;
+    job.ok = ! options.verify || job.numChunks == 1 || verifyChunks(options, job);
+
+    if (writeOutput(outputFilename.c_str(), job.output.data(), numFrames, job.sampleRate))
+    {
+        std::printf("%s: %.1f s of audio in %.2f s, %u chunks, %.1fx realtime\n",
+                    outputFilename.c_str(), job.audioSeconds, renderSeconds, job.numChunks,
+                    job.audioSeconds / std::max(renderSeconds, 1e-9));
+    }
+    else
+    {
+        std::fprintf(stderr, "%s: cannot write %s\n", job.filename, outputFilename.c_str());
+        job.ok = false;
+    }
+
+    // only files in progress are kept in memory
+    std::vector<float>().swap(job.input);
+    std::vector<float>().swap(job.output);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// hands out chunks file after file, so all workers help with the same few files and memory use stays bounded
+class Scheduler
+{
+public:
+    Scheduler(const Options& o, std::vector<FileJob>& j)
+        : options(o),
+          jobs(j) {}
+
+    bool next(FileJob*& job, uint& chunk)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        for (; currentFile < jobs.size(); ++currentFile)
+        {
+            FileJob& current(jobs[currentFile]);
+
+            if (current.numChunks == 0 && ! load(current))
+                continue;
+
+            if (current.nextChunk < current.numChunks)
+            {
+                job = &current;
+                chunk = current.nextChunk++;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    const Options& options;
+    std::vector<FileJob>& jobs;
+    std::mutex mutex;
+    size_t currentFile = 0;
+
+    bool load(FileJob& job)
+    {
+        if (! readInput(job.filename, job.input, job.sampleRate))
+        {
+            std::fprintf(stderr, "%s: cannot decode file\n", job.filename);
+            return false;
+        }
+
+        const uint64_t numFrames = job.input.size();
+
+        job.output.resize(numFrames);
+        job.chunkFrames = options.chunkTime > 0.0
+                        ? std::max<uint64_t>(options.blockSize, static_cast<uint64_t>(options.chunkTime * job.sampleRate))
+                        : std::max<uint64_t>(1, numFrames);
+        job.prerollFrames = static_cast<uint64_t>(options.prerollTime * job.sampleRate);
+        job.numChunks = static_cast<uint>(std::max<uint64_t>(1, (numFrames + job.chunkFrames - 1) / job.chunkFrames));
+        job.startTime = std::chrono::steady_clock::now();
+        return true;
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (! parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.numJobs == 0)
+        options.numJobs = std::max(1u, std::thread::hardware_concurrency());
+
+    const uint numFiles = static_cast<uint>(options.inputs.size());
+    std::vector<FileJob> jobs(numFiles);
+
+    for (uint i = 0; i < numFiles; ++i)
+        jobs[i].filename = options.inputs[i];
+
+    Scheduler scheduler(options, jobs);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // whoever renders the last chunk of a file also writes it
+    std::vector<std::thread> workers;
+
+    for (uint i = 0; i < options.numJobs; ++i)
+    {
+        workers.emplace_back([&] {
+            FileJob* job;
+            uint chunk;
+
+            while (scheduler.next(job, chunk))
+            {
+                renderChunk(options, *job, chunk);
+
+                if (job->numChunksDone.fetch_add(1) + 1 == job->numChunks)
+                    finishFile(options, *job);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double audioSeconds = 0.0;
+    uint numFailed = 0;
+
+    for (const FileJob& job : jobs)
+    {
+        if (job.ok)
+            audioSeconds += job.audioSeconds;
+        else
+            ++numFailed;
+    }
+
+    std::printf("rendered %u of %u files, %.1f s of audio in %.2f s with %u jobs, %.1fx realtime\n",
+                numFiles - numFailed, numFiles, audioSeconds, wallSeconds, options.numJobs,
+                audioSeconds / std::max(wallSeconds, 1e-9));
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -1 +0,0 @@
-../../modules/FFTConvolver/FFTConvolver.cpp
\ No newline at end of file
@@ -1 +0,0 @@
-../../modules/FFTConvolver/TwoStageFFTConvolver.cpp
\ No newline at end of file